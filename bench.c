@@ -0,0 +1,495 @@
+/**
+ * @file bench.c
+ * @brief Microbenchmarks of the hot functions of the game: the win tests,
+ * the move validators, makeMove and reading and writing board files. Each
+ * one runs over the same fixed corpus of positions, taken from seeded
+ * random games, and reports nanoseconds and heap allocations per call.
+ * Next to the functions the game uses, the suite keeps copies of the
+ * original scan-based ones (marked "scan") and the bitboard and
+ * incremental versions underneath (marked "bitboard" and "game"), so
+ * every run shows how they compare on the machine it runs on. The batch
+ * win tests run over the whole corpus at a time, once per kernel the
+ * processor has, and are checked against the per-position ones first.
+ *
+ * Allocations are counted by wrapping malloc, calloc and realloc around
+ * the C library's own (glibc's __libc_ entry points).
+ * @bug no known bugs
+ *
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "boardio.h"
+#include "rules.h"
+#include "game.h"
+#include "winbatch.h"
+
+#define BENCH_POSITIONS 4096            // size of the corpus
+#define BENCH_FILES 64                  // board files used by the file benchmarks
+#define BENCH_SEED 0x5EED5EEDu          // the corpus is the same on every run
+#define DEFAULT_TIME 0.25               // seconds each benchmark runs for
+
+/**
+ * @brief One position of the corpus, in every form the functions take.
+*/
+typedef struct {
+    char board[N][N];           /**< the char grid */
+    Position pos;               /**< the bitboards */
+    Game game;                  /**< the game with its incremental state */
+    int mTurn;                  /**< the side to move */
+    int hasMusketeerMove;       /**< 1 if the Musketeers have a move here */
+    int hasEnemyMove;           /**< 1 if the enemies have a move here */
+    Move musketeerMove;         /**< one of their moves, if so */
+    Move enemyMove;             /**< one of their moves, if so */
+} BenchPosition;
+
+/**
+ * @brief One benchmark: a call on the position with the given number,
+ * whose result is kept so that the compiler cannot drop the call.
+*/
+typedef struct {
+    const char *name;           /**< what is measured */
+    int (*run)(int i);          /**< one call, on corpus entry i */
+    int (*usable)(int i);       /**< whether entry i suits this benchmark, or NULL for all */
+} Benchmark;
+
+static BenchPosition corpus[BENCH_POSITIONS];
+static Bitboard batchMusketeers[BENCH_POSITIONS];      // the corpus again, one array per mask, for winBatch
+static Bitboard batchEnemies[BENCH_POSITIONS];
+static char fileNames[BENCH_FILES][FILENAME_MAX];       // boards written by writeBoard
+static char savedNames[BENCH_FILES][FILENAME_MAX];      // and the names they are saved under
+static uint64_t allocations;                            // heap allocations so far
+volatile int benchSink;                                 // where the results go, so no call is optimised away
+
+/**
+ * @brief Fills the corpus with every position of seeded random games
+ * from the usual starting board.
+*/
+void buildCorpus(void);
+
+/**
+ * @brief Runs one benchmark for about the given time and prints its line.
+ * @param bench the benchmark.
+ * @param seconds how long to keep calling it.
+*/
+void runBenchmark(const Benchmark *bench, double seconds);
+
+/**
+ * @brief Checks one winBatch kernel against posWinMusketeers, posWinEnemies
+ * and generateMoves on the whole corpus, then times it like runBenchmark,
+ * per position.
+ * @param kernel one of the WIN_BATCH_ kernels.
+ * @param seconds how long to keep calling it.
+ * @return 1 if it gave the same answers, 0 if not.
+*/
+int runBatchBenchmark(int kernel, double seconds);
+
+// the C library's allocator, which the wrappers below hand on to
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size){
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size){
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *p, size_t size){
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(p, size);
+}
+
+// The original scan-based functions, as they were before the bitboards.
+// Only the messages for illegal moves are gone (the benchmarks only ask
+// about legal moves) and the bounds checks come before the squares they
+// guard are read.
+
+static int scanWinMusketeers(char board[][N]){
+    int cnt = 0;
+
+    int i, k;
+    for (i = 0; i < N; i++)
+        for (k = 0; k < N; k++){
+            if (board[i][k] == 'M'){
+                if((k-1 >= 0) && (board[i][k-1] == 'o'))
+                    cnt++;
+                if((k+1 < N) && (board[i][k+1] == 'o'))
+                    cnt++;
+                if((i-1 >= 0) && (board[i-1][k]) == 'o')
+                    cnt++;
+                if((i+1 < N) && (board[i+1][k] == 'o'))
+                    cnt++;
+            }
+        }
+
+    if (cnt > 0)
+        return 0;
+
+    return 1;
+}
+
+static int scanWinEnemies(char board[][N]){
+    int i,k;
+    for (i = 0; i < N; i++) {
+        int mCount = 0;
+        for (k = 0; k < N; k++) {
+            if (board[i][k] == 'M')
+                mCount++;
+        }
+        if (mCount == 3)
+            return 1;
+    }
+
+    for (k = 0; k < N; k++) {
+        int mCount = 0;
+        for (i = 0; i < N; i++) {
+            if (board[i][k] == 'M')
+                mCount++;
+        }
+        if (mCount == 3)
+            return 1;
+    }
+
+    return 0;
+}
+
+static int scanWinGame(char board[][N]){
+    if (scanWinMusketeers(board) || scanWinEnemies(board))
+        return 1;
+    return 0;
+}
+
+static int scanIsValidMove(int row, int col, char direction){
+    return row >= 0 && row < N && col >= 0 && col < N
+        && (direction == 'L' || direction == 'l' || direction == 'R' || direction == 'r' ||
+            direction == 'U' || direction == 'u' || direction == 'D' || direction == 'd');
+}
+
+static int scanIsValidMusketeerMove(int row, int col, char direction, char board[][N]){
+    int cnt = 0;
+
+    if (scanIsValidMove(row, col, direction)){
+        if ((row > 0) && (board[row][col] == 'M') && (board[row-1][col] == 'o') && ((direction == 'U') || (direction == 'u')))
+            cnt++;
+        if ((row < N-1) && (board[row][col] == 'M') && (board[row+1][col] == 'o') && ((direction == 'D') || (direction == 'd')))
+            cnt++;
+        if ((col > 0) && (board[row][col] == 'M') && (board[row][col-1] == 'o') && ((direction == 'L') || (direction == 'l')))
+            cnt++;
+        if ((col < N-1) && (board[row][col] == 'M') && (board[row][col+1] == 'o') && ((direction == 'R') || (direction == 'r')))
+            cnt++;
+    }
+
+    return cnt > 0;
+}
+
+static int scanIsValidEnemyMove(int row, int col, char direction, char board[][N]){
+    int cnt = 0;
+
+    if (scanIsValidMove(row, col, direction)){
+        if ((row > 0) && (board[row][col] == 'o') && (board[row-1][col] == '.') && ((direction == 'U') || (direction == 'u')))
+            cnt++;
+        if ((row < N-1) && (board[row][col] == 'o') && (board[row+1][col] == '.') && ((direction == 'D') || (direction == 'd')))
+            cnt++;
+        if ((col > 0) && (board[row][col] == 'o') && (board[row][col-1] == '.') && ((direction == 'L') || (direction == 'l')))
+            cnt++;
+        if ((col < N-1) && (board[row][col] == 'o') && (board[row][col+1] == '.') && ((direction == 'R') || (direction == 'r')))
+            cnt++;
+    }
+
+    return cnt > 0;
+}
+
+static int scanWriteBoard(char board[][N], char outputfile[]){
+    FILE *file = fopen(outputfile, "w+");
+
+    if (file == NULL)
+        return 0;
+
+    int i,k;
+    for (i = 0; i < N; i++){
+        for (k = 0; k < N; k++){
+            fputc(board[i][k], file);
+            if (k < N - 1)
+                fputc(' ', file);
+        }
+        fputc('\n', file);
+    }
+    fclose(file);
+    return 1;
+}
+
+// the calls being measured
+
+static int hasMusketeerMove(int i){ return corpus[i].hasMusketeerMove; }
+static int hasEnemyMove(int i){ return corpus[i].hasEnemyMove; }
+
+static int runWinGame(int i){ return winGame(corpus[i].board); }
+static int runScanWinGame(int i){ return scanWinGame(corpus[i].board); }
+static int runPosWinGame(int i){ return posWinGame(&corpus[i].pos); }
+static int runGameWinGame(int i){ return gameWinGame(&corpus[i].game); }
+
+static int runWinMusketeers(int i){ return winMusketeers(corpus[i].board); }
+static int runScanWinMusketeers(int i){ return scanWinMusketeers(corpus[i].board); }
+static int runPosWinMusketeers(int i){ return posWinMusketeers(&corpus[i].pos); }
+static int runGameWinMusketeers(int i){ return gameWinMusketeers(&corpus[i].game); }
+
+static int runWinEnemies(int i){ return winEnemies(corpus[i].board); }
+static int runScanWinEnemies(int i){ return scanWinEnemies(corpus[i].board); }
+static int runPosWinEnemies(int i){ return posWinEnemies(&corpus[i].pos); }
+static int runGameWinEnemies(int i){ return gameWinEnemies(&corpus[i].game); }
+
+static int runIsValidMusketeerMove(int i){
+    Move m = corpus[i].musketeerMove;
+    return isValidMusketeerMove(m.from / N, m.from % N, directionToChar(moveDirection(m)), corpus[i].board);
+}
+
+static int runScanIsValidMusketeerMove(int i){
+    Move m = corpus[i].musketeerMove;
+    return scanIsValidMusketeerMove(m.from / N, m.from % N, directionToChar(moveDirection(m)), corpus[i].board);
+}
+
+static int runPosIsValidMusketeerMove(int i){
+    Move m = corpus[i].musketeerMove;
+    return posIsValidMusketeerMove(&corpus[i].pos, m.from / N, m.from % N, moveDirection(m));
+}
+
+static int runIsValidEnemyMove(int i){
+    Move m = corpus[i].enemyMove;
+    return isValidEnemyMove(m.from / N, m.from % N, directionToChar(moveDirection(m)), corpus[i].board);
+}
+
+static int runScanIsValidEnemyMove(int i){
+    Move m = corpus[i].enemyMove;
+    return scanIsValidEnemyMove(m.from / N, m.from % N, directionToChar(moveDirection(m)), corpus[i].board);
+}
+
+static int runPosIsValidEnemyMove(int i){
+    Move m = corpus[i].enemyMove;
+    return posIsValidEnemyMove(&corpus[i].pos, m.from / N, m.from % N, moveDirection(m));
+}
+
+// makeMove changes the board, so it works on a copy (the copy is timed too)
+static int runMakeMove(int i){
+    char board[N][N];
+    Move m = corpus[i].musketeerMove;
+
+    memcpy(board, corpus[i].board, sizeof(board));
+    makeMove(m.from / N, m.from % N, directionToChar(moveDirection(m)), board, 1);
+    return board[m.to / N][m.to % N];
+}
+
+static int runPosMakeMove(int i){
+    Position pos = corpus[i].pos;
+
+    posMakeMove(&pos, corpus[i].musketeerMove, 1);
+    return (int)pos.enemies;
+}
+
+// played and taken back, so the corpus game is left as it was
+static int runGameMakeMove(int i){
+    Game *game = &corpus[i].game;
+    int mTurn = game->mTurn;
+
+    game->mTurn = 1;
+    gameMakeMove(game, corpus[i].musketeerMove);
+    int adjacent = game->adjacent;
+    gameUnmakeMove(game);
+    game->mTurn = mTurn;
+    return adjacent;
+}
+
+static int runWriteBoard(int i){
+    return writeBoard(corpus[i].board, fileNames[i % BENCH_FILES], 1);
+}
+
+static int runScanWriteBoard(int i){
+    return scanWriteBoard(corpus[i].board, savedNames[i % BENCH_FILES]);
+}
+
+static int runReadBoard(int i){
+    char board[N][N];
+    return readBoard(board, savedNames[i % BENCH_FILES]);
+}
+
+/**
+ * @brief Builds the corpus, writes the board files the file benchmarks
+ * read, and runs every benchmark.
+ * @param argc
+ * @param argv "--time S" for how many seconds each benchmark runs.
+ * @return 0 if the benchmarks ran, 1 if not
+*/
+int main (int argc, char *argv[]){
+    static const Benchmark benchmarks[] = {
+        { "winGame", runWinGame, NULL },
+        { "winGame (scan)", runScanWinGame, NULL },
+        { "posWinGame (bitboard)", runPosWinGame, NULL },
+        { "gameWinGame (game)", runGameWinGame, NULL },
+        { "winMusketeers", runWinMusketeers, NULL },
+        { "winMusketeers (scan)", runScanWinMusketeers, NULL },
+        { "posWinMusketeers (bitboard)", runPosWinMusketeers, NULL },
+        { "gameWinMusketeers (game)", runGameWinMusketeers, NULL },
+        { "winEnemies", runWinEnemies, NULL },
+        { "winEnemies (scan)", runScanWinEnemies, NULL },
+        { "posWinEnemies (bitboard)", runPosWinEnemies, NULL },
+        { "gameWinEnemies (game)", runGameWinEnemies, NULL },
+        { "isValidMusketeerMove", runIsValidMusketeerMove, hasMusketeerMove },
+        { "isValidMusketeerMove (scan)", runScanIsValidMusketeerMove, hasMusketeerMove },
+        { "posIsValidMusketeerMove (bitboard)", runPosIsValidMusketeerMove, hasMusketeerMove },
+        { "isValidEnemyMove", runIsValidEnemyMove, hasEnemyMove },
+        { "isValidEnemyMove (scan)", runScanIsValidEnemyMove, hasEnemyMove },
+        { "posIsValidEnemyMove (bitboard)", runPosIsValidEnemyMove, hasEnemyMove },
+        { "makeMove", runMakeMove, hasMusketeerMove },
+        { "posMakeMove (bitboard)", runPosMakeMove, hasMusketeerMove },
+        { "gameMakeMove + gameUnmakeMove (game)", runGameMakeMove, hasMusketeerMove },
+        { "writeBoard", runWriteBoard, NULL },
+        { "writeBoard (scan)", runScanWriteBoard, NULL },
+        { "readBoard", runReadBoard, NULL },
+    };
+    double seconds = DEFAULT_TIME;
+    int i, failed = 0;
+
+    for (i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--time") == 0 && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else {
+            printf("Usage: %s [--time S]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    buildCorpus();
+
+    // the file benchmarks work in a directory of their own
+    char dir[] = "/tmp/tmbenchXXXXXX";
+    if (mkdtemp(dir) == NULL){
+        printf("Failed to make a directory for the board files.\n");
+        return 1;
+    }
+    for (i = 0; i < BENCH_FILES; i++){
+        snprintf(fileNames[i], sizeof(fileNames[i]), "%s/board%02d.txt", dir, i);
+        snprintf(savedNames[i], sizeof(savedNames[i]), "%s/out-board%02d.txt", dir, i);
+        if (!writeBoard(corpus[i].board, fileNames[i], 1)){
+            printf("Failed to write the board files.\n");
+            return 1;
+        }
+    }
+
+    printf("%-38s %10s %10s\n", "benchmark", "ns/op", "allocs/op");
+    for (i = 0; i < (int)(sizeof(benchmarks) / sizeof(benchmarks[0])); i++)
+        runBenchmark(&benchmarks[i], seconds);
+    for (i = 0; i < WIN_BATCH_KERNELS; i++)
+        if (winBatchSupported(i) && !runBatchBenchmark(i, seconds))
+            failed = 1;
+
+    for (i = 0; i < BENCH_FILES; i++)
+        unlink(savedNames[i]);
+    rmdir(dir);
+    return failed;
+}
+
+void buildCorpus(void){
+    unsigned int seed = BENCH_SEED;
+    int count = 0;
+
+    while (count < BENCH_POSITIONS){
+        Position pos;
+        int mTurn = 1;
+
+        posStart(&pos);
+
+        // one game: every position of it joins the corpus
+        while (count < BENCH_POSITIONS){
+            BenchPosition *p = &corpus[count++];
+            MoveList musketeers, enemies;
+
+            posToBoard(&pos, p->board);
+            p->pos = pos;
+            p->mTurn = mTurn;
+            batchMusketeers[count - 1] = pos.musketeers;
+            batchEnemies[count - 1] = pos.enemies;
+            gameInit(&p->game, &pos, mTurn);
+
+            generateMoves(&pos, 1, &musketeers);
+            generateMoves(&pos, 0, &enemies);
+            p->hasMusketeerMove = musketeers.count > 0;
+            p->hasEnemyMove = enemies.count > 0;
+            if (p->hasMusketeerMove)
+                p->musketeerMove = musketeers.moves[rand_r(&seed) % musketeers.count];
+            if (p->hasEnemyMove)
+                p->enemyMove = enemies.moves[rand_r(&seed) % enemies.count];
+
+            if (posWinGame(&pos) || (mTurn ? musketeers.count : enemies.count) == 0)
+                break;
+            posMakeMove(&pos, mTurn ? p->musketeerMove : p->enemyMove, mTurn);
+            mTurn = !mTurn;
+        }
+    }
+}
+
+void runBenchmark(const Benchmark *bench, double seconds){
+    struct timespec begin, now;
+    uint64_t calls = 0, allocated;
+    double elapsed;
+    int i, result = 0;
+
+    allocated = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    // whole passes over the corpus until the time is up
+    do {
+        for (i = 0; i < BENCH_POSITIONS; i++)
+            if (bench->usable == NULL || bench->usable(i)){
+                result += bench->run(i);
+                calls++;
+            }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (double)(now.tv_sec - begin.tv_sec) + (double)(now.tv_nsec - begin.tv_nsec) / 1e9;
+    } while (elapsed < seconds);
+
+    allocated = __atomic_load_n(&allocations, __ATOMIC_RELAXED) - allocated;
+    benchSink = result;
+    printf("%-38s %10.2f %10.2f\n", bench->name, elapsed * 1e9 / (double)calls, (double)allocated / (double)calls);
+}
+
+int runBatchBenchmark(int kernel, double seconds){
+    static unsigned char wins[BENCH_POSITIONS], captures[BENCH_POSITIONS];
+    struct timespec begin, now;
+    uint64_t calls = 0, allocated;
+    double elapsed;
+    char name[64];
+    int i, result = 0;
+
+    winBatchWith(kernel, batchMusketeers, batchEnemies, BENCH_POSITIONS, wins, captures);
+    for (i = 0; i < BENCH_POSITIONS; i++){
+        MoveList list;
+        int expected = (posWinMusketeers(&corpus[i].pos) ? WIN_BATCH_MUSKETEERS : 0) | (posWinEnemies(&corpus[i].pos) ? WIN_BATCH_ENEMIES : 0);
+
+        if (wins[i] != expected || captures[i] != generateMoves(&corpus[i].pos, 1, &list)){
+            printf("winBatch (%s) is wrong on corpus position %d.\n", winBatchName(kernel), i);
+            return 0;
+        }
+    }
+
+    allocated = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    do {
+        winBatchWith(kernel, batchMusketeers, batchEnemies, BENCH_POSITIONS, wins, captures);
+        result += wins[calls % BENCH_POSITIONS] + captures[calls % BENCH_POSITIONS];
+        calls += BENCH_POSITIONS;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (double)(now.tv_sec - begin.tv_sec) + (double)(now.tv_nsec - begin.tv_nsec) / 1e9;
+    } while (elapsed < seconds);
+
+    allocated = __atomic_load_n(&allocations, __ATOMIC_RELAXED) - allocated;
+    benchSink = result;
+    snprintf(name, sizeof(name), "winBatch, per position (%s)", winBatchName(kernel));
+    printf("%-38s %10.2f %10.2f\n", name, elapsed * 1e9 / (double)calls, (double)allocated / (double)calls);
+    return 1;
+}
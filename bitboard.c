@@ -0,0 +1,165 @@
+/**
+ * @file bitboard.c
+ * @brief Conversions between the char grid and the bitboard position,
+ * and the bitboard versions of the move checks used by the game.
+ * @bug no known bugs
+ *
+*/
+#include "bitboard.h"
+
+// Builds the two piece masks from the char grid
+void posFromBoard(char board[][N], Position *pos){
+    pos->musketeers = 0;
+    pos->enemies = 0;
+
+    int i, k;
+    for (i = 0; i < N; i++)
+        for (k = 0; k < N; k++){
+            if (board[i][k] == 'M')
+                pos->musketeers |= BB_SQUARE(SQUARE(i, k));
+            else if (board[i][k] == 'o')
+                pos->enemies |= BB_SQUARE(SQUARE(i, k));
+        }
+}
+
+// Fills in the char grid from the two piece masks
+void posToBoard(const Position *pos, char board[][N]){
+    int i, k;
+    for (i = 0; i < N; i++)
+        for (k = 0; k < N; k++){
+            Bitboard sq = BB_SQUARE(SQUARE(i, k));
+
+            if (pos->musketeers & sq)
+                board[i][k] = 'M';
+            else if (pos->enemies & sq)
+                board[i][k] = 'o';
+            else
+                board[i][k] = '.';
+        }
+}
+
+void posStart(Position *pos){
+    pos->musketeers = BB_SQUARE(SQUARE(0, N - 1)) | BB_SQUARE(SQUARE(N / 2, N / 2)) | BB_SQUARE(SQUARE(N - 1, 0));
+    pos->enemies = BB_FULL & ~pos->musketeers;
+}
+
+int directionFromChar(char direction){
+    switch (direction){
+        case 'L': case 'l': return DIR_LEFT;
+        case 'R': case 'r': return DIR_RIGHT;
+        case 'U': case 'u': return DIR_UP;
+        case 'D': case 'd': return DIR_DOWN;
+    }
+    return -1;
+}
+
+char directionToChar(int dir){
+    return "LRUD"[dir];
+}
+
+// square offset of one step in each direction
+static const int stepDelta[DIRECTIONS] = { -1, 1, -N, N };
+
+Move moveAt(int row, int col, int dir){
+    Move move;
+    move.from = (unsigned char)SQUARE(row, col);
+    move.to = (unsigned char)(move.from + stepDelta[dir]);
+    return move;
+}
+
+int moveDirection(Move move){
+    int delta = move.to - move.from;
+
+    if (delta == -1)
+        return DIR_LEFT;
+    if (delta == 1)
+        return DIR_RIGHT;
+    if (delta == -N)
+        return DIR_UP;
+    return DIR_DOWN;
+}
+
+void moveToString(Move move, char out[]){
+    out[0] = (char)('A' + move.from / N);
+    out[1] = ',';
+    out[2] = (char)('1' + move.from % N);
+    out[3] = '=';
+    out[4] = directionToChar(moveDirection(move));
+    out[5] = '\0';
+}
+
+// walks the movers of each direction and lists their moves
+int generateMoves(const Position *pos, int mTurn, MoveList *list){
+    int dir, count = 0;
+
+    for (dir = 0; dir < DIRECTIONS; dir++){
+        Bitboard movers = posMovers(pos, mTurn, dir);
+
+        while (movers){
+            int from = bbFirst(movers);
+            movers &= movers - 1;
+
+            list->moves[count].from = (unsigned char)from;
+            list->moves[count].to = (unsigned char)(from + stepDelta[dir]);
+            count++;
+        }
+    }
+
+    list->count = count;
+    return count;
+}
+
+int isLegalMove(const Position *pos, int mTurn, Move move){
+    STATS_COUNT(STAT_VALIDATE);
+    if (move.from >= SQUARES || move.to >= SQUARES)
+        return 0;
+
+    int dir = moveDirection(move);
+    if (move.from + stepDelta[dir] != move.to)
+        return 0;
+
+    return (posMovers(pos, mTurn, dir) & BB_SQUARE(move.from)) != 0;
+}
+
+static int onBoard(int row, int col, int dir){
+    return row >= 0 && row < N && col >= 0 && col < N && dir >= 0 && dir < DIRECTIONS;
+}
+
+int posIsValidMusketeerMove(const Position *pos, int row, int col, int dir){
+    STATS_COUNT(STAT_VALIDATE);
+    return onBoard(row, col, dir) && (posMovers(pos, 1, dir) & BB_SQUARE(SQUARE(row, col)));
+}
+
+int posIsValidEnemyMove(const Position *pos, int row, int col, int dir){
+    STATS_COUNT(STAT_VALIDATE);
+    return onBoard(row, col, dir) && (posMovers(pos, 0, dir) & BB_SQUARE(SQUARE(row, col)));
+}
+
+void posMakeMove(Position *pos, Move move, int mTurn){
+    Bitboard from = BB_SQUARE(move.from);
+    Bitboard to = BB_SQUARE(move.to);
+
+    if (mTurn){
+        pos->musketeers ^= from | to;
+        pos->enemies &= ~to;            // the captured enemy leaves the game
+    }
+    else
+        pos->enemies ^= from | to;
+}
+
+int posOutcomeFrom(const Position *pos, int mTurn, int musketeersWon, int enemiesWon, MoveList *list){
+    if (musketeersWon)
+        return OUTCOME_MUSKETEERS;
+    if (enemiesWon)
+        return OUTCOME_ENEMIES;
+    if (!generateMoves(pos, mTurn, list))
+        return OUTCOME_MUSKETEERS;              // the enemies are stuck
+    return OUTCOME_PLAYING;
+}
+
+// the enemies' test is only done when it matters
+int posOutcome(const Position *pos, int mTurn, MoveList *list){
+    int musketeersWon = posWinMusketeers(pos);
+
+    return posOutcomeFrom(pos, mTurn, musketeersWon, !musketeersWon && posWinEnemies(pos), list);
+}
@@ -0,0 +1,373 @@
+/**
+ * @file bitboard.h
+ * @brief Bitboard representation of a Three Musketeers position. Every square
+ * of the 5x5 board is one bit (square = row * N + col, A1 is bit 0), so a whole
+ * position fits in two 25-bit masks: one for the Musketeers and one for
+ * Cardinal Richelieu's men. Empty squares are whatever is left over.
+ * Moves, captures and both win tests become a few shifts and masks instead of
+ * scanning the char grid cell by cell.
+ *
+ * The board size is fixed when the program is built: -DTM_BOARD=6 (from 3
+ * to 7) builds every program for a 6x6 board instead. All the masks below
+ * are constants worked out from N, and a Bitboard is the smallest integer
+ * that holds the squares with a bit to spare above them, which the file
+ * formats use for the side to move: 32 bits up to 5x5 and 64 after that.
+ * @bug no known bugs
+ *
+*/
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+#include "stats.h"
+
+#ifndef TM_BOARD
+#define TM_BOARD 5
+#endif
+#if TM_BOARD < 3 || TM_BOARD > 7
+#error "TM_BOARD must be from 3 to 7"
+#endif
+
+#define N TM_BOARD
+
+#define SQUARES (N * N)                         // number of squares on the board
+#define SQUARE(row, col) ((row) * N + (col))    // square index of a (row, col) pair
+
+#if SQUARES < 32
+typedef uint32_t Bitboard;
+#define BB_BITS 32
+#else
+typedef uint64_t Bitboard;
+#define BB_BITS 64
+#endif
+
+#define BB_BYTES (BB_BITS / 8)                  // bytes of a mask in the file formats
+#define BB_SQUARE(sq) ((Bitboard)1 << (sq))
+#define BB_FULL (BB_SQUARE(SQUARES) - 1)        // all the squares
+#define BB_ROW_FIRST (BB_SQUARE(N) - 1)         // row A
+#define BB_COL_FIRST (BB_FULL / BB_ROW_FIRST)   // column 1: one square every N bits
+#define BB_COL_LAST (BB_COL_FIRST << (N - 1))   // the last column
+#define BB_SPARE BB_SQUARE(BB_BITS - 1)         // the top bit, above every square
+
+/**
+ * @brief The four directions a piece can move in, in the same order
+ * as the letters L, R, U, D used on the command line.
+*/
+enum { DIR_LEFT, DIR_RIGHT, DIR_UP, DIR_DOWN, DIRECTIONS };
+
+/**
+ * @brief A single move: the square a piece leaves and the square it
+ * lands on. For the Musketeers the destination always holds the enemy
+ * that gets captured.
+*/
+typedef struct {
+    unsigned char from;     /**< square the piece moves from */
+    unsigned char to;       /**< square the piece moves to */
+} Move;
+
+// Every move crosses one of the edges between two neighbouring squares,
+// and each edge can only be crossed one way in a given position.
+#define MAX_MOVES (2 * N * (N - 1))
+
+// what posOutcome finds
+enum {
+    OUTCOME_PLAYING,        // the game goes on
+    OUTCOME_MUSKETEERS,     // the Musketeers have won
+    OUTCOME_ENEMIES         // Cardinal Richelieu's men have won
+};
+
+/**
+ * @brief A fixed-size list of moves, filled in by generateMoves.
+*/
+typedef struct {
+    int count;                  /**< number of moves in the list */
+    Move moves[MAX_MOVES];      /**< the moves themselves */
+} MoveList;
+
+/**
+ * @brief A position on the board: one mask for the Musketeers ('M')
+ * and one for the enemies ('o'). Empty squares ('.') are derived.
+*/
+typedef struct {
+    Bitboard musketeers;    /**< squares holding a Musketeer */
+    Bitboard enemies;       /**< squares holding one of Cardinal Richelieu's men */
+} Position;
+
+/**
+ * @brief Builds a bitboard position from the 2D char board.
+ * Any character other than 'M' or 'o' is treated as empty.
+ * @param board the 2D array representing the game board.
+ * @param pos the position to fill in.
+*/
+void posFromBoard(char board[][N], Position *pos);
+
+/**
+ * @brief Writes a bitboard position back into the 2D char board,
+ * so display_board and writeBoard keep working on the usual grid.
+ * @param pos the position to convert.
+ * @param board the 2D array to fill in with 'M', 'o' and '.'.
+*/
+void posToBoard(const Position *pos, char board[][N]);
+
+/**
+ * @brief The usual starting position: the Musketeers in the top right
+ * corner, the middle and the bottom left corner, and an enemy on every
+ * other square.
+ * @param pos the position to fill in.
+*/
+void posStart(Position *pos);
+
+/**
+ * @brief Converts a direction letter (L/l, R/r, U/u, D/d) to one of
+ * the DIR_ constants.
+ * @param direction the direction letter.
+ * @return the direction index, or -1 if the letter is not a direction.
+*/
+int directionFromChar(char direction);
+
+/**
+ * @brief Converts one of the DIR_ constants back to its upper case letter.
+ * @param dir the direction index.
+ * @return 'L', 'R', 'U' or 'D'.
+*/
+char directionToChar(int dir);
+
+/**
+ * @brief Moves every square of a mask one step in the given direction.
+ * Squares that would leave the board are dropped, so there is no wrap
+ * around from one row to the next.
+ * @param b the mask to shift.
+ * @param dir the direction (one of the DIR_ constants).
+ * @return the shifted mask.
+*/
+static inline Bitboard bbShift(Bitboard b, int dir){
+    switch (dir){
+        case DIR_LEFT:  return (b & ~BB_COL_FIRST) >> 1;
+        case DIR_RIGHT: return (b & ~BB_COL_LAST) << 1;
+        case DIR_UP:    return b >> N;
+        default:        return (b << N) & BB_FULL;
+    }
+}
+
+/**
+ * @brief All the squares orthogonally adjacent to any square of a mask.
+ * @param b the mask.
+ * @return the neighbouring squares.
+*/
+static inline Bitboard bbNeighbours(Bitboard b){
+    return ((b & ~BB_COL_FIRST) >> 1) | ((b & ~BB_COL_LAST) << 1) | (b >> N) | ((b << N) & BB_FULL);
+}
+
+/**
+ * @brief Counts the squares set in a mask.
+ * @param b the mask.
+ * @return the number of bits set.
+*/
+static inline int bbCount(Bitboard b){
+    return BB_BYTES == 4 ? __builtin_popcount((uint32_t)b) : __builtin_popcountll(b);
+}
+
+/**
+ * @brief The lowest square of a mask.
+ * @param b the mask, which must not be empty.
+ * @return the square.
+*/
+static inline int bbFirst(Bitboard b){
+    return BB_BYTES == 4 ? __builtin_ctz((uint32_t)b) : __builtin_ctzll(b);
+}
+
+/**
+ * @brief Writes a mask in BB_BYTES little-endian bytes, as the file
+ * formats store it.
+ * @param out where it goes.
+ * @param b the mask.
+*/
+static inline void bbPut(unsigned char *out, Bitboard b){
+    int i;
+
+    for (i = 0; i < BB_BYTES; i++)
+        out[i] = (unsigned char)(b >> (8 * i));
+}
+
+/**
+ * @brief Reads a mask written by bbPut.
+ * @param in where it is.
+ * @return the mask.
+*/
+static inline Bitboard bbGet(const unsigned char *in){
+    Bitboard b = 0;
+    int i;
+
+    for (i = 0; i < BB_BYTES; i++)
+        b |= (Bitboard)in[i] << (8 * i);
+    return b;
+}
+
+/**
+ * @brief The empty squares of a position.
+ * @param pos the position.
+ * @return a mask of every square with no piece on it.
+*/
+static inline Bitboard posEmpty(const Position *pos){
+    return ~(pos->musketeers | pos->enemies) & BB_FULL;
+}
+
+/**
+ * @brief Bitboard version of winMusketeers: the Musketeers have won
+ * when none of them has an enemy on a neighbouring square.
+ * @param pos the position.
+ * @return 1 if the Musketeers have won, 0 if they have not.
+*/
+static inline int posWinMusketeers(const Position *pos){
+    STATS_COUNT(STAT_WIN_TEST);
+    return (bbNeighbours(pos->musketeers) & pos->enemies) == 0;
+}
+
+/**
+ * @brief Bitboard version of winEnemies: the enemies have won when
+ * three Musketeers share a row or a column.
+ * @param pos the position.
+ * @return 1 if the enemies have won, 0 if they have not.
+*/
+static inline int posWinEnemies(const Position *pos){
+    int i;
+
+    STATS_COUNT(STAT_WIN_TEST);
+    for (i = 0; i < N; i++){
+        if (bbCount(pos->musketeers & (BB_ROW_FIRST << (i * N))) == 3)
+            return 1;
+        if (bbCount(pos->musketeers & (BB_COL_FIRST << i)) == 3)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Bitboard version of winGame.
+ * @param pos the position.
+ * @return 1 if any opposing team has won, 0 if none have won.
+*/
+static inline int posWinGame(const Position *pos){
+    return posWinMusketeers(pos) || posWinEnemies(pos);
+}
+
+/**
+ * @brief The pieces of the side to move that can legally move one
+ * step in the given direction. This is the single check shared by the
+ * move generator and the validators.
+ * @param pos the position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @param dir the direction (one of the DIR_ constants).
+ * @return a mask of the squares the legal moves start from.
+*/
+static inline Bitboard posMovers(const Position *pos, int mTurn, int dir){
+    // a piece can move towards dir when its destination, shifted back, lands on it
+    int back = dir ^ 1;
+
+    if (mTurn)
+        return pos->musketeers & bbShift(pos->enemies, back);
+    return pos->enemies & bbShift(posEmpty(pos), back);
+}
+
+/**
+ * @brief Builds the move starting on (row, col) in the given direction.
+ * The move is not checked, so only use it on squares that stay on the board.
+ * @param row The row where the move is initiated.
+ * @param col The column where the move is initiated.
+ * @param dir the direction (one of the DIR_ constants).
+ * @return the move.
+*/
+Move moveAt(int row, int col, int dir);
+
+/**
+ * @brief Works out which way a move goes.
+ * @param move the move.
+ * @return the direction (one of the DIR_ constants).
+*/
+int moveDirection(Move move);
+
+#define MOVE_TEXT 6             // "A,5=L" and the terminating null; N is one digit
+
+/**
+ * @brief Writes a move the way players type it, e.g. "A,5=L".
+ * @param move the move.
+ * @param out a buffer of at least MOVE_TEXT bytes.
+*/
+void moveToString(Move move, char out[]);
+
+/**
+ * @brief Fills a caller supplied list with every legal move for the
+ * side to move. It has no side effects: nothing is printed and the
+ * position is left untouched.
+ * @param pos the position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @param list the list to fill in.
+ * @return the number of legal moves.
+*/
+int generateMoves(const Position *pos, int mTurn, MoveList *list);
+
+/**
+ * @brief Checks whether a move is legal for the side to move.
+ * @param pos the position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @param move the move to check.
+ * @return 1 if the move is legal, 0 if it is not.
+*/
+int isLegalMove(const Position *pos, int mTurn, Move move);
+
+/**
+ * @brief Whether the game is over, and who won: the Musketeers when no
+ * enemy is next to any of them, else the enemies when the three share a
+ * row or a column, else the Musketeers when the side to move has no move
+ * left (only the enemies can be stuck with the game still going on).
+ * @param pos the position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @param list filled in with the moves when the first two tests are passed.
+ * @return one of the OUTCOME_ values.
+*/
+int posOutcome(const Position *pos, int mTurn, MoveList *list);
+
+/**
+ * @brief posOutcome when the two win tests have already been done, by a
+ * batch or by counters kept as the game goes.
+ * @param pos the position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @param musketeersWon what posWinMusketeers says.
+ * @param enemiesWon what posWinEnemies says.
+ * @param list filled in with the moves when neither side has won.
+ * @return one of the OUTCOME_ values.
+*/
+int posOutcomeFrom(const Position *pos, int mTurn, int musketeersWon, int enemiesWon, MoveList *list);
+
+/**
+ * @brief Checks whether the Musketeer on (row, col) may capture
+ * the enemy next to it in the given direction. Prints nothing.
+ * @param pos the position.
+ * @param row The row where the move is initiated.
+ * @param col The column where the move is initiated.
+ * @param dir the direction (one of the DIR_ constants).
+ * @return 1 if the move is legal, 0 if it is not.
+*/
+int posIsValidMusketeerMove(const Position *pos, int row, int col, int dir);
+
+/**
+ * @brief Checks whether the enemy on (row, col) may step onto the
+ * empty square next to it in the given direction. Prints nothing.
+ * @param pos the position.
+ * @param row The row where the move is initiated.
+ * @param col The column where the move is initiated.
+ * @param dir the direction (one of the DIR_ constants).
+ * @return 1 if the move is legal, 0 if it is not.
+*/
+int posIsValidEnemyMove(const Position *pos, int row, int col, int dir);
+
+/**
+ * @brief Applies an already validated move to a position. A Musketeer
+ * move removes the enemy on the destination square.
+ * @param pos the position to update.
+ * @param move the move to apply.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+*/
+void posMakeMove(Position *pos, Move move, int mTurn);
+
+#endif
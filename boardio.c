@@ -0,0 +1,106 @@
+/**
+ * @file boardio.c
+ * @brief The text board files: reading them, laying boards out and saving them.
+ * @bug no known bugs
+ *
+*/
+#include <stdio.h>
+#include <string.h>
+#include "boardio.h"
+#include "savegame.h"
+
+// readBoard without its timer
+static int loadBoard(char board[][N], char filename[]){
+    FILE* file = fopen(filename, "r");
+
+    if (file == NULL){
+        printf("Error opening the file: %s\n", filename);
+        return 0;
+    }
+
+    int i,k;
+    for (i = 0; i < N; i++)
+        for (k = 0; k < N; k++){
+            int ch = fgetc(file);
+
+            if (ch == EOF || ch != 'o' && ch != 'M' && ch != '\n' && ch != ' ' && ch != '.'){
+                printf("Invalid character in the input file\n");
+                fclose(file);
+                return 0;
+            }
+
+            if (ch != '\n' && ch != ' ')
+                board[i][k] = (char)ch;
+            else
+                k--;
+        }
+
+    fclose(file);
+    return 1;
+}
+
+// Reads the board from a given file
+int readBoard (char board[][N], char filename[]){
+    STATS_BEGIN(timer);
+    int ok = loadBoard(board, filename);
+
+    STATS_END(STAT_READ_BOARD, timer);
+    return ok;
+}
+
+// writeBoard without its timer
+static int saveBoard(char board[][N], char filename[], int quiet) {
+    char outputfile[FILENAME_MAX];
+
+    // a board exported from a binary save gets a text extension back
+    size_t nameLength = strlen(filename), extension = strlen(SAVE_EXTENSION);
+    int binary = nameLength > extension && strcmp(filename + nameLength - extension, SAVE_EXTENSION) == 0;
+
+    if (!saveFileName(filename, binary ? ".txt" : NULL, outputfile, sizeof(outputfile))){
+        printf("The name of the saved file is too long: %s\n", filename);
+        return 0;
+    }
+    FILE *file = fopen(outputfile, "w+");
+
+    if (file == NULL){
+        printf("Error opening the saved file: %s\n", outputfile);
+        return 0;
+    }
+
+    char text[BOARD_TEXT];
+    int length = formatBoard(board, text);
+    int ok = fwrite(text, 1, (size_t)length, file) == (size_t)length;
+    if (fclose(file) != 0)
+        ok = 0;
+    if (!ok){
+        printf("Error writing the saved file: %s\n", outputfile);
+        return 0;
+    }
+
+    if (!quiet)
+        printf("Saving %s...Done.\nAu revoir!\n\n", outputfile);
+    return 1;
+}
+
+// Saves the current game state to a file
+int writeBoard(char board[][N], char filename[], int quiet) {
+    STATS_BEGIN(timer);
+    int ok = saveBoard(board, filename, quiet);
+
+    STATS_END(STAT_WRITE_BOARD, timer);
+    return ok;
+}
+
+// Lays the board out as it is saved
+int formatBoard(char board[][N], char text[]){
+    int i, k, length = 0;
+
+    for (i = 0; i < N; i++)
+        for (k = 0; k < N; k++){
+            text[length++] = board[i][k];
+
+            // Add a space after each character except the last in a row
+            text[length++] = k < N - 1 ? ' ' : '\n';
+        }
+    return length;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file boardio.h
+ * @brief Reading and writing the game board as the text grid of the board
+ * files, shared by the game and the tools that start from a board file.
+ * @bug no known bugs
+ *
+*/
+#ifndef BOARDIO_H
+#define BOARDIO_H
+
+#include "bitboard.h"
+
+#define BOARD_TEXT (2 * N * N)  // a saved board: N rows of N cells, each followed by a space or '\n'
+
+/**
+ * @brief Reads the contents of a specified file and uses it to
+ * initialize the game board represented as a 2D character array. It checks
+ * the validity of the input and ensures the proper dimensions of the board.
+ * @param board the 2D array representing the game board.
+ * @param filename the name of the file from which to read the game board.
+ * @return 1 if reading the board works successfully, 0 if it fails.
+*/
+int readBoard (char board[][N], char filename[]);
+
+/**
+ * @brief Writes and saves the current game state, represented by the 2D array, 
+ * to the specified file. It creates a text file containing the board layout and 
+ * allows you to save your progress and continue the game later. The file is
+ * "out-" followed by the name of the file the game was read from.
+ * @param board the 2D array representing the game board.
+ * @param filename the name of the file the game was read from.
+ * @param quiet 1 to save without telling the user, 0 to print where it went.
+ * @return 1 if writing the board works successfully, 0 if it fails.
+*/
+int writeBoard(char board[][N], char filename[], int quiet);
+
+/**
+ * @brief Lays the board out the way it is saved: one row per line
+ * with a space between the cells.
+ * @param board the 2D array representing the game board.
+ * @param text a buffer of at least BOARD_TEXT bytes; no null is added.
+ * @return the number of bytes written, always BOARD_TEXT.
+*/
+int formatBoard(char board[][N], char text[]);
+
+#endif
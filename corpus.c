@@ -0,0 +1,281 @@
+/**
+ * @file corpus.c
+ * @brief Reading and writing files of many positions.
+ * @bug no known bugs
+ *
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "corpus.h"
+
+#define READ_BUFFER (1 << 20)       // bytes read at a time when the file cannot be mapped
+
+/**
+ * @brief Where a corpus being read has got to.
+*/
+typedef struct {
+    CorpusCallback callback;        /**< who the positions go to */
+    void *context;                  /**< passed on to the callback */
+    CorpusStats stats;              /**< the counts so far */
+    int binary;                     /**< 1 for records, 0 for text lines */
+    int skipping;                   /**< 1 while dropping the rest of an overlong line */
+    int stopped;                    /**< 1 once the callback has asked to stop */
+} Reader;
+
+static void hand(Reader *reader, const Position *pos, int mTurn){
+    if (!reader->callback(pos, mTurn, reader->stats.positions++, reader->context))
+        reader->stopped = 1;
+}
+
+// one line of a text corpus
+static void parseLine(Reader *reader, const char *line, size_t length){
+    Position pos = { 0, 0 };
+    int cells = 0, mTurn = 1, sideGiven = 0;
+    size_t i;
+
+    for (i = 0; i < length; i++){
+        char ch = line[i];
+
+        if (ch == ' ' || ch == '\t' || ch == '\r')
+            continue;
+        if (ch == '#' && cells == 0)
+            return;                             // a comment
+
+        if (cells < SQUARES){
+            if (ch == 'M')
+                pos.musketeers |= BB_SQUARE(cells);
+            else if (ch == 'o')
+                pos.enemies |= BB_SQUARE(cells);
+            else if (ch != '.'){
+                reader->stats.rejected++;
+                return;
+            }
+            cells++;
+        }
+        else if (!sideGiven && (ch == 'M' || ch == 'o')){
+            mTurn = ch == 'M';
+            sideGiven = 1;
+        }
+        else {
+            reader->stats.rejected++;
+            return;
+        }
+    }
+
+    if (cells == 0)
+        return;                                 // a blank line
+    if (cells != SQUARES){
+        reader->stats.rejected++;
+        return;
+    }
+    hand(reader, &pos, mTurn);
+}
+
+// one record of a binary corpus
+static void parseRecord(Reader *reader, const unsigned char *record){
+    Bitboard first = bbGet(record);
+    Position pos;
+
+    pos.musketeers = first & ~CORPUS_SIDE;
+    pos.enemies = bbGet(record + BB_BYTES);
+    if ((pos.musketeers | pos.enemies) & ~BB_FULL || (pos.musketeers & pos.enemies)){
+        reader->stats.rejected++;
+        return;
+    }
+    hand(reader, &pos, (first & CORPUS_SIDE) != 0);
+}
+
+// goes through every whole line or record of the data and returns how
+// many bytes that used; on the last piece of a file a final line
+// without a newline counts as whole too
+static size_t parse(Reader *reader, const unsigned char *data, size_t length, int last){
+    size_t used = 0;
+
+    if (reader->binary){
+        for (; used + CORPUS_RECORD <= length && !reader->stopped; used += CORPUS_RECORD)
+            parseRecord(reader, data + used);
+        if (last && used < length && !reader->stopped){
+            reader->stats.rejected++;           // a cut off record
+            used = length;
+        }
+        return used;
+    }
+
+    while (used < length && !reader->stopped){
+        const unsigned char *end = memchr(data + used, '\n', length - used);
+        size_t lineLength;
+
+        if (end != NULL)
+            lineLength = (size_t)(end - (data + used));
+        else if (last)
+            lineLength = length - used;
+        else
+            break;
+
+        if (reader->skipping)
+            reader->skipping = 0;
+        else
+            parseLine(reader, (const char *)data + used, lineLength);
+        used += lineLength + (end != NULL);
+    }
+    return used;
+}
+
+// works out the format from the start of the file and returns the size
+// of its header, or -1 if it is a binary corpus this code cannot read
+static int detect(Reader *reader, const unsigned char *data, size_t length){
+    CorpusHeader header;
+
+    reader->binary = length >= 4 && memcmp(data, CORPUS_MAGIC, 4) == 0;
+    if (!reader->binary)
+        return 0;
+
+    if (length < sizeof(header))
+        return -1;
+    memcpy(&header, data, sizeof(header));
+    if (header.version != CORPUS_VERSION || header.boardSize != N)
+        return -1;
+    return (int)sizeof(header);
+}
+
+// reads a whole file through its memory mapping
+static int readMapped(Reader *reader, int fd, size_t size){
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const unsigned char *data = map;
+    int start = detect(reader, data, size);
+    if (start >= 0)
+        parse(reader, data + start, size - (size_t)start, 1);
+
+    munmap(map, size);
+    return start >= 0;
+}
+
+// reads a file one buffer at a time, keeping any line or record that
+// was cut in two for the next round
+static int readBuffered(Reader *reader, int fd){
+    unsigned char *buffer = malloc(READ_BUFFER);
+    size_t kept = 0;
+    int detected = 0;
+
+    if (buffer == NULL)
+        return 0;
+
+    for (;;){
+        ssize_t got = read(fd, buffer + kept, READ_BUFFER - kept);
+        if (got < 0){
+            if (errno == EINTR)
+                continue;
+            free(buffer);
+            return 0;
+        }
+
+        size_t length = kept + (size_t)got, start = 0;
+        int last = got == 0;
+
+        if (!detected){
+            if (length < sizeof(CorpusHeader) && !last){
+                kept = length;                  // not enough yet to tell the format
+                continue;
+            }
+            int header = detect(reader, buffer, length);
+            if (header < 0){
+                free(buffer);
+                return 0;
+            }
+            start = (size_t)header;
+            detected = 1;
+        }
+
+        size_t used = start + parse(reader, buffer + start, length - start, last);
+        if (last || reader->stopped)
+            break;
+
+        kept = length - used;
+        if (kept == READ_BUFFER){
+            // a line longer than the whole buffer cannot be a position
+            reader->stats.rejected++;
+            reader->skipping = 1;
+            kept = 0;
+        }
+        memmove(buffer, buffer + used, kept);
+    }
+
+    free(buffer);
+    return 1;
+}
+
+int corpusRead(const char *filename, CorpusCallback callback, void *context, CorpusStats *stats){
+    Reader reader;
+    int fd = strcmp(filename, "-") == 0 ? STDIN_FILENO : open(filename, O_RDONLY);
+
+    if (fd < 0){
+        printf("Error opening the corpus: %s\n", filename);
+        return 0;
+    }
+
+    memset(&reader, 0, sizeof(reader));
+    reader.callback = callback;
+    reader.context = context;
+
+    struct stat st;
+    int ok = -1;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)){
+        if (st.st_size == 0)
+            ok = 1;                             // nothing to read, and nothing to map
+        else
+            ok = readMapped(&reader, fd, (size_t)st.st_size);
+    }
+    if (ok < 0)
+        ok = readBuffered(&reader, fd);         // a pipe, or the mapping failed
+
+    if (fd != STDIN_FILENO)
+        close(fd);
+    if (!ok)
+        printf("Error reading the corpus: %s\n", filename);
+    if (stats != NULL)
+        *stats = reader.stats;
+    return ok;
+}
+
+int corpusWriteHeader(FILE *file){
+    CorpusHeader header;
+
+    memcpy(header.magic, CORPUS_MAGIC, 4);
+    header.version = CORPUS_VERSION;
+    header.boardSize = N;
+    header.reserved = 0;
+    return fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+int corpusWriteRecord(FILE *file, const Position *pos, int mTurn){
+    unsigned char record[CORPUS_RECORD];
+
+    bbPut(record, pos->musketeers | (mTurn ? CORPUS_SIDE : 0));
+    bbPut(record + BB_BYTES, pos->enemies);
+    return fwrite(record, 1, sizeof(record), file) == sizeof(record);
+}
+
+void corpusFormatLine(const Position *pos, int mTurn, char line[]){
+    int sq;
+
+    for (sq = 0; sq < SQUARES; sq++){
+        if (pos->musketeers & BB_SQUARE(sq))
+            line[sq] = 'M';
+        else if (pos->enemies & BB_SQUARE(sq))
+            line[sq] = 'o';
+        else
+            line[sq] = '.';
+    }
+    line[SQUARES] = mTurn ? 'M' : 'o';
+    line[SQUARES + 1] = '\n';
+    line[SQUARES + 2] = '\0';
+}
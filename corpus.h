@@ -0,0 +1,98 @@
+/**
+ * @file corpus.h
+ * @brief Files holding many positions, for analysing a whole collection
+ * of them in one pass instead of one board file at a time. Two formats
+ * are read, told apart by their first bytes:
+ *
+ * - text: one position per line, the N * N cells row by row from A1 (25
+ *   of them, up to E5, on the 5x5 board)
+ *   as 'M', 'o' or '.' (spaces between them are ignored), optionally
+ *   followed by 'M' or 'o' for the side to move (the Musketeers if it is
+ *   left out). Blank lines and lines starting with '#' are skipped.
+ * - binary: a CorpusHeader followed by records of CORPUS_RECORD bytes,
+ *   the Musketeer mask and then the enemy mask as little-endian 32-bit
+ *   words (64-bit on boards above 5x5), with the top bit of the first one
+ *   set when the Musketeers are to move.
+ *
+ * Regular files are memory-mapped whole; pipes and the standard input
+ * are read through a large buffer instead.
+ * @bug no known bugs
+ *
+*/
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "bitboard.h"
+
+#define CORPUS_MAGIC "TMCP"
+#define CORPUS_VERSION 1
+#define CORPUS_RECORD (2 * BB_BYTES)    // bytes per position in a binary file
+#define CORPUS_SIDE BB_SPARE            // the side-to-move bit of a record
+#define CORPUS_LINE (SQUARES + 3)       // a text line: the cells, the side, '\n' and a null
+
+/**
+ * @brief The start of a binary corpus file.
+*/
+typedef struct {
+    char magic[4];          /**< "TMCP" */
+    uint32_t version;       /**< CORPUS_VERSION */
+    uint32_t boardSize;     /**< N */
+    uint32_t reserved;      /**< always 0 */
+} CorpusHeader;
+
+/**
+ * @brief What happened while a corpus was read.
+*/
+typedef struct {
+    uint64_t positions;     /**< positions handed to the callback */
+    uint64_t rejected;      /**< lines or records that were not a position */
+} CorpusStats;
+
+/**
+ * @brief Called once for every position in a corpus, in file order.
+ * @param pos the position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @param number how many positions came before this one.
+ * @param context the pointer given to corpusRead.
+ * @return 1 to go on reading, 0 to stop.
+*/
+typedef int (*CorpusCallback)(const Position *pos, int mTurn, uint64_t number, void *context);
+
+/**
+ * @brief Reads every position of a corpus and hands them to a callback.
+ * @param filename the corpus, or "-" for the standard input.
+ * @param callback called for each position.
+ * @param context passed on to the callback.
+ * @param stats filled in with the counts, if not NULL.
+ * @return 1 if the corpus was read to the end (or the callback stopped
+ * it), 0 if it could not be opened or read.
+*/
+int corpusRead(const char *filename, CorpusCallback callback, void *context, CorpusStats *stats);
+
+/**
+ * @brief Starts a binary corpus.
+ * @param file the file to write to.
+ * @return 1 if writing works successfully, 0 if it fails.
+*/
+int corpusWriteHeader(FILE *file);
+
+/**
+ * @brief Adds one position to a binary corpus.
+ * @param file the file to write to, after its header.
+ * @param pos the position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @return 1 if writing works successfully, 0 if it fails.
+*/
+int corpusWriteRecord(FILE *file, const Position *pos, int mTurn);
+
+/**
+ * @brief Writes a position as one line of a text corpus.
+ * @param pos the position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @param line a buffer of at least CORPUS_LINE bytes.
+*/
+void corpusFormatLine(const Position *pos, int mTurn, char line[]);
+
+#endif
@@ -0,0 +1,330 @@
+/**
+ * @file dfpn.c
+ * @brief The df-pn search, its table and its checkpoint files.
+ * @bug no known bugs
+ *
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dfpn.h"
+
+#define PN_CHECK_INTERVAL 65536     // positions between looks at the clock and the stop flag
+
+static double monotonicSeconds(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// proof and disproof numbers are added without going past infinity
+static uint32_t pnAdd(uint32_t a, uint32_t b){
+    uint64_t sum = (uint64_t)a + b;
+    return sum >= PN_INFINITE ? PN_INFINITE : (uint32_t)sum;
+}
+
+int pnInit(PNSolver *solver, size_t megabytes){
+    size_t budget = megabytes * 1024 * 1024;
+    uint64_t count = 1;
+
+    memset(solver, 0, sizeof(*solver));
+    while (count * 2 * sizeof(PNBucket) <= budget)
+        count *= 2;
+
+    solver->buckets = calloc(count, sizeof(PNBucket));
+    if (solver->buckets == NULL)
+        return 0;
+    solver->mask = count - 1;
+    return 1;
+}
+
+void pnFree(PNSolver *solver){
+    free(solver->buckets);
+    solver->buckets = NULL;
+}
+
+static const PNEntry *pnProbe(const PNSolver *solver, uint64_t key){
+    const PNBucket *bucket = &solver->buckets[key & solver->mask];
+    int i;
+
+    for (i = 0; i < PN_BUCKET; i++)
+        if (bucket->entry[i].key == key)
+            return &bucket->entry[i];
+    return NULL;
+}
+
+// the same position is overwritten, otherwise the entry with the least work below it
+static void pnStore(PNSolver *solver, uint64_t key, uint32_t proof, uint32_t disproof, uint64_t work){
+    PNBucket *bucket = &solver->buckets[key & solver->mask];
+    PNEntry *victim = &bucket->entry[0];
+    int i;
+
+    for (i = 0; i < PN_BUCKET; i++){
+        PNEntry *e = &bucket->entry[i];
+
+        if (e->key == key){
+            victim = e;
+            break;
+        }
+        if (e->key == 0 || (victim->key != 0 && e->work < victim->work))
+            victim = e;
+    }
+
+    if (victim->key == 0)
+        solver->stored++;
+    victim->key = key;
+    victim->proof = proof;
+    victim->disproof = disproof;
+    victim->work = work;
+}
+
+// the numbers of a position not searched yet: exact when the game is over or the tablebases know it
+static void leafNumbers(PNSolver *solver, uint32_t *proof, uint32_t *disproof){
+    const Game *game = &solver->game;
+    int winner = TB_UNKNOWN, distance;
+    MoveList list;
+    int outcome = gameOutcome(game, &list);
+
+    if (outcome == OUTCOME_MUSKETEERS)
+        winner = TB_MUSKETEERS_WIN;
+    else if (outcome == OUTCOME_ENEMIES)
+        winner = TB_ENEMIES_WIN;
+    else if (solver->tb == NULL || !tbProbe(solver->tb, &game->pos, game->mTurn, &winner, &distance))
+        winner = TB_UNKNOWN;
+
+    if (winner == TB_UNKNOWN){
+        *proof = 1;
+        *disproof = 1;
+    }
+    else if ((winner == TB_MUSKETEERS_WIN) == (game->mTurn != 0)){
+        *proof = 0;
+        *disproof = PN_INFINITE;
+    }
+    else {
+        *proof = PN_INFINITE;
+        *disproof = 0;
+    }
+}
+
+// writes a checkpoint and a progress line when they are due, and notices a stop
+static int pnCheck(PNSolver *solver){
+    double now = monotonicSeconds();
+
+    if (solver->progressInterval > 0 && now - solver->lastProgress >= solver->progressInterval){
+        double seconds = solver->elapsed + now - solver->started;
+
+        printf("%llu positions in %.0fs (%.0f/s), root proof %u disproof %u, table %.1f%% full\n",
+            (unsigned long long)solver->nodes, seconds, seconds > 0 ? (double)solver->nodes / seconds : 0.0,
+            solver->rootProof, solver->rootDisproof,
+            100.0 * (double)solver->stored / (double)((solver->mask + 1) * PN_BUCKET));
+        fflush(stdout);
+        solver->lastProgress = now;
+    }
+    if (solver->checkpoint && now - solver->lastCheckpoint >= solver->checkpointInterval){
+        if (!pnWriteCheckpoint(solver, solver->checkpoint))
+            printf("Error writing the checkpoint file: %s\n", solver->checkpoint);
+        solver->lastCheckpoint = now;
+    }
+    return solver->stop != NULL && *solver->stop;
+}
+
+// one multiple-iterative-deepening step: searches below the current position
+// until its proof number reaches proofLimit or its disproof number disproofLimit,
+// and gives back its numbers, which the table may not be able to keep
+static int mid(PNSolver *solver, uint32_t proofLimit, uint32_t disproofLimit, int ply,
+        uint32_t *proof, uint32_t *disproof){
+    Game *game = &solver->game;
+    uint64_t workBefore = solver->nodes++;
+    int transform, stopped = 0, i;
+    uint64_t key = gameCanonicalKey(game, &transform);
+
+    if (solver->nodes % PN_CHECK_INTERVAL == 0)
+        stopped = pnCheck(solver);
+
+    MoveList list;
+    if (!generateMoves(&game->pos, game->mTurn, &list)){
+        *proof = PN_INFINITE;                           // a side that cannot move has lost
+        *disproof = 0;
+        pnStore(solver, key, *proof, *disproof, 1);
+        return stopped;
+    }
+
+    // the children's numbers, from the table or as leaves; from then on the
+    // searched children's own answers are kept here, in case the table loses them
+    uint32_t proofs[MAX_MOVES], disproofs[MAX_MOVES];
+    for (i = 0; i < list.count; i++){
+        gameMakeMove(game, list.moves[i]);
+        leafNumbers(solver, &proofs[i], &disproofs[i]);
+        if (proofs[i] == 1 && disproofs[i] == 1){
+            const PNEntry *e = pnProbe(solver, gameCanonicalKey(game, &transform));
+
+            if (e){
+                proofs[i] = e->proof;
+                disproofs[i] = e->disproof;
+            }
+        }
+        gameUnmakeMove(game);
+    }
+
+    for (;;){
+        int best = 0;
+        uint32_t bestDisproof = PN_INFINITE, secondDisproof = PN_INFINITE, bestProof = 0;
+
+        // the side to move wins as soon as one child is lost for its side to move
+        *disproof = 0;
+        for (i = 0; i < list.count; i++){
+            uint32_t childProof = proofs[i];
+            uint32_t childDisproof = disproofs[i];
+
+            *disproof = pnAdd(*disproof, childProof);
+            if (childDisproof < bestDisproof){
+                secondDisproof = bestDisproof;
+                bestDisproof = childDisproof;
+                bestProof = childProof;
+                best = i;
+            }
+            else if (childDisproof < secondDisproof)
+                secondDisproof = childDisproof;
+        }
+        *proof = bestDisproof;
+
+        if (ply == 0){
+            solver->rootProof = *proof;
+            solver->rootDisproof = *disproof;
+        }
+        if (*proof >= proofLimit || *disproof >= disproofLimit || stopped)
+            break;
+
+        // the child is searched until it stops being the most proving one
+        uint64_t childProofLimit = (uint64_t)disproofLimit - *disproof + bestProof;
+        uint32_t childDisproofLimit = proofLimit < pnAdd(secondDisproof, 1) ? proofLimit : pnAdd(secondDisproof, 1);
+
+        gameMakeMove(game, list.moves[best]);
+        stopped = mid(solver, childProofLimit >= PN_INFINITE ? PN_INFINITE : (uint32_t)childProofLimit,
+            childDisproofLimit, ply + 1, &proofs[best], &disproofs[best]);
+        gameUnmakeMove(game);
+    }
+
+    pnStore(solver, key, *proof, *disproof, solver->nodes - workBefore);
+    return stopped;
+}
+
+int pnSolve(PNSolver *solver, const Position *pos, int mTurn, int *result, Move *best){
+    int i, transform;
+
+    gameInit(&solver->game, pos, mTurn);
+    solver->rootPos = *pos;
+    solver->rootTurn = mTurn;
+    solver->started = monotonicSeconds();
+    solver->lastCheckpoint = solver->lastProgress = solver->started;
+
+    if (solver->checkpoint && pnReadCheckpoint(solver, solver->checkpoint))
+        printf("Carrying on from %s: %llu positions already searched.\n", solver->checkpoint,
+            (unsigned long long)solver->nodes);
+
+    // the root itself may already be over or known
+    uint32_t proof, disproof;
+    leafNumbers(solver, &proof, &disproof);
+    if (proof == 1 && disproof == 1){
+        int stopped = mid(solver, PN_INFINITE, PN_INFINITE, 0, &proof, &disproof);
+
+        if (solver->checkpoint && (stopped || (proof != 0 && disproof != 0))
+                && !pnWriteCheckpoint(solver, solver->checkpoint))
+            printf("Error writing the checkpoint file: %s\n", solver->checkpoint);
+    }
+    solver->rootProof = proof;
+    solver->rootDisproof = disproof;
+    if (proof != 0 && disproof != 0)
+        return 0;
+
+    int moverWins = proof == 0;
+    *result = moverWins == (mTurn != 0) ? TB_MUSKETEERS_WIN : TB_ENEMIES_WIN;
+
+    // a winning move leads to a position lost for the side to move there
+    MoveList list;
+    best->from = best->to = 0;
+    if (moverWins && generateMoves(&solver->game.pos, mTurn, &list))
+        for (i = 0; i < list.count; i++){
+            uint32_t childProof, childDisproof;
+
+            gameMakeMove(&solver->game, list.moves[i]);
+            leafNumbers(solver, &childProof, &childDisproof);
+            const PNEntry *e = pnProbe(solver, gameCanonicalKey(&solver->game, &transform));
+            if (e && childProof == 1 && childDisproof == 1)
+                childDisproof = e->disproof;
+            gameUnmakeMove(&solver->game);
+
+            if (childDisproof == 0){
+                *best = list.moves[i];
+                break;
+            }
+        }
+    return 1;
+}
+
+int pnWriteCheckpoint(const PNSolver *solver, const char *filename){
+    char temporary[FILENAME_MAX];
+    PNHeader header;
+
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", filename) >= (int)sizeof(temporary))
+        return 0;
+    FILE *file = fopen(temporary, "wb");
+    if (file == NULL)
+        return 0;
+
+    memcpy(header.magic, PN_MAGIC, 4);
+    header.version = PN_VERSION;
+    header.boardSize = N;
+    header.mTurn = (uint32_t)solver->rootTurn;
+    header.musketeers = solver->rootPos.musketeers;
+    header.enemies = solver->rootPos.enemies;
+    header.buckets = solver->mask + 1;
+    header.nodes = solver->nodes;
+    header.milliseconds = (uint64_t)((solver->elapsed + monotonicSeconds() - solver->started) * 1000.0);
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1
+          && fwrite(solver->buckets, sizeof(PNBucket), header.buckets, file) == header.buckets;
+    if (fclose(file) != 0)
+        ok = 0;
+    if (ok)
+        ok = rename(temporary, filename) == 0;
+    if (!ok)
+        remove(temporary);
+    return ok;
+}
+
+int pnReadCheckpoint(PNSolver *solver, const char *filename){
+    PNHeader header;
+    FILE *file = fopen(filename, "rb");
+
+    if (file == NULL)
+        return 0;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, PN_MAGIC, 4) != 0
+            || header.version != PN_VERSION || header.boardSize != N
+            || header.mTurn != (uint32_t)solver->rootTurn || header.musketeers != solver->rootPos.musketeers
+            || header.enemies != solver->rootPos.enemies || header.buckets != solver->mask + 1){
+        printf("The checkpoint %s is for another position or table size, starting afresh.\n", filename);
+        fclose(file);
+        return 0;
+    }
+
+    int ok = fread(solver->buckets, sizeof(PNBucket), header.buckets, file) == header.buckets;
+    fclose(file);
+    if (!ok){
+        memset(solver->buckets, 0, header.buckets * sizeof(PNBucket));
+        printf("The checkpoint %s is damaged, starting afresh.\n", filename);
+        return 0;
+    }
+
+    uint64_t i;
+    int k;
+    solver->stored = 0;
+    for (i = 0; i < header.buckets; i++)
+        for (k = 0; k < PN_BUCKET; k++)
+            solver->stored += solver->buckets[i].entry[k].key != 0;
+    solver->nodes = header.nodes;
+    solver->elapsed = header.milliseconds / 1000.0;
+    return 1;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file dfpn.h
+ * @brief Depth-first proof-number search (df-pn), to prove who wins a
+ * position with perfect play without building the tablebases. Every
+ * node carries a proof number and a disproof number for "the side to move
+ * wins": the least number of positions still to be solved to prove it and
+ * to disprove it. The search always works on the most proving position,
+ * in depth-first order, and keeps the numbers in a fixed-size table, so it
+ * runs in bounded memory however long it takes. There are no draws and no
+ * position can come back (every other move captures), so a position is
+ * either proved or disproved in the end.
+ *
+ * The whole table can be written to a checkpoint file and read back, so a
+ * solve that is stopped picks up where it was.
+ * @bug no known bugs
+ *
+*/
+#ifndef DFPN_H
+#define DFPN_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+#include "tbprobe.h"
+
+#define PN_INFINITE 0x7FFFFFFFu     // a proof or disproof number that can never be reached
+#define PN_BUCKET 4                 // entries sharing one index into the table
+#define PN_MAGIC "TMPN"
+#define PN_VERSION 1
+
+/**
+ * @brief What the table knows about one position.
+*/
+typedef struct {
+    uint64_t key;           /**< canonical Zobrist key of the position, 0 for an empty entry */
+    uint32_t proof;         /**< proof number for the side to move winning */
+    uint32_t disproof;      /**< disproof number */
+    uint64_t work;          /**< positions expanded below it, so that the cheapest are replaced first */
+} PNEntry;
+
+/**
+ * @brief The entries that share one index into the table.
+*/
+typedef struct {
+    PNEntry entry[PN_BUCKET];
+} PNBucket;
+
+/**
+ * @brief The start of a checkpoint file; the buckets of the table follow.
+*/
+typedef struct {
+    char magic[4];          /**< "TMPN" */
+    uint32_t version;       /**< PN_VERSION */
+    uint32_t boardSize;     /**< N */
+    uint32_t mTurn;         /**< the side to move at the root */
+    Bitboard musketeers;    /**< the Musketeers of the root */
+    Bitboard enemies;       /**< the enemies of the root */
+    uint64_t buckets;       /**< buckets in the table */
+    uint64_t nodes;         /**< positions expanded so far */
+    uint64_t milliseconds;  /**< time spent so far */
+} PNHeader;
+
+/**
+ * @brief A solver and the settings it runs with.
+*/
+typedef struct {
+    PNBucket *buckets;              /**< the table */
+    uint64_t mask;                  /**< number of buckets less one */
+    uint64_t stored;                /**< entries in use */
+    Game game;                      /**< the position being searched, moved up and down in place */
+    Position rootPos;               /**< the position to solve */
+    int rootTurn;                   /**< its side to move */
+    TBProbe *tb;                    /**< tablebases to finish the search with, or NULL */
+    uint64_t nodes;                 /**< positions expanded, counting earlier runs */
+    double elapsed;                 /**< seconds spent in earlier runs */
+    double started;                 /**< when this run started on the monotonic clock */
+    uint32_t rootProof;             /**< the latest numbers of the root */
+    uint32_t rootDisproof;          /**< ... */
+    const char *checkpoint;         /**< the checkpoint file, or NULL */
+    int checkpointInterval;         /**< seconds between checkpoints */
+    int progressInterval;           /**< seconds between progress lines, 0 for none */
+    double lastCheckpoint;          /**< when the last one was written */
+    double lastProgress;            /**< when the last line was printed */
+    volatile sig_atomic_t *stop;    /**< set (by a signal handler) to stop the search, or NULL */
+} PNSolver;
+
+/**
+ * @brief Allocates the table: the largest power of two number of
+ * buckets that fits in the memory budget.
+ * @param solver the solver to set up; the settings after the table are
+ * cleared and can be filled in afterwards.
+ * @param megabytes the memory budget in megabytes.
+ * @return 1 if the memory was allocated, 0 if it was not.
+*/
+int pnInit(PNSolver *solver, size_t megabytes);
+
+/**
+ * @brief Frees the table.
+ * @param solver the solver.
+*/
+void pnFree(PNSolver *solver);
+
+/**
+ * @brief Proves or disproves that the side to move wins. With a checkpoint
+ * file the table is written to it every checkpointInterval seconds and when
+ * the search stops, and one made for the same position and table size is
+ * read back before starting.
+ * @param solver the solver.
+ * @param pos the position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @param result set to TB_MUSKETEERS_WIN or TB_ENEMIES_WIN.
+ * @param best set to a winning move when the side to move wins.
+ * @return 1 if the position was solved, 0 if the search was stopped first.
+*/
+int pnSolve(PNSolver *solver, const Position *pos, int mTurn, int *result, Move *best);
+
+/**
+ * @brief Writes the table to a checkpoint file, through a temporary file
+ * so that a crash while writing leaves the last checkpoint whole.
+ * @param solver the solver.
+ * @param filename the checkpoint file.
+ * @return 1 if it was written, 0 if not.
+*/
+int pnWriteCheckpoint(const PNSolver *solver, const char *filename);
+
+/**
+ * @brief Reads a checkpoint back into the table.
+ * @param solver the solver, already set up for the position with pnSolve's
+ * root and a table of the same size.
+ * @param filename the checkpoint file.
+ * @return 1 if it was read, 0 if it is missing or was made for a different
+ * position or table size.
+*/
+int pnReadCheckpoint(PNSolver *solver, const char *filename);
+
+#endif
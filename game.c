@@ -0,0 +1,134 @@
+/**
+ * @file game.c
+ * @brief Making and unmaking moves on a game in progress.
+ * @bug no known bugs
+ *
+*/
+#include "game.h"
+
+// puts a piece on or takes it off a square in every symmetric image's key
+static void toggleKeys(Game *game, uint64_t zobrist[][SQUARES], int sq){
+    int t;
+
+    for (t = 0; t < SYMMETRIES; t++)
+        game->keys[t] ^= zobrist[t][sq];
+}
+
+static void toggleSide(Game *game){
+    int t;
+
+    for (t = 0; t < SYMMETRIES; t++)
+        game->keys[t] ^= zobristSide;
+}
+
+// adds one to a row or column count, keeping track of the full lines
+static void lineAdd(Game *game, int *count){
+    if (*count == 3)
+        game->fullLines--;
+    if (++*count == 3)
+        game->fullLines++;
+}
+
+static void lineRemove(Game *game, int *count){
+    if (*count == 3)
+        game->fullLines--;
+    if (--*count == 3)
+        game->fullLines++;
+}
+
+static void addMusketeer(Game *game, int sq){
+    game->pos.musketeers |= BB_SQUARE(sq);
+    toggleKeys(game, zobristMusketeer, sq);
+    game->adjacent += bbCount(bbNeighbours(BB_SQUARE(sq)) & game->pos.enemies);
+    lineAdd(game, &game->rowCount[sq / N]);
+    lineAdd(game, &game->colCount[sq % N]);
+}
+
+static void removeMusketeer(Game *game, int sq){
+    game->pos.musketeers &= ~BB_SQUARE(sq);
+    toggleKeys(game, zobristMusketeer, sq);
+    game->adjacent -= bbCount(bbNeighbours(BB_SQUARE(sq)) & game->pos.enemies);
+    lineRemove(game, &game->rowCount[sq / N]);
+    lineRemove(game, &game->colCount[sq % N]);
+}
+
+static void addEnemy(Game *game, int sq){
+    game->pos.enemies |= BB_SQUARE(sq);
+    toggleKeys(game, zobristEnemy, sq);
+    game->adjacent += bbCount(bbNeighbours(BB_SQUARE(sq)) & game->pos.musketeers);
+}
+
+static void removeEnemy(Game *game, int sq){
+    game->pos.enemies &= ~BB_SQUARE(sq);
+    toggleKeys(game, zobristEnemy, sq);
+    game->adjacent -= bbCount(bbNeighbours(BB_SQUARE(sq)) & game->pos.musketeers);
+}
+
+void gameInit(Game *game, const Position *pos, int mTurn){
+    int i;
+
+    // build the counters up one piece at a time from an empty board
+    game->pos.musketeers = 0;
+    game->pos.enemies = 0;
+    game->fullLines = 0;
+    game->adjacent = 0;
+    for (i = 0; i < SYMMETRIES; i++)
+        game->keys[i] = mTurn ? zobristSide : 0;
+    for (i = 0; i < N; i++){
+        game->rowCount[i] = 0;
+        game->colCount[i] = 0;
+    }
+    for (i = 0; i < SQUARES; i++){
+        if (pos->musketeers & BB_SQUARE(i))
+            addMusketeer(game, i);
+        else if (pos->enemies & BB_SQUARE(i))
+            addEnemy(game, i);
+    }
+
+    game->mTurn = mTurn;
+    game->ply = 0;
+    game->undoCount = 0;
+}
+
+int gameMakeMove(Game *game, Move move){
+    STATS_COUNT(STAT_MAKE_MOVE);
+    if (game->undoCount == UNDO_CAPACITY)
+        return 0;
+
+    game->undo[game->undoCount++].move = move;
+    if (game->mTurn){
+        removeEnemy(game, move.to);         // the captured enemy leaves the game
+        removeMusketeer(game, move.from);
+        addMusketeer(game, move.to);
+    }
+    else {
+        removeEnemy(game, move.from);
+        addEnemy(game, move.to);
+    }
+    game->mTurn = !game->mTurn;
+    toggleSide(game);
+    game->ply++;
+    return 1;
+}
+
+int gameUnmakeMove(Game *game){
+    if (game->undoCount == 0)
+        return 0;
+
+    Move move = game->undo[--game->undoCount].move;
+
+    game->mTurn = !game->mTurn;
+    toggleSide(game);
+    game->ply--;
+
+    if (game->mTurn){
+        removeMusketeer(game, move.to);
+        addMusketeer(game, move.from);
+        addEnemy(game, move.to);            // the captured enemy comes back
+    }
+    else {
+        removeEnemy(game, move.to);
+        addEnemy(game, move.from);
+    }
+    return 1;
+}
@@ -0,0 +1,134 @@
+/**
+ * @file game.h
+ * @brief The state of one game on top of the bitboard position: whose
+ * turn it is, how many moves have been played, and a fixed-capacity undo
+ * stack so that search, replay and taking moves back can go forward and
+ * backward in place without copying the board. The game also keeps
+ * per-row and per-column Musketeer counts and the number of Musketeer/enemy
+ * neighbour pairs up to date on every move, so both win tests are O(1),
+ * along with the Zobrist keys of the position and of its symmetric images.
+ * @bug no known bugs
+ *
+*/
+#ifndef GAME_H
+#define GAME_H
+
+#include "bitboard.h"
+#include "zobrist.h"
+#include "symmetry.h"
+
+// Every Musketeer move captures an enemy, so even a game started from a
+// full board is over after 2 * (SQUARES - 3) + 1 moves.
+#define UNDO_CAPACITY (2 * SQUARES > 64 ? 2 * SQUARES : 64)
+
+/**
+ * @brief What gameUnmakeMove needs to put a move back.
+*/
+typedef struct {
+    Move move;              /**< the move that was made */
+} Undo;
+
+/**
+ * @brief One game in progress.
+*/
+typedef struct {
+    Position pos;                   /**< the pieces on the board */
+    int mTurn;                      /**< 1 when the Musketeers are to move, 0 for the enemies */
+    int ply;                        /**< number of moves made since the game started */
+    uint64_t keys[SYMMETRIES];      /**< Zobrist key of every symmetric image of the position;
+                                         keys[SYM_IDENTITY] is the key of the position itself */
+    int rowCount[N];                /**< Musketeers on each row */
+    int colCount[N];                /**< Musketeers on each column */
+    int fullLines;                  /**< rows and columns holding all three Musketeers */
+    int adjacent;                   /**< Musketeer/enemy pairs on neighbouring squares */
+    int undoCount;                  /**< number of moves on the undo stack */
+    Undo undo[UNDO_CAPACITY];       /**< the moves that can be taken back, oldest first */
+} Game;
+
+/**
+ * @brief Starts a game from the given position.
+ * @param game the game to set up.
+ * @param pos the starting position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+*/
+void gameInit(Game *game, const Position *pos, int mTurn);
+
+/**
+ * @brief Plays an already validated move for the side to move
+ * and pushes it on the undo stack.
+ * @param game the game.
+ * @param move the move to play.
+ * @return 1 if the move was played, 0 if the undo stack is full.
+*/
+int gameMakeMove(Game *game, Move move);
+
+/**
+ * @brief Takes back the last move: a captured enemy is put back on its
+ * square and a moved enemy returns to where it came from.
+ * @param game the game.
+ * @return 1 if a move was taken back, 0 if there was nothing to undo.
+*/
+int gameUnmakeMove(Game *game);
+
+/**
+ * @brief O(1) version of winMusketeers, using the counters kept by
+ * gameMakeMove: no Musketeer has an enemy next to it.
+ * @param game the game.
+ * @return 1 if the Musketeers have won, 0 if they have not.
+*/
+static inline int gameWinMusketeers(const Game *game){
+    STATS_COUNT(STAT_WIN_TEST);
+    return game->adjacent == 0;
+}
+
+/**
+ * @brief O(1) version of winEnemies, using the counters kept by
+ * gameMakeMove: three Musketeers share a row or a column.
+ * @param game the game.
+ * @return 1 if the enemies have won, 0 if they have not.
+*/
+static inline int gameWinEnemies(const Game *game){
+    STATS_COUNT(STAT_WIN_TEST);
+    return game->fullLines > 0;
+}
+
+/**
+ * @brief O(1) version of winGame.
+ * @param game the game.
+ * @return 1 if any opposing team has won, 0 if none have won.
+*/
+static inline int gameWinGame(const Game *game){
+    return gameWinMusketeers(game) || gameWinEnemies(game);
+}
+
+/**
+ * @brief posOutcome with the game's own win counters.
+ * @param game the game.
+ * @param list filled in with the moves when neither side has won.
+ * @return one of the OUTCOME_ values.
+*/
+static inline int gameOutcome(const Game *game, MoveList *list){
+    return posOutcomeFrom(&game->pos, game->mTurn, gameWinMusketeers(game), gameWinEnemies(game), list);
+}
+
+/**
+ * @brief The Zobrist key shared by a position and all of its symmetric
+ * images: the smallest of their keys. Caches keyed on it store a single
+ * entry for the 8 images.
+ * @param game the game.
+ * @param transform set to the symmetry whose image has that key. Moves
+ * stored under the key belong to that image, so map them back with
+ * symMove(symInverse(*transform), move).
+ * @return the canonical key.
+*/
+static inline uint64_t gameCanonicalKey(const Game *game, int *transform){
+    int t, best = SYM_IDENTITY;
+
+    for (t = 1; t < SYMMETRIES; t++)
+        if (game->keys[t] < game->keys[best])
+            best = t;
+    *transform = best;
+    return game->keys[best];
+}
+
+#endif
@@ -0,0 +1,216 @@
+/**
+ * @file journal.c
+ * @brief Writing, reading back and resuming a journal.
+ * @bug no known bugs
+ *
+*/
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "journal.h"
+
+// the check byte of a snapshot, from the bytes before it
+static unsigned char snapshotCheck(const unsigned char *record){
+    unsigned sum = 0xA5;
+    int i;
+
+    for (i = 0; i < JOURNAL_SNAPSHOT_BYTES - 1; i++)
+        sum = (sum * 31 + record[i]) & 0xFF;
+    return (unsigned char)sum;
+}
+
+static void putSnapshot(unsigned char *record, const SavedGame *saved){
+    unsigned char *moves = record + 1 + 2 * BB_BYTES;
+
+    record[0] = JOURNAL_SNAPSHOT;
+    bbPut(record + 1, saved->pos.musketeers | (saved->mTurn ? SAVE_SIDE : 0));
+    bbPut(record + 1 + BB_BYTES, saved->pos.enemies);
+    moves[0] = (unsigned char)saved->moves;
+    moves[1] = (unsigned char)(saved->moves >> 8);
+    moves[2] = snapshotCheck(record);
+}
+
+// 0 if the snapshot is damaged
+static int getSnapshot(const unsigned char *record, SavedGame *saved){
+    const unsigned char *moves = record + 1 + 2 * BB_BYTES;
+
+    if (moves[2] != snapshotCheck(record))
+        return 0;
+    Bitboard musketeers = bbGet(record + 1), enemies = bbGet(record + 1 + BB_BYTES);
+    saved->mTurn = (musketeers & SAVE_SIDE) != 0;
+    saved->pos.musketeers = musketeers & ~SAVE_SIDE;
+    saved->pos.enemies = enemies;
+    saved->moves = moves[0] | moves[1] << 8;
+    return (saved->pos.musketeers & ~BB_FULL) == 0 && (enemies & ~BB_FULL) == 0
+        && (saved->pos.musketeers & enemies) == 0;
+}
+
+// writes everything, however many calls it takes
+static int writeAll(int fd, const unsigned char *bytes, size_t length){
+    while (length > 0){
+        ssize_t written = write(fd, bytes, length);
+
+        if (written < 0)
+            return 0;
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return 1;
+}
+
+static int append(Journal *journal, const unsigned char *record, size_t length){
+    if (journal->length + length > JOURNAL_BUFFER){
+        if (!writeAll(journal->fd, journal->buffer, journal->length))
+            return 0;
+        journal->length = 0;
+    }
+    memcpy(journal->buffer + journal->length, record, length);
+    journal->length += length;
+    return 1;
+}
+
+int journalCreate(Journal *journal, const char *filename, const SavedGame *start, int syncEvery){
+    unsigned char header[JOURNAL_HEADER + JOURNAL_SNAPSHOT_BYTES];
+
+    journal->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (journal->fd < 0)
+        return 0;
+    journal->syncEvery = syncEvery;
+    journal->sinceSync = journal->sinceSnapshot = 0;
+    journal->length = 0;
+
+    memcpy(header, JOURNAL_MAGIC, 4);
+    header[4] = JOURNAL_VERSION;
+    header[5] = N;
+    putSnapshot(header + JOURNAL_HEADER, start);
+    if (!append(journal, header, sizeof(header)) || !journalFlush(journal) || (syncEvery > 0 && fsync(journal->fd) != 0)){
+        close(journal->fd);
+        return 0;
+    }
+    return 1;
+}
+
+// the whole file, or NULL
+static unsigned char *readFile(int fd, size_t *length){
+    struct stat info;
+
+    if (fstat(fd, &info) != 0)
+        return NULL;
+
+    unsigned char *bytes = malloc((size_t)info.st_size + 1);
+    size_t got = 0;
+    while (bytes != NULL && got < (size_t)info.st_size){
+        ssize_t part = read(fd, bytes + got, (size_t)info.st_size - got);
+
+        if (part <= 0)
+            break;
+        got += (size_t)part;
+    }
+    *length = got;
+    return bytes;
+}
+
+int journalResume(Journal *journal, const char *filename, SavedGame *now, int syncEvery){
+    int fd = open(filename, O_RDWR);
+    size_t length, at, snapshot = 0, good;
+
+    if (fd < 0)
+        return 0;
+    unsigned char *bytes = readFile(fd, &length);
+    if (bytes == NULL || length < JOURNAL_HEADER + JOURNAL_SNAPSHOT_BYTES || memcmp(bytes, JOURNAL_MAGIC, 4) != 0
+            || bytes[4] != JOURNAL_VERSION || bytes[5] != N || bytes[JOURNAL_HEADER] != JOURNAL_SNAPSHOT){
+        free(bytes);
+        close(fd);
+        return 0;
+    }
+
+    // the records are only walked over, up to the last whole snapshot ...
+    for (at = JOURNAL_HEADER; at < length; ){
+        if (bytes[at] == JOURNAL_SNAPSHOT){
+            SavedGame saved;
+
+            if (length - at < JOURNAL_SNAPSHOT_BYTES || !getSnapshot(bytes + at, &saved))
+                break;
+            snapshot = at;
+            at += JOURNAL_SNAPSHOT_BYTES;
+        }
+        else if (length - at >= JOURNAL_MOVE_BYTES && bytes[at] < SQUARES && bytes[at + 1] < SQUARES)
+            at += JOURNAL_MOVE_BYTES;
+        else
+            break;
+    }
+    if (snapshot == 0){
+        free(bytes);
+        close(fd);
+        return 0;
+    }
+
+    // ... and only the moves after it are played again
+    SavedGame start;
+    Game game;
+    getSnapshot(bytes + snapshot, &start);
+    gameInit(&game, &start.pos, start.mTurn);
+    good = snapshot + JOURNAL_SNAPSHOT_BYTES;
+    while (good + JOURNAL_MOVE_BYTES <= at && bytes[good] != JOURNAL_SNAPSHOT){
+        Move move = { bytes[good], bytes[good + 1] };
+
+        if (gameWinGame(&game) || !isLegalMove(&game.pos, game.mTurn, move) || !gameMakeMove(&game, move))
+            break;
+        good += JOURNAL_MOVE_BYTES;
+    }
+    free(bytes);
+
+    now->pos = game.pos;
+    now->mTurn = game.mTurn;
+    now->moves = start.moves + game.ply;
+
+    if ((good < length && ftruncate(fd, (off_t)good) != 0) || lseek(fd, 0, SEEK_END) < 0){
+        close(fd);
+        return 0;
+    }
+    journal->fd = fd;
+    journal->syncEvery = syncEvery;
+    journal->sinceSync = 0;
+    journal->sinceSnapshot = game.ply;
+    journal->length = 0;
+    return 1;
+}
+
+int journalMove(Journal *journal, Move move, const SavedGame *after){
+    unsigned char record[JOURNAL_MOVE_BYTES] = { move.from, move.to };
+
+    if (!append(journal, record, sizeof(record)))
+        return 0;
+    journal->sinceSync++;
+    if (++journal->sinceSnapshot < JOURNAL_SNAPSHOT_EVERY)
+        return 1;
+
+    unsigned char snapshot[JOURNAL_SNAPSHOT_BYTES];
+    putSnapshot(snapshot, after);
+    journal->sinceSnapshot = 0;
+    return append(journal, snapshot, sizeof(snapshot));
+}
+
+int journalFlush(Journal *journal){
+    if (!writeAll(journal->fd, journal->buffer, journal->length))
+        return 0;
+    journal->length = 0;
+
+    if (journal->syncEvery > 0 && journal->sinceSync >= journal->syncEvery){
+        journal->sinceSync = 0;
+        return fsync(journal->fd) == 0;
+    }
+    return 1;
+}
+
+int journalClose(Journal *journal){
+    int ok = journalFlush(journal);
+
+    if (journal->syncEvery > 0 && fsync(journal->fd) != 0)
+        ok = 0;
+    if (close(journal->fd) != 0)
+        ok = 0;
+    return ok;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file journal.h
+ * @brief An append-only journal of a game, so that a game cut short by a
+ * crash or a closed terminal can be picked up again at the last move,
+ * with whose turn it is. Nothing in it is ever rewritten: every move that
+ * is played adds two bytes, and every few moves a snapshot of the whole
+ * game is added as well, so that resuming only replays the moves after
+ * the last snapshot. The records go through a buffer and reach the file
+ * when the journal is flushed; fsync can be asked for every so many moves.
+ *
+ * The file starts with "TMJL", JOURNAL_VERSION and N, and then holds
+ * records, the first of them a snapshot:
+ *
+ * - a move: the square it goes from and the square it goes to, one byte each
+ * - a snapshot: JOURNAL_SNAPSHOT, the Musketeer mask with SAVE_SIDE set
+ *   when they are to move, the enemy mask (BB_BYTES each, little-endian,
+ *   4 on 5x5), the number of moves played (2 bytes) and a check byte
+ *
+ * A record cut short by a crash, a snapshot whose check byte is wrong or a
+ * move that is not legal ends the journal there; resuming cuts the file
+ * back to the records before it.
+ * @bug no known bugs
+ *
+*/
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "game.h"
+#include "savegame.h"
+
+#define JOURNAL_MAGIC "TMJL"
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER 6            // magic, version and N
+#define JOURNAL_SNAPSHOT 0xFF       // the first byte of a snapshot; a move starts with a square
+#define JOURNAL_SNAPSHOT_BYTES (4 + 2 * BB_BYTES)    // the marker, the masks, the moves and the check byte
+#define JOURNAL_MOVE_BYTES 2
+#define JOURNAL_BUFFER 4096
+#define JOURNAL_SNAPSHOT_EVERY 16   // moves between snapshots
+
+/**
+ * @brief A journal open for appending.
+*/
+typedef struct {
+    int fd;                                 /**< the file */
+    int syncEvery;                          /**< moves between fsyncs, or 0 to leave it to the system */
+    int sinceSync;                          /**< moves written since the last fsync */
+    int sinceSnapshot;                      /**< moves added since the last snapshot */
+    size_t length;                          /**< bytes in the buffer */
+    unsigned char buffer[JOURNAL_BUFFER];   /**< records not written yet */
+} Journal;
+
+/**
+ * @brief Starts a new journal, replacing any file of that name, with a
+ * snapshot of the game it starts from.
+ * @param journal the journal to set up.
+ * @param filename the file.
+ * @param start the game.
+ * @param syncEvery moves between fsyncs, or 0 for none.
+ * @return 1 if the file was created, 0 if not.
+*/
+int journalCreate(Journal *journal, const char *filename, const SavedGame *start, int syncEvery);
+
+/**
+ * @brief Reads a journal back and carries on appending to it. The game
+ * is rebuilt from the last snapshot and the moves after it, which are
+ * played again through the rules; whatever follows the last good record
+ * is cut off the file.
+ * @param journal the journal to set up.
+ * @param filename the file.
+ * @param now filled in with the game as the journal left it.
+ * @param syncEvery moves between fsyncs, or 0 for none.
+ * @return 1 if the journal was read and opened, 0 if there is none or it
+ * is not a journal.
+*/
+int journalResume(Journal *journal, const char *filename, SavedGame *now, int syncEvery);
+
+/**
+ * @brief Adds a move that was just played to the buffer, and a snapshot
+ * after it when one is due. Nothing reaches the file before journalFlush,
+ * unless the buffer fills up.
+ * @param journal the journal.
+ * @param move the move.
+ * @param after the game after the move.
+ * @return 1 if it worked, 0 if writing the full buffer failed.
+*/
+int journalMove(Journal *journal, Move move, const SavedGame *after);
+
+/**
+ * @brief Writes the buffer to the file, and fsyncs it when enough moves
+ * have been written since the last time.
+ * @param journal the journal.
+ * @return 1 if it worked, 0 if not.
+*/
+int journalFlush(Journal *journal);
+
+/**
+ * @brief Flushes and closes the journal, with a last fsync if any were asked for.
+ * @param journal the journal.
+ * @return 1 if it worked, 0 if not.
+*/
+int journalClose(Journal *journal);
+
+#endif
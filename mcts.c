@@ -0,0 +1,333 @@
+/**
+ * @file mcts.c
+ * @brief UCT tree search with random games to the end, a tree per thread.
+ * @bug no known bugs
+ *
+*/
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mcts.h"
+#include "random.h"
+
+#define MCTS_EXPLORATION 1.4    // how much UCT favours moves tried less often, about sqrt(2)
+#define MCTS_CLOCK_INTERVAL 64  // random games between looks at the clock
+#define MCTS_NO_NODE UINT32_MAX
+
+/**
+ * @brief What one thread is asked to do.
+*/
+typedef struct {
+    MctsTree *tree;         /**< the tree it grows */
+    uint64_t playouts;      /**< random games to play, or 0 to play until the deadline */
+    double deadline;        /**< when to stop on the monotonic clock, or 0 */
+} MctsJob;
+
+static double monotonicSeconds(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// plays random moves to the end of the game; 1 if the Musketeers win
+static int randomGame(Position pos, int mTurn, uint64_t *random){
+    for (;;){
+        MoveList list;
+
+        int outcome = posOutcome(&pos, mTurn, &list);
+
+        if (outcome != OUTCOME_PLAYING)
+            return outcome == OUTCOME_MUSKETEERS;
+        posMakeMove(&pos, list.moves[randomNext(random) % (uint64_t)list.count], mTurn);
+        mTurn ^= 1;
+    }
+}
+
+// the child UCT likes best; every child is tried once before any is tried twice
+static uint32_t selectChild(const MctsTree *tree, const MctsNode *node){
+    double logVisits = log((double)node->visits);
+    double bestValue = -1.0;
+    uint32_t i, best = node->firstChild;
+
+    for (i = node->firstChild; i < node->firstChild + node->childCount; i++){
+        const MctsNode *child = &tree->nodes[i];
+
+        if (child->visits == 0)
+            return i;
+
+        double value = (double)child->wins / child->visits + MCTS_EXPLORATION * sqrt(logVisits / child->visits);
+        if (value > bestValue){
+            bestValue = value;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// one random game: down the tree, one node added to it, to the end at random, and the result back up
+static void playOnce(MctsTree *tree){
+    uint32_t path[UNDO_CAPACITY + 2];
+    int movers[UNDO_CAPACITY + 2];          // the side that made the move into each node of the path
+    Position pos = tree->pos;
+    int mTurn = tree->mTurn, length = 0, musketeersWin, i;
+    uint32_t index = 0;
+    MctsNode *node = &tree->nodes[0];
+
+    path[length++] = 0;
+    while (node->firstChild != 0){
+        index = selectChild(tree, node);
+        node = &tree->nodes[index];
+        movers[length] = mTurn;
+        posMakeMove(&pos, node->move, mTurn);
+        mTurn ^= 1;
+        path[length++] = index;
+    }
+
+    if (!node->over){
+        MoveList list;
+
+        if (posWinMusketeers(&pos))
+            node->over = 1;
+        else if (posWinEnemies(&pos))
+            node->over = 2;
+        else if (!generateMoves(&pos, mTurn, &list))
+            node->over = 1;                     // the enemies are stuck
+        else if ((node->visits > 0 || index == 0) && tree->used + (uint32_t)list.count <= tree->capacity){
+            // a node gets children on its second visit, so leaves cost one node each
+            node->firstChild = tree->used;
+            node->childCount = (uint8_t)list.count;
+            for (i = 0; i < list.count; i++){
+                MctsNode *child = &tree->nodes[tree->used++];
+
+                memset(child, 0, sizeof(*child));
+                child->move = list.moves[i];
+            }
+
+            index = node->firstChild + (uint32_t)(randomNext(&tree->random) % (uint64_t)list.count);
+            node = &tree->nodes[index];
+            movers[length] = mTurn;
+            posMakeMove(&pos, node->move, mTurn);
+            mTurn ^= 1;
+            path[length++] = index;
+        }
+    }
+
+    if (node->over)
+        musketeersWin = node->over == 1;
+    else
+        musketeersWin = randomGame(pos, mTurn, &tree->random);
+
+    tree->nodes[0].visits++;
+    for (i = 1; i < length; i++){
+        MctsNode *visited = &tree->nodes[path[i]];
+
+        visited->visits++;
+        if (movers[i] == musketeersWin)
+            visited->wins++;
+    }
+}
+
+static int samePosition(const Position *a, const Position *b){
+    return a->musketeers == b->musketeers && a->enemies == b->enemies;
+}
+
+// the node of the tree for a position one or two moves below the root, if there is one
+static uint32_t findRoot(const MctsTree *tree, const Position *pos, int mTurn){
+    const MctsNode *root = &tree->nodes[0];
+    uint32_t i, k;
+
+    if (tree->used == 0)
+        return MCTS_NO_NODE;
+    if (tree->mTurn == mTurn && samePosition(&tree->pos, pos))
+        return 0;
+
+    for (i = root->firstChild; root->firstChild != 0 && i < root->firstChild + root->childCount; i++){
+        const MctsNode *child = &tree->nodes[i];
+        Position once = tree->pos;
+
+        posMakeMove(&once, child->move, tree->mTurn);
+        if (tree->mTurn != mTurn && samePosition(&once, pos))
+            return i;
+
+        for (k = child->firstChild; child->firstChild != 0 && k < child->firstChild + child->childCount; k++){
+            Position twice = once;
+
+            posMakeMove(&twice, tree->nodes[k].move, !tree->mTurn);
+            if (tree->mTurn == mTurn && samePosition(&twice, pos))
+                return k;
+        }
+    }
+    return MCTS_NO_NODE;
+}
+
+// copies the subtree below a node to the spare pool, breadth first, and makes it the tree
+static void reroot(MctsTree *tree, uint32_t index){
+    MctsNode *from = tree->nodes, *to = tree->spare;
+    uint32_t i, count = 1;
+
+    to[0] = from[index];
+    for (i = 0; i < count; i++){
+        MctsNode *node = &to[i];
+
+        if (node->firstChild != 0){
+            memcpy(&to[count], &from[node->firstChild], node->childCount * sizeof(MctsNode));
+            node->firstChild = count;
+            count += node->childCount;
+        }
+    }
+
+    tree->nodes = to;
+    tree->spare = from;
+    tree->used = count;
+}
+
+// gets a tree ready to search a position, keeping what it knows about it
+static void moveTo(MctsTree *tree, const Position *pos, int mTurn){
+    uint32_t index = findRoot(tree, pos, mTurn);
+
+    if (index == MCTS_NO_NODE){
+        memset(&tree->nodes[0], 0, sizeof(MctsNode));
+        tree->used = 1;
+    }
+    else if (index != 0)
+        reroot(tree, index);
+    tree->pos = *pos;
+    tree->mTurn = mTurn;
+}
+
+// grows one tree; at least one random game is always played
+static void grow(const MctsJob *job){
+    MctsTree *tree = job->tree;
+
+    tree->playouts = 0;
+    do {
+        playOnce(tree);
+        tree->playouts++;
+        if (job->deadline > 0 && tree->playouts % MCTS_CLOCK_INTERVAL == 0 && monotonicSeconds() >= job->deadline)
+            break;
+    } while (job->playouts == 0 || tree->playouts < job->playouts);
+}
+
+static void *growThread(void *arg){
+    grow(arg);
+    return NULL;
+}
+
+int mctsInit(Mcts *mcts, int threads, size_t megabytes, uint64_t seed){
+    uint64_t capacity = (uint64_t)megabytes * 1024 * 1024 / (uint64_t)threads / (2 * sizeof(MctsNode));
+    int i;
+
+    if (capacity < MAX_MOVES + 1)
+        capacity = MAX_MOVES + 1;           // room for the root and its children at least
+    if (capacity > UINT32_MAX - 1)
+        capacity = UINT32_MAX - 1;
+
+    mcts->threads = threads;
+    mcts->trees = aligned_alloc(64, (size_t)threads * sizeof(MctsTree));
+    if (mcts->trees == NULL)
+        return 0;
+
+    for (i = 0; i < threads; i++){
+        MctsTree *tree = &mcts->trees[i];
+
+        tree->capacity = (uint32_t)capacity;
+        tree->nodes = malloc(capacity * sizeof(MctsNode));
+        tree->spare = malloc(capacity * sizeof(MctsNode));
+        if (tree->nodes == NULL || tree->spare == NULL){
+            mcts->threads = i + 1;
+            mctsFree(mcts);
+            return 0;
+        }
+    }
+    mctsClear(mcts, seed);
+    return 1;
+}
+
+void mctsFree(Mcts *mcts){
+    int i;
+
+    for (i = 0; i < mcts->threads; i++){
+        free(mcts->trees[i].nodes);
+        free(mcts->trees[i].spare);
+    }
+    free(mcts->trees);
+    mcts->trees = NULL;
+}
+
+void mctsClear(Mcts *mcts, uint64_t seed){
+    int i;
+
+    for (i = 0; i < mcts->threads; i++){
+        mcts->trees[i].used = 0;
+        mcts->trees[i].random = seed ^ (uint64_t)(i + 1) * 0xD1B54A32D192ED03ull;
+    }
+}
+
+int mctsSearch(Mcts *mcts, const Game *game, const MctsSettings *settings, MctsResult *result){
+    double begin = monotonicSeconds();
+    STATS_BEGIN(timer);
+    MctsJob jobs[MCTS_MAX_THREADS];
+    pthread_t handles[MCTS_MAX_THREADS];
+    int started[MCTS_MAX_THREADS];
+    int threads = mcts->threads, i, k;
+    uint64_t playouts = settings->playouts;
+    MoveList list;
+
+    memset(result, 0, sizeof(*result));
+    if (!generateMoves(&game->pos, game->mTurn, &list))
+        return 0;
+    if (playouts == 0 && settings->moveTime <= 0)
+        playouts = MCTS_DEFAULT_PLAYOUTS;
+
+    for (i = 0; i < threads; i++){
+        moveTo(&mcts->trees[i], &game->pos, game->mTurn);
+        jobs[i].tree = &mcts->trees[i];
+        jobs[i].playouts = playouts == 0 ? 0 : (playouts + (uint64_t)(threads - 1 - i)) / (uint64_t)threads;
+        jobs[i].deadline = settings->moveTime > 0 ? begin + settings->moveTime / 1000.0 : 0;
+        if (jobs[i].playouts == 0 && jobs[i].deadline == 0)
+            jobs[i].playouts = 1;
+    }
+
+    // the calling thread grows the first tree
+    for (i = 1; i < threads; i++)
+        started[i] = pthread_create(&handles[i], NULL, growThread, &jobs[i]) == 0;
+    grow(&jobs[0]);
+    for (i = 1; i < threads; i++)
+        if (started[i])
+            pthread_join(handles[i], NULL);
+
+    // every root has the same children in the same order, those of list
+    uint64_t bestVisits = 0, bestWins = 0;
+    for (k = 0; k < list.count; k++){
+        uint64_t visits = 0, wins = 0;
+
+        for (i = 0; i < threads; i++){
+            const MctsTree *tree = &mcts->trees[i];
+            const MctsNode *root = &tree->nodes[0];
+
+            if (root->firstChild != 0 && k < root->childCount){
+                visits += tree->nodes[root->firstChild + (uint32_t)k].visits;
+                wins += tree->nodes[root->firstChild + (uint32_t)k].wins;
+            }
+        }
+        if (k == 0 || visits > bestVisits){
+            bestVisits = visits;
+            bestWins = wins;
+            result->best = list.moves[k];
+        }
+    }
+
+    result->hasMove = 1;
+    result->winRate = bestVisits > 0 ? (double)bestWins / (double)bestVisits : 0.0;
+    result->threads = threads;
+    for (i = 0; i < threads; i++){
+        result->threadPlayouts[i] = mcts->trees[i].playouts;
+        result->playouts += mcts->trees[i].playouts;
+    }
+    result->seconds = monotonicSeconds() - begin;
+    STATS_END(STAT_SEARCH, timer);
+    return 1;
+}
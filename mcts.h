@@ -0,0 +1,118 @@
+/**
+ * @file mcts.h
+ * @brief Monte Carlo Tree Search, a computer player that needs no
+ * evaluation function: it plays random games to the end from the
+ * positions it is looking at and steers more and more of them (with UCT)
+ * towards the moves that win most often. The random games run on the
+ * bitboards, on the stack, and allocate nothing; the tree nodes all come
+ * from a pool allocated once. The tree is kept between moves: the part
+ * below the moves that were actually played becomes the new tree. With
+ * more than one thread, every thread grows a tree of its own from the
+ * same position (root parallelism) and their visit counts are added up.
+ * @bug no known bugs
+ *
+*/
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+
+#define MCTS_MAX_THREADS 256
+#define MCTS_DEFAULT_PLAYOUTS 20000
+
+/**
+ * @brief One position of the tree, reached by its move from its parent.
+ * The children of a node are next to each other in the pool.
+*/
+typedef struct {
+    uint32_t firstChild;    /**< pool index of the first child, 0 until the node is expanded */
+    uint32_t visits;        /**< random games played through the node */
+    uint32_t wins;          /**< how many of them the side that made the move won */
+    Move move;              /**< the move from the parent */
+    uint8_t childCount;     /**< the number of children, one per legal move */
+    uint8_t over;           /**< 1 if the game is over in this position */
+} MctsNode;
+
+/**
+ * @brief The tree of one thread: two pools of nodes, the one in use and
+ * the spare that the tree is copied into when it moves on to a new root.
+*/
+typedef struct {
+    MctsNode *nodes;        /**< the pool in use; the root is nodes[0] */
+    MctsNode *spare;        /**< the other pool */
+    uint32_t capacity;      /**< nodes in each pool */
+    uint32_t used;          /**< nodes of the pool in use */
+    Position pos;           /**< the position at the root */
+    int mTurn;              /**< the side to move at the root */
+    uint64_t random;        /**< state of the thread's random numbers */
+    uint64_t playouts;      /**< random games played in the last search */
+} __attribute__((aligned(64))) MctsTree;
+
+/**
+ * @brief A Monte Carlo player: one tree per thread.
+*/
+typedef struct {
+    MctsTree *trees;        /**< the trees */
+    int threads;            /**< how many there are */
+} Mcts;
+
+/**
+ * @brief How long a search goes on.
+*/
+typedef struct {
+    uint64_t playouts;      /**< random games to play, shared out between the threads, or 0 */
+    int moveTime;           /**< milliseconds the search may take, or 0 */
+} MctsSettings;
+
+/**
+ * @brief The outcome of a search.
+*/
+typedef struct {
+    Move best;              /**< the move played most often from the root */
+    int hasMove;            /**< 0 when the side to move has no legal move at all */
+    double winRate;         /**< how often the side to move won after the best move */
+    uint64_t playouts;      /**< random games played by all the threads */
+    int threads;            /**< threads that searched */
+    uint64_t threadPlayouts[MCTS_MAX_THREADS];  /**< random games played by each thread */
+    double seconds;         /**< how long the search took */
+} MctsResult;
+
+/**
+ * @brief Allocates the trees.
+ * @param mcts the player to set up.
+ * @param threads the number of threads, from 1 to MCTS_MAX_THREADS.
+ * @param megabytes the memory for all the node pools together.
+ * @param seed where the random numbers start.
+ * @return 1 if the memory was allocated, 0 if it was not.
+*/
+int mctsInit(Mcts *mcts, int threads, size_t megabytes, uint64_t seed);
+
+/**
+ * @brief Frees the trees.
+ * @param mcts the player.
+*/
+void mctsFree(Mcts *mcts);
+
+/**
+ * @brief Forgets the trees, for a new game.
+ * @param mcts the player.
+ * @param seed where the random numbers start again.
+*/
+void mctsClear(Mcts *mcts, uint64_t seed);
+
+/**
+ * @brief Picks a move for the side to move. The trees carry on from the
+ * last search if the position is one of its root or the two moves below
+ * it; otherwise they start again.
+ * @param mcts the player.
+ * @param game the game to search. It is not changed.
+ * @param settings how many random games to play or how long to take; with
+ * neither, MCTS_DEFAULT_PLAYOUTS games.
+ * @param result filled in with the move, its win rate and the number of games.
+ * @return 1 if a move was found, 0 if the side to move has none.
+*/
+int mctsSearch(Mcts *mcts, const Game *game, const MctsSettings *settings, MctsResult *result);
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @file moveparse.c
+ * @brief The move line parser.
+ * @bug no known bugs
+ *
+*/
+#include "bitboard.h"
+#include "moveparse.h"
+
+#define TEXT(x) #x
+#define NUMBER(x) TEXT(x)           // a macro's value as a string
+
+// the letter of the last row, for the messages
+#if N == 3
+#define LAST_ROW "C"
+#elif N == 4
+#define LAST_ROW "D"
+#elif N == 5
+#define LAST_ROW "E"
+#elif N == 6
+#define LAST_ROW "F"
+#else
+#define LAST_ROW "G"
+#endif
+
+static const char *skipSpaces(const char *p, const char *end){
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+// parses the line between p and lineEnd, which has no newline in it
+static int parseLine(const char *p, const char *lineEnd, ParsedMove *move){
+    int row, col, dir, interrupt;
+
+    if (lineEnd > p && lineEnd[-1] == '\r')
+        lineEnd--;
+    p = skipSpaces(p, lineEnd);
+    if (p == lineEnd)
+        return PARSE_BLANK;
+
+    // the letter of the row, or the 0 of "0,0=E"
+    interrupt = *p == '0';
+    row = (*p | 0x20) - 'a';                // lower case, whatever the case
+    if (!interrupt && (row < 0 || row >= N))
+        return PARSE_BAD_ROW;
+    p = skipSpaces(p + 1, lineEnd);
+
+    if (p == lineEnd || *p != ',')
+        return PARSE_NO_COMMA;
+    p = skipSpaces(p + 1, lineEnd);
+
+    if (p == lineEnd || (interrupt ? *p != '0' : *p < '1' || *p >= '1' + N))
+        return PARSE_BAD_COLUMN;
+    col = *p - '1';
+    p = skipSpaces(p + 1, lineEnd);
+
+    if (p == lineEnd || *p != '=')
+        return PARSE_NO_EQUALS;
+    p = skipSpaces(p + 1, lineEnd);
+
+    if (p == lineEnd)
+        return PARSE_BAD_DIRECTION;
+    if (interrupt){
+        if ((*p | 0x20) != 'e')
+            return PARSE_BAD_DIRECTION;
+        dir = -1;
+    }
+    else if ((dir = directionFromChar(*p)) < 0)
+        return PARSE_BAD_DIRECTION;
+
+    if (skipSpaces(p + 1, lineEnd) != lineEnd)
+        return PARSE_TRAILING;
+    if (interrupt)
+        return PARSE_INTERRUPT;
+
+    move->row = row;
+    move->col = col;
+    move->dir = dir;
+    return PARSE_MOVE;
+}
+
+int parseMove(const char **text, const char *end, ParsedMove *move){
+    const char *start = *text, *lineEnd = start;
+    STATS_BEGIN(begin);
+
+    while (lineEnd < end && *lineEnd != '\n')
+        lineEnd++;
+    *text = lineEnd < end ? lineEnd + 1 : end;
+
+    int code = parseLine(start, lineEnd, move);
+    STATS_END(STAT_PARSE, begin);
+    return code;
+}
+
+const char *parseMessage(int code){
+    static const char *const messages[PARSE_CODES] = {
+        "A move.",
+        "The line is empty.",
+        "The game is interrupted.",
+        "The row must be a letter from A to " LAST_ROW ".",
+        "A comma must follow the row.",
+        "The column must be a number from 1 to " NUMBER(N) ".",
+        "An equals sign must follow the column.",
+        "The direction must be L, R, U or D, in either case.",
+        "Nothing may follow the direction.",
+    };
+
+    return code >= 0 && code < PARSE_CODES ? messages[code] : "Unknown error.";
+}
@@ -0,0 +1,65 @@
+/**
+ * @file moveparse.h
+ * @brief Reads the moves players type, "A,5=L" or "a,5 = l", and the
+ * "0,0=E" that stops a game, in a single pass over the characters. It
+ * allocates nothing, copies nothing, needs no null at the end of the text
+ * and prints nothing: a line that is not a move gets an error code saying
+ * what is wrong with it, and the caller decides what to show. A buffer
+ * can hold any number of lines, each one read by its own call.
+ *
+ * The grammar: spaces or tabs anywhere between the parts, a row letter
+ * from A to E, a comma, a column digit from 1 to 5 (on the 5x5 board), an
+ * equals sign and a direction letter from L, R, U and D, in either case; a
+ * carriage return before the end of the line is ignored.
+ * @bug no known bugs
+ *
+*/
+#ifndef MOVEPARSE_H
+#define MOVEPARSE_H
+
+#include <stddef.h>
+
+/**
+ * @brief What a line turned out to be. Everything after PARSE_INTERRUPT
+ * is an error.
+*/
+enum {
+    PARSE_MOVE,             /**< a move, filled in */
+    PARSE_BLANK,            /**< nothing but spaces */
+    PARSE_INTERRUPT,        /**< "0,0=E": stop the game */
+    PARSE_BAD_ROW,          /**< the row is not a letter from A to E (on 5x5) */
+    PARSE_NO_COMMA,         /**< no comma after the row */
+    PARSE_BAD_COLUMN,       /**< the column is not a digit from 1 to N */
+    PARSE_NO_EQUALS,        /**< no equals sign after the column */
+    PARSE_BAD_DIRECTION,    /**< the direction is not L, R, U or D */
+    PARSE_TRAILING,         /**< something more after the direction */
+    PARSE_CODES
+};
+
+/**
+ * @brief A move as it was typed, not checked against the board yet.
+*/
+typedef struct {
+    int row;                /**< 0 to N - 1, row A first */
+    int col;                /**< 0 to N - 1, column 1 first */
+    int dir;                /**< DIR_LEFT, DIR_RIGHT, DIR_UP or DIR_DOWN */
+} ParsedMove;
+
+/**
+ * @brief Reads one line.
+ * @param text where the line starts. It is moved past the line and its
+ * newline, to the start of the next line.
+ * @param end the end of the text; a last line needs no newline.
+ * @param move filled in when the line is a move.
+ * @return PARSE_MOVE, PARSE_BLANK, PARSE_INTERRUPT or an error code.
+*/
+int parseMove(const char **text, const char *end, ParsedMove *move);
+
+/**
+ * @brief What an error code means, to show to a player.
+ * @param code a value returned by parseMove.
+ * @return a sentence, without a newline.
+*/
+const char *parseMessage(int code);
+
+#endif
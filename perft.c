@@ -0,0 +1,275 @@
+/**
+ * @file perft.c
+ * @brief Move generation benchmark and check (perft): counts the positions
+ * reached after exactly D moves from a board file, with the same
+ * gameMakeMove and gameUnmakeMove the computer searches with. The moves
+ * from the starting position are shared out between a pool of threads, and
+ * the count below each of them is printed ("divide") so two versions can be
+ * compared move by move. With --verify every position is also checked
+ * against the rules read straight off the char grid, the way the original
+ * validators and makeMove work, and the incremental win counters and keys
+ * against values computed from scratch.
+ * @bug no known bugs
+ *
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "boardio.h"
+#include "game.h"
+
+#define MAX_THREADS 64
+
+/**
+ * @brief The work shared by the threads: one subtree per starting move.
+*/
+typedef struct {
+    const Game *root;               /**< the starting position */
+    const MoveList *moves;          /**< its moves */
+    uint64_t counts[MAX_MOVES];     /**< positions found below each move */
+    int depth;                      /**< moves to look ahead from the start */
+    int verify;                     /**< 1 to check every position */
+    int next;                       /**< the next move to hand out */
+    uint64_t mismatches;            /**< positions that failed a check */
+} PerftJob;
+
+/**
+ * @brief Counts the positions exactly depth moves ahead. A game that is
+ * over has no moves, so it only counts when it is reached at the last move.
+ * @param game the game, played forward and back in place.
+ * @param depth the number of moves still to make.
+ * @param verify 1 to check every position on the way.
+ * @param mismatches increased by one for every check that fails.
+ * @return the number of positions.
+*/
+uint64_t perft(Game *game, int depth, int verify, uint64_t *mismatches);
+
+/**
+ * @brief One thread of the pool: takes starting moves off the job and
+ * counts the positions below them until there are none left.
+ * @param arg the PerftJob.
+ * @return NULL.
+*/
+void *perftWorker(void *arg);
+
+/**
+ * @brief Checks one position of a perft run: the moves against the char
+ * grid rules, the position after each of them against the grid version of
+ * makeMove, and the win counters and Zobrist key against their values
+ * computed from scratch.
+ * @param game the game.
+ * @param list the moves generateMoves gave for it.
+ * @return the number of checks that failed.
+*/
+int verifyPosition(Game *game, const MoveList *list);
+
+/**
+ * @brief Reads the board file and the depth, runs the threads and prints
+ * the divide counts, the total and the speed.
+ * @param argc
+ * @param argv "--threads T" (all the processors by default), "--enemies"
+ * to start with the enemies to move, "--verify", then the board file and
+ * the depth.
+ * @return 0 if the run went through (and every check passed), 1 if not
+*/
+int main (int argc, char *argv[]){
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int mTurn = 1, verify = 0, depth = -1, i;
+    char *filename = NULL;
+
+    for (i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--enemies") == 0)
+            mTurn = 0;
+        else if (strcmp(argv[i], "--verify") == 0)
+            verify = 1;
+        else if (filename == NULL && argv[i][0] != '-')
+            filename = argv[i];
+        else if (filename != NULL && depth < 0 && argv[i][0] != '-')
+            depth = atoi(argv[i]);
+        else {
+            filename = NULL;                    // not something perft knows about
+            break;
+        }
+    }
+    if (filename == NULL || depth < 0 || threads < 1){
+        printf("Usage: %s [--threads T] [--enemies] [--verify] <board file> <depth>\n", argv[0]);
+        return 1;
+    }
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (depth > UNDO_CAPACITY)
+        depth = UNDO_CAPACITY;
+
+    char board[N][N];
+    if (!readBoard(board, filename)){
+        printf("Failed to read the board from the file.\n");
+        return 1;
+    }
+
+    Position pos;
+    Game game;
+    MoveList list;
+    posFromBoard(board, &pos);
+    gameInit(&game, &pos, mTurn);
+
+    PerftJob job;
+    memset(&job, 0, sizeof(job));
+    job.root = &game;
+    job.moves = &list;
+    job.depth = depth;
+    job.verify = verify;
+    list.count = 0;
+    if (depth > 0 && !gameWinGame(&game)){
+        generateMoves(&game.pos, mTurn, &list);
+        if (verify)
+            job.mismatches += (uint64_t)verifyPosition(&game, &list);
+    }
+    if (threads > list.count)
+        threads = list.count > 0 ? list.count : 1;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t pool[MAX_THREADS];
+    for (i = 0; i < threads; i++)
+        pthread_create(&pool[i], NULL, perftWorker, &job);
+    for (i = 0; i < threads; i++)
+        pthread_join(pool[i], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+    uint64_t total = depth == 0 ? 1 : 0;
+    for (i = 0; i < list.count; i++){
+        char text[MOVE_TEXT];
+
+        moveToString(list.moves[i], text);
+        printf("%s: %llu\n", text, (unsigned long long)job.counts[i]);
+        total += job.counts[i];
+    }
+
+    printf("\nDepth %d: %llu nodes in %.3fs (%.2f Mnodes/s) with %d thread%s\n", depth,
+        (unsigned long long)total, seconds, seconds > 0 ? (double)total / seconds / 1e6 : 0.0,
+        threads, threads == 1 ? "" : "s");
+    if (verify)
+        printf("Verification: %s (%llu mismatches)\n", job.mismatches ? "FAILED" : "passed",
+            (unsigned long long)job.mismatches);
+    return job.mismatches != 0;
+}
+
+// takes starting moves off the job until there are none left
+void *perftWorker(void *arg){
+    PerftJob *job = arg;
+    uint64_t mismatches = 0;
+
+    for (;;){
+        int i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i >= job->moves->count)
+            break;
+
+        Game game = *job->root;
+        gameMakeMove(&game, job->moves->moves[i]);
+        job->counts[i] = perft(&game, job->depth - 1, job->verify, &mismatches);
+    }
+
+    __atomic_fetch_add(&job->mismatches, mismatches, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+uint64_t perft(Game *game, int depth, int verify, uint64_t *mismatches){
+    MoveList list;
+    uint64_t nodes = 0;
+    int i;
+
+    if (depth == 0)
+        return 1;
+    if (gameWinGame(game))
+        return 0;
+
+    generateMoves(&game->pos, game->mTurn, &list);
+    if (verify)
+        *mismatches += (uint64_t)verifyPosition(game, &list);
+    else if (depth == 1)
+        return (uint64_t)list.count;            // the leaves need not be played
+
+    for (i = 0; i < list.count; i++){
+        gameMakeMove(game, list.moves[i]);
+        nodes += perft(game, depth - 1, verify, mismatches);
+        gameUnmakeMove(game);
+    }
+    return nodes;
+}
+
+// the moves of the side to move, read off the char grid square by square
+static int gridMoves(char board[][N], int mTurn, Bitboard movers[DIRECTIONS]){
+    static const int rowStep[DIRECTIONS] = { 0, 0, -1, 1 };
+    static const int colStep[DIRECTIONS] = { -1, 1, 0, 0 };
+    int row, col, dir, count = 0;
+
+    for (dir = 0; dir < DIRECTIONS; dir++)
+        movers[dir] = 0;
+
+    for (row = 0; row < N; row++)
+        for (col = 0; col < N; col++)
+            for (dir = 0; dir < DIRECTIONS; dir++){
+                int newRow = row + rowStep[dir], newCol = col + colStep[dir];
+
+                if (newRow < 0 || newRow >= N || newCol < 0 || newCol >= N)
+                    continue;
+                if (mTurn ? board[row][col] == 'M' && board[newRow][newCol] == 'o'
+                          : board[row][col] == 'o' && board[newRow][newCol] == '.'){
+                    movers[dir] |= BB_SQUARE(SQUARE(row, col));
+                    count++;
+                }
+            }
+    return count;
+}
+
+int verifyPosition(Game *game, const MoveList *list){
+    char board[N][N];
+    Bitboard gridMovers[DIRECTIONS], listMovers[DIRECTIONS];
+    int i, dir, failed = 0;
+
+    posToBoard(&game->pos, board);
+
+    // the same moves as the grid rules allow, each once
+    int count = gridMoves(board, game->mTurn, gridMovers);
+    for (dir = 0; dir < DIRECTIONS; dir++)
+        listMovers[dir] = 0;
+    for (i = 0; i < list->count; i++)
+        listMovers[moveDirection(list->moves[i])] |= BB_SQUARE(list->moves[i].from);
+    if (count != list->count)
+        failed++;
+    for (dir = 0; dir < DIRECTIONS; dir++)
+        if (gridMovers[dir] != listMovers[dir])
+            failed++;
+
+    // the counters and keys kept up to date by every move
+    if (gameWinMusketeers(game) != posWinMusketeers(&game->pos) || gameWinEnemies(game) != posWinEnemies(&game->pos))
+        failed++;
+    if (game->keys[SYM_IDENTITY] != zobristKey(&game->pos, game->mTurn))
+        failed++;
+
+    // every move leaves the board the way makeMove would
+    for (i = 0; i < list->count; i++){
+        char after[N][N];
+        Move move = list->moves[i];
+        Position expected;
+
+        memcpy(after, board, sizeof(after));
+        after[move.from / N][move.from % N] = '.';
+        after[move.to / N][move.to % N] = game->mTurn ? 'M' : 'o';
+        posFromBoard(after, &expected);
+
+        gameMakeMove(game, move);
+        if (game->pos.musketeers != expected.musketeers || game->pos.enemies != expected.enemies)
+            failed++;
+        gameUnmakeMove(game);
+    }
+    return failed;
+}
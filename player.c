@@ -0,0 +1,168 @@
+/**
+ * @file player.c
+ * @brief The random, greedy, searching and Monte Carlo players.
+ * @bug no known bugs
+ *
+*/
+#include <string.h>
+#include "player.h"
+
+// any legal move, all equally likely
+static int randomMove(Player *player, const Game *game, Move *move){
+    MoveList list;
+
+    if (!generateMoves(&game->pos, game->mTurn, &list))
+        return 0;
+    *move = list.moves[randomNext(&player->random) % (uint64_t)list.count];
+    return 1;
+}
+
+// the score of a position just reached, for the side that moved into it
+static int moverScore(const Game *game){
+    int moverIsMusketeers = !game->mTurn;
+
+    if (gameWinMusketeers(game))
+        return moverIsMusketeers ? SCORE_WIN : -SCORE_WIN;
+    if (gameWinEnemies(game))
+        return moverIsMusketeers ? -SCORE_WIN : SCORE_WIN;
+    return -evaluate(game);
+}
+
+// the move that looks best one move ahead, ties broken at random
+static int greedyMove(Player *player, const Game *game, Move *move){
+    MoveList list;
+    Game child = *game;
+    int i, best = -SCORE_INFINITE, ties = 0;
+
+    if (!generateMoves(&game->pos, game->mTurn, &list))
+        return 0;
+
+    for (i = 0; i < list.count; i++){
+        gameMakeMove(&child, list.moves[i]);
+        int score = moverScore(&child);
+        gameUnmakeMove(&child);
+
+        if (score > best){
+            best = score;
+            ties = 1;
+            *move = list.moves[i];
+        }
+        else if (score == best && randomNext(&player->random) % (uint64_t)++ties == 0)
+            *move = list.moves[i];
+    }
+    player->score = best;
+    return 1;
+}
+
+static int searchInit(Player *player){
+    player->hasTable = ttInit(&player->tt, (size_t)player->settings.hashMegabytes);
+    return player->hasTable;
+}
+
+static int searchMove(Player *player, const Game *game, Move *move){
+    SearchSettings settings;
+    SearchResult result;
+
+    settings.depth = player->settings.depth;
+    settings.tt = player->hasTable ? &player->tt : NULL;
+    settings.tb = player->settings.tb;
+    settings.threads = 1;                           // players run side by side, a thread each
+    settings.moveTime = 0;
+    settings.nodes = 0;
+    settings.cancel = NULL;
+    settings.keepAge = 0;
+    if (!searchBestMove(game, &settings, &result))
+        return 0;
+    *move = result.best;
+    player->score = result.score;
+    return 1;
+}
+
+static void searchFree(Player *player){
+    if (player->hasTable)
+        ttFree(&player->tt);
+    player->hasTable = 0;
+}
+
+// the tree takes the memory a searching player's table would
+static int mctsPlayerInit(Player *player){
+    player->hasTree = mctsInit(&player->mcts, 1, (size_t)player->settings.hashMegabytes, 0);
+    return player->hasTree;
+}
+
+static int mctsPlayerMove(Player *player, const Game *game, Move *move){
+    MctsSettings settings;
+    MctsResult result;
+
+    settings.playouts = player->settings.playouts;
+    settings.moveTime = 0;
+    if (!mctsSearch(&player->mcts, game, &settings, &result))
+        return 0;
+    *move = result.best;
+    return 1;
+}
+
+static void mctsPlayerFree(Player *player){
+    if (player->hasTree)
+        mctsFree(&player->mcts);
+    player->hasTree = 0;
+}
+
+static const PlayerType playerTypes[] = {
+    { "random", NULL, randomMove, NULL },
+    { "greedy", NULL, greedyMove, NULL },
+    { "search", searchInit, searchMove, searchFree },
+    { "mcts", mctsPlayerInit, mctsPlayerMove, mctsPlayerFree },
+};
+
+#define PLAYER_TYPES ((int)(sizeof(playerTypes) / sizeof(playerTypes[0])))
+
+const PlayerType *playerType(const char *name){
+    int i;
+
+    for (i = 0; i < PLAYER_TYPES; i++)
+        if (strcmp(playerTypes[i].name, name) == 0)
+            return &playerTypes[i];
+    return NULL;
+}
+
+const char *playerNames(void){
+    static char names[64];
+    int i;
+
+    if (names[0] == '\0')
+        for (i = 0; i < PLAYER_TYPES; i++){
+            if (i > 0)
+                strcat(names, "|");
+            strcat(names, playerTypes[i].name);
+        }
+    return names;
+}
+
+int playerInit(Player *player, const PlayerType *type, const PlayerSettings *settings){
+    player->type = type;
+    player->settings = *settings;
+    player->random = 0;
+    player->score = PLAYER_NO_SCORE;
+    player->hasTable = 0;
+    player->hasTree = 0;
+    return type->init == NULL || type->init(player);
+}
+
+void playerNewGame(Player *player, uint64_t seed){
+    player->random = seed;
+    if (player->hasTable)
+        ttClear(&player->tt);
+    if (player->hasTree)
+        mctsClear(&player->mcts, randomNext(&player->random));
+}
+
+int playerMove(Player *player, const Game *game, Move *move){
+    player->score = PLAYER_NO_SCORE;
+    return player->type->move(player, game, move);
+}
+
+void playerFree(Player *player){
+    if (player->type->free != NULL)
+        player->type->free(player);
+}
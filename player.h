@@ -0,0 +1,108 @@
+/**
+ * @file player.h
+ * @brief Computer players that can be plugged into anything that plays
+ * whole games by itself, such as the self-play harness. Every kind of
+ * player is a PlayerType: a name and the functions that set a player up,
+ * pick its moves and free it. A Player is one instance with its own
+ * random numbers and memory, so each thread can run its own players
+ * without sharing anything but the tablebases.
+ * @bug no known bugs
+ *
+*/
+#ifndef PLAYER_H
+#define PLAYER_H
+
+#include <stdint.h>
+#include "game.h"
+#include "search.h"
+#include "mcts.h"
+#include "random.h"
+
+#define PLAYER_NO_SCORE (-SCORE_INFINITE - 1)  // the score of a move picked without one
+
+typedef struct Player Player;
+
+/**
+ * @brief One kind of player.
+*/
+typedef struct {
+    const char *name;                                       /**< the name it is picked by */
+    int (*init)(Player *player);                            /**< sets up its memory; 1 if it worked */
+    int (*move)(Player *player, const Game *game, Move *move); /**< picks a move; 0 if there is none */
+    void (*free)(Player *player);                           /**< frees what init set up */
+} PlayerType;
+
+/**
+ * @brief What every player is given to work with.
+*/
+typedef struct {
+    int depth;              /**< how many moves ahead a searching player looks */
+    int hashMegabytes;      /**< memory for its transposition table */
+    TBProbe *tb;            /**< tablebases to use, or NULL */
+    uint64_t playouts;      /**< random games a Monte Carlo player plays per move */
+} PlayerSettings;
+
+/**
+ * @brief One player.
+*/
+struct Player {
+    const PlayerType *type;         /**< what kind of player it is */
+    PlayerSettings settings;        /**< what it was set up with */
+    uint64_t random;                /**< state of its random numbers */
+    int score;                      /**< the score of its last move for the side that played it, or PLAYER_NO_SCORE */
+    TransTable tt;                  /**< transposition table of a searching player */
+    int hasTable;                   /**< 1 if tt was allocated */
+    Mcts mcts;                      /**< the tree of a Monte Carlo player */
+    int hasTree;                    /**< 1 if mcts was allocated */
+};
+
+/**
+ * @brief Finds a kind of player by its name: "random" plays any legal
+ * move, "greedy" the move that scores best one move ahead, "search"
+ * searches with alpha-beta to the depth it was given, and "mcts" plays
+ * the number of random games it was given with Monte Carlo Tree Search.
+ * @param name the name.
+ * @return the player type, or NULL if there is none by that name.
+*/
+const PlayerType *playerType(const char *name);
+
+/**
+ * @brief The names of every kind of player, for usage messages.
+ * @return the names, separated by '|'.
+*/
+const char *playerNames(void);
+
+/**
+ * @brief Sets a player up.
+ * @param player the player.
+ * @param type what kind of player it is.
+ * @param settings what it works with.
+ * @return 1 if it worked, 0 if there was not enough memory.
+*/
+int playerInit(Player *player, const PlayerType *type, const PlayerSettings *settings);
+
+/**
+ * @brief Gets a player ready for a new game, so that games do not depend
+ * on the ones played before them.
+ * @param player the player.
+ * @param seed where its random numbers start for this game.
+*/
+void playerNewGame(Player *player, uint64_t seed);
+
+/**
+ * @brief Asks a player for its move. Players that score their moves, the
+ * greedy and searching ones, leave the score in player->score.
+ * @param player the player.
+ * @param game the game; it is not changed.
+ * @param move set to the move.
+ * @return 1 if a move was found, 0 if the side to move has none.
+*/
+int playerMove(Player *player, const Game *game, Move *move);
+
+/**
+ * @brief Frees what a player was set up with.
+ * @param player the player.
+*/
+void playerFree(Player *player);
+
+#endif
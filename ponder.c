@@ -0,0 +1,112 @@
+/**
+ * @file ponder.c
+ * @brief The pondering thread.
+ * @bug no known bugs
+ *
+*/
+#include <string.h>
+#include "ponder.h"
+
+static int cancelled(const Ponder *ponder){
+    return __atomic_load_n(&ponder->cancel, __ATOMIC_RELAXED);
+}
+
+// every depth searches all the replies, and the opponent's best moves, the ones the replies score worst, go first at the next
+static void *ponderThread(void *arg){
+    Ponder *ponder = arg;
+    int depth, i, k;
+
+    for (depth = 1; depth <= ponder->settings.depth && !cancelled(ponder); depth++){
+        for (i = 0; i < ponder->count; i++){
+            PonderLine *line = &ponder->lines[i];
+            SearchSettings settings = ponder->settings;
+            SearchResult result;
+            Game child = ponder->game;
+
+            gameMakeMove(&child, line->move);
+            if (gameWinGame(&child))
+                continue;                   // nothing to reply to
+            settings.depth = depth;
+            if (!searchBestMove(&child, &settings, &result))
+                continue;
+            if (cancelled(ponder))
+                return NULL;
+
+            // a reply from the tablebases comes with no depth, and a forced win or loss needs no more
+            line->reply = result.best;
+            line->depth = result.depth > 0 && result.score <= SCORE_MATE_BOUND && result.score >= -SCORE_MATE_BOUND
+                ? result.depth : ponder->settings.depth;
+            line->score = result.score;
+        }
+
+        for (i = 1; i < ponder->count; i++){
+            PonderLine line = ponder->lines[i];
+
+            for (k = i; k > 0 && ponder->lines[k - 1].score > line.score; k--)
+                ponder->lines[k] = ponder->lines[k - 1];
+            ponder->lines[k] = line;
+        }
+    }
+    return NULL;
+}
+
+int ponderStart(Ponder *ponder, const Game *game, const SearchSettings *settings){
+    MoveList list;
+    int i;
+
+    ponder->game = *game;
+    ponder->game.undoCount = 0;             // the searches only need the moves made below it
+    ponder->settings = *settings;
+    ponder->settings.moveTime = 0;
+    ponder->settings.nodes = 0;
+    ponder->settings.cancel = &ponder->cancel;
+    ponder->settings.keepAge = 1;
+    ponder->cancel = 0;
+    ponder->running = 0;
+
+    generateMoves(&game->pos, game->mTurn, &list);
+    ponder->count = list.count;
+    for (i = 0; i < list.count; i++){
+        Game child = ponder->game;
+
+        gameMakeMove(&child, list.moves[i]);
+        memset(&ponder->lines[i], 0, sizeof(PonderLine));
+        ponder->lines[i].move = list.moves[i];
+        ponder->lines[i].pos = child.pos;
+    }
+
+    // every search of this wait shares one age, so their entries stay fresh
+    if (ponder->count == 0)
+        return 0;
+    if (settings->tt)
+        ttNewSearch(settings->tt);
+    if (pthread_create(&ponder->thread, NULL, ponderThread, ponder) != 0)
+        return 0;
+    ponder->running = 1;
+    return 1;
+}
+
+void ponderStop(Ponder *ponder){
+    if (!ponder->running)
+        return;
+    __atomic_store_n(&ponder->cancel, 1, __ATOMIC_RELAXED);
+    pthread_join(ponder->thread, NULL);
+    ponder->running = 0;
+}
+
+int ponderReply(const Ponder *ponder, const Game *game, Move *reply){
+    int i;
+
+    if (game->mTurn == ponder->game.mTurn)
+        return 0;
+    for (i = 0; i < ponder->count; i++){
+        const PonderLine *line = &ponder->lines[i];
+
+        if (line->pos.musketeers == game->pos.musketeers && line->pos.enemies == game->pos.enemies
+                && line->depth >= ponder->settings.depth){
+            *reply = line->reply;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file ponder.h
+ * @brief Thinking on the opponent's time. While the player is typing
+ * their move, a thread searches the position after each move they could
+ * make, one depth at a time, the likeliest moves first, and keeps the
+ * best reply to each. This fills the transposition table, and once the
+ * move arrives, the reply is often known already at the full depth.
+ * @bug no known bugs
+ *
+*/
+#ifndef PONDER_H
+#define PONDER_H
+
+#include <pthread.h>
+#include "game.h"
+#include "search.h"
+
+/**
+ * @brief One move the opponent could make, and the reply found to it.
+*/
+typedef struct {
+    Move move;              /**< the opponent's move */
+    Position pos;           /**< the position after it */
+    Move reply;             /**< the best reply found so far */
+    int depth;              /**< the depth it was found at, 0 until there is one */
+    int score;              /**< its score for the side replying, to put the likeliest moves first */
+} PonderLine;
+
+/**
+ * @brief A pondering thread and what it has found.
+*/
+typedef struct {
+    Game game;                      /**< the position the opponent is to move in */
+    SearchSettings settings;        /**< the search the replies are found with */
+    PonderLine lines[MAX_MOVES];    /**< one per move of the opponent */
+    int count;                      /**< the number of lines */
+    int cancel;                     /**< set to end the pondering */
+    int running;                    /**< 1 while the thread is there to stop */
+    pthread_t thread;
+} Ponder;
+
+/**
+ * @brief Starts pondering while the opponent is to move.
+ * @param ponder filled in; the thread searches with it until ponderStop.
+ * @param game the game, with the opponent to move. It is copied.
+ * @param settings the depth, transposition table and tablebases of the
+ * real search; the time and node limits are not used.
+ * @return 1 if the thread was started, 0 if not.
+*/
+int ponderStart(Ponder *ponder, const Game *game, const SearchSettings *settings);
+
+/**
+ * @brief Stops the thread and waits for it. Nothing happens if it is not running.
+ * @param ponder the pondering.
+*/
+void ponderStop(Ponder *ponder);
+
+/**
+ * @brief The reply found for the position the opponent's move led to,
+ * if it was searched to the full depth. Only to be asked once the
+ * pondering is stopped.
+ * @param ponder the pondering.
+ * @param game the game after the opponent's move.
+ * @param reply filled in with the reply.
+ * @return 1 if there is one, 0 if the move has to be searched.
+*/
+int ponderReply(const Ponder *ponder, const Game *game, Move *reply);
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * @file posrank.c
+ * @brief Ranking and unranking positions, plain and up to symmetry.
+ * @bug no known bugs
+ *
+*/
+#include <stddef.h>
+#include "posrank.h"
+#include "symmetry.h"
+
+uint64_t rankBinomial[SQUARES + 1][SQUARES + 1];
+
+static int tripleCount;                         // canonical Musketeer placements
+static Bitboard tripleMasks[RANK_TRIPLES];      // the canonical placements, in rank order
+static Bitboard triplesByRank[RANK_TRIPLES];    // every placement, by its rank
+static short tripleOf[RANK_TRIPLES];            // canonical placement of every placement
+static unsigned char tripleSym[RANK_TRIPLES];   // symmetry taking a placement to its canonical one
+
+__attribute__((constructor))
+static void rankInit(void){
+    int n, k, a, b, c;
+
+    for (n = 0; n <= SQUARES; n++){
+        rankBinomial[n][0] = 1;
+        for (k = 1; k <= n; k++)
+            rankBinomial[n][k] = rankBinomial[n - 1][k - 1] + (k < n ? rankBinomial[n - 1][k] : 0);
+    }
+
+    // placements come in rank order, so a canonical placement is always met
+    // before the others that map onto it
+    for (c = 2; c < SQUARES; c++)
+        for (b = 1; b < c; b++)
+            for (a = 0; a < b; a++){
+                Bitboard m = BB_SQUARE(a) | BB_SQUARE(b) | BB_SQUARE(c);
+                int t, best = SYM_IDENTITY, r = rankTriple(m);
+
+                for (t = 1; t < SYMMETRIES; t++)
+                    if (symBitboard(t, m) < symBitboard(best, m))
+                        best = t;
+
+                triplesByRank[r] = m;
+                tripleSym[r] = (unsigned char)best;
+                if (best == SYM_IDENTITY || symBitboard(best, m) == m){
+                    tripleMasks[tripleCount] = m;
+                    tripleOf[r] = (short)tripleCount++;
+                }
+                else
+                    tripleOf[r] = tripleOf[rankTriple(symBitboard(best, m))];
+            }
+}
+
+Bitboard unrankSubset(uint64_t rank, int size, int n){
+    Bitboard set = 0;
+    int i, sq = n;
+
+    // largest square first: the biggest sq with C(sq, i) <= rank
+    for (i = size; i > 0; i--){
+        do
+            sq--;
+        while (rankBinomial[sq][i] > rank);
+        set |= BB_SQUARE(sq);
+        rank -= rankBinomial[sq][i];
+    }
+    return set;
+}
+
+Bitboard rankCompress(Bitboard e, Bitboard m){
+    int i, sq[RANK_MUSKETEERS];
+
+    for (i = 0; i < RANK_MUSKETEERS; i++, m &= m - 1)
+        sq[i] = bbFirst(m);
+    for (i = RANK_MUSKETEERS - 1; i >= 0; i--){
+        Bitboard low = BB_SQUARE(sq[i]) - 1;
+        e = (e & low) | ((e >> 1) & ~low);
+    }
+    return e;
+}
+
+Bitboard rankExpand(Bitboard e, Bitboard m){
+    for (; m; m &= m - 1){
+        Bitboard low = (m & -m) - 1;
+        e = (e & low) | ((e << 1) & ~low & ~(m & -m));
+    }
+    return e;
+}
+
+uint64_t rankSize(int enemies){
+    return (uint64_t)RANK_TRIPLES * rankBinomial[RANK_OTHERS][enemies];
+}
+
+uint64_t rankPosition(const Position *pos){
+    uint64_t per = rankBinomial[RANK_OTHERS][bbCount(pos->enemies)];
+    return (uint64_t)rankTriple(pos->musketeers) * per + rankSubset(rankCompress(pos->enemies, pos->musketeers));
+}
+
+void unrankPosition(int enemies, uint64_t rank, Position *pos){
+    uint64_t per = rankBinomial[RANK_OTHERS][enemies];
+
+    pos->musketeers = triplesByRank[rank / per];
+    pos->enemies = rankExpand(unrankSubset(rank % per, enemies, RANK_OTHERS), pos->musketeers);
+}
+
+int rankCanonicalTriples(void){
+    return tripleCount;
+}
+
+Bitboard rankCanonicalTriple(int triple){
+    return tripleMasks[triple];
+}
+
+uint64_t rankCanonicalSize(int enemies){
+    return (uint64_t)tripleCount * rankBinomial[RANK_OTHERS][enemies];
+}
+
+uint64_t rankCanonical(const Position *pos, int *transform){
+    int r = rankTriple(pos->musketeers);
+    int t = tripleSym[r];
+    Bitboard m = symBitboard(t, pos->musketeers);
+    Bitboard e = rankCompress(symBitboard(t, pos->enemies), m);
+
+    if (transform != NULL)
+        *transform = t;
+    return (uint64_t)tripleOf[r] * rankBinomial[RANK_OTHERS][bbCount(pos->enemies)] + rankSubset(e);
+}
+
+void unrankCanonical(int enemies, uint64_t rank, Position *pos){
+    uint64_t per = rankBinomial[RANK_OTHERS][enemies];
+
+    pos->musketeers = tripleMasks[rank / per];
+    pos->enemies = rankExpand(unrankSubset(rank % per, enemies, RANK_OTHERS), pos->musketeers);
+}
@@ -0,0 +1,159 @@
+/**
+ * @file posrank.h
+ * @brief Numbering positions with consecutive integers, without a hash
+ * table. The three Musketeers are one of the C(25,3) = 2300 ways to place
+ * them, and the enemies one of the C(22,k) ways to place k of them on the
+ * squares that are left, both ranked with the combinatorial number system
+ * (a set of squares s1 < s2 < ... < sk ranks as C(s1,1) + C(s2,2) + ... +
+ * C(sk,k)). Within one enemy count the rank of a position is therefore
+ * its Musketeer rank times C(22,k) plus its enemy rank: a bijection onto
+ * 0 to 2300 * C(22,k) - 1, so a dense array indexed by it holds every
+ * position once and nothing else.
+ *
+ * The canonical ranks fold the board symmetries in as well. The Musketeers
+ * are moved to the smallest of the images of their placement (one of 319)
+ * and the enemies through the same symmetry, so symmetric positions mostly
+ * share one rank and tables shrink almost eightfold. Only positions whose
+ * Musketeers are themselves symmetric keep more than one rank.
+ * @bug no known bugs
+ *
+*/
+#ifndef POSRANK_H
+#define POSRANK_H
+
+#include <stdint.h>
+#include "bitboard.h"
+
+#define RANK_MUSKETEERS 3                           // pieces on the Musketeers' side
+#define RANK_OTHERS (SQUARES - RANK_MUSKETEERS)     // squares left for the enemies
+#define RANK_TRIPLES (SQUARES * (SQUARES - 1) * (SQUARES - 2) / 6)    // C(25, 3) = 2300 Musketeer placements on 5x5
+
+/**
+ * @brief Binomial coefficients up to C(SQUARES, SQUARES), filled in at start up.
+*/
+extern uint64_t rankBinomial[SQUARES + 1][SQUARES + 1];
+
+/**
+ * @brief The binomial coefficient C(n, k).
+ * @param n from 0 to SQUARES.
+ * @param k from 0 to n.
+ * @return the number of ways to pick k of n things.
+*/
+static inline uint64_t rankChoose(int n, int k){
+    return rankBinomial[n][k];
+}
+
+/**
+ * @brief Ranks a set of squares among all the sets of the same size.
+ * @param set the squares.
+ * @return the rank, from 0 to C(highest square + 1, size) - 1.
+*/
+static inline uint64_t rankSubset(Bitboard set){
+    uint64_t rank = 0;
+    int i;
+
+    for (i = 1; set; i++, set &= set - 1)
+        rank += rankBinomial[bbFirst(set)][i];
+    return rank;
+}
+
+/**
+ * @brief The set of squares with a given rank.
+ * @param rank the rank, below C(n, size).
+ * @param size the number of squares in the set.
+ * @param n the squares to pick from: 0 to n - 1.
+ * @return the set.
+*/
+Bitboard unrankSubset(uint64_t rank, int size, int n);
+
+/**
+ * @brief Squeezes the Musketeer squares out of a mask, so that the
+ * enemies are numbered among the 22 squares left.
+ * @param e the enemies.
+ * @param m the three Musketeers.
+ * @return the enemies on squares 0 to 21.
+*/
+Bitboard rankCompress(Bitboard e, Bitboard m);
+
+/**
+ * @brief The inverse of rankCompress: opens up a gap at every Musketeer square.
+ * @param e the enemies on squares 0 to 21.
+ * @param m the three Musketeers.
+ * @return the enemies on the board.
+*/
+Bitboard rankExpand(Bitboard e, Bitboard m);
+
+/**
+ * @brief Ranks a placement of the three Musketeers.
+ * @param m the Musketeers.
+ * @return the rank, from 0 to RANK_TRIPLES - 1.
+*/
+static inline int rankTriple(Bitboard m){
+    int a = bbFirst(m);
+    m &= m - 1;
+    int b = bbFirst(m);
+    m &= m - 1;
+    return (int)(rankBinomial[a][1] + rankBinomial[b][2] + rankBinomial[bbFirst(m)][3]);
+}
+
+/**
+ * @brief The number of positions with a given number of enemies (and
+ * three Musketeers).
+ * @param enemies the number of enemies.
+ * @return 2300 * C(22, enemies).
+*/
+uint64_t rankSize(int enemies);
+
+/**
+ * @brief Ranks a position among those with as many enemies.
+ * @param pos a position with three Musketeers.
+ * @return the rank, below rankSize() of its enemy count.
+*/
+uint64_t rankPosition(const Position *pos);
+
+/**
+ * @brief The position with a given rank.
+ * @param enemies the number of enemies.
+ * @param rank the rank.
+ * @param pos filled in with the position.
+*/
+void unrankPosition(int enemies, uint64_t rank, Position *pos);
+
+/**
+ * @brief The number of canonical Musketeer placements.
+ * @return 319 on the 5x5 board.
+*/
+int rankCanonicalTriples(void);
+
+/**
+ * @brief One canonical Musketeer placement, in rank order.
+ * @param triple its number, from 0 to rankCanonicalTriples() - 1.
+ * @return the mask of the three Musketeers.
+*/
+Bitboard rankCanonicalTriple(int triple);
+
+/**
+ * @brief The number of canonical ranks with a given number of enemies.
+ * @param enemies the number of enemies.
+ * @return rankCanonicalTriples() * C(22, enemies).
+*/
+uint64_t rankCanonicalSize(int enemies);
+
+/**
+ * @brief Ranks a position up to symmetry.
+ * @param pos a position with three Musketeers.
+ * @param transform set to the symmetry that turns the position into the
+ * one unrankCanonical gives back, if not NULL.
+ * @return the canonical rank, below rankCanonicalSize() of its enemy count.
+*/
+uint64_t rankCanonical(const Position *pos, int *transform);
+
+/**
+ * @brief The position with a given canonical rank.
+ * @param enemies the number of enemies.
+ * @param rank the canonical rank.
+ * @param pos filled in with the position, with its Musketeers canonical.
+*/
+void unrankCanonical(int enemies, uint64_t rank, Position *pos);
+
+#endif
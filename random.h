@@ -0,0 +1,26 @@
+/**
+ * @file random.h
+ * @brief The random numbers of the computer players: a splitmix64
+ * sequence, small and fast enough to keep one per player or per thread,
+ * and the same on every machine for a given seed.
+ * @bug no known bugs
+ *
+*/
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+/**
+ * @brief The next number of a splitmix64 sequence.
+ * @param state the state of the sequence, moved on by one.
+ * @return a well mixed 64-bit number.
+*/
+static inline uint64_t randomNext(uint64_t *state){
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ * @file rules.c
+ * @brief The char board versions of the move checks, makeMove and the win tests.
+ * @bug no known bugs
+ *
+*/
+#include <stdio.h>
+#include <string.h>
+#include "rules.h"
+
+// make sure the move the user has inserted is valid
+int isValidMove (int row, int col, char direction, char board[][N]){
+    int cnt = 0;
+
+        if (row >= 0 && row < N && col >= 0 && col < N) {
+              if (direction == 'L' || direction == 'l' || direction == 'R' || direction == 'r' ||
+                    direction == 'U' || direction == 'u' || direction == 'D' || direction == 'd')
+                    // Valid move, apply it to the board
+                    cnt++;
+              else 
+                    printf("Invalid direction. Use L/l, R/r, U/u, or D/d.\n");
+        }
+        else 
+              printf("\nThis move gets out of the board or is a wrong move.\n");  
+    
+    if (cnt > 0)
+        return 1;
+    return 0;
+}
+
+// the rows and columns each direction steps by
+static const int rowStep[DIRECTIONS] = { 0, 0, -1, 1 };
+static const int colStep[DIRECTIONS] = { -1, 1, 0, 0 };
+
+// only the two squares of the move are looked at, as posMovers does with shifts
+static int stepFrom(int row, int col, char direction, char board[][N], char piece, char target){
+    int dir = directionFromChar(direction);
+
+    STATS_COUNT(STAT_VALIDATE);
+    if (board[row][col] != piece)
+        return 0;
+    row += rowStep[dir];
+    col += colStep[dir];
+    return row >= 0 && row < N && col >= 0 && col < N && board[row][col] == target;
+}
+
+int isValidMusketeerMove(int row, int col, char direction, char board[][N]){
+    if (isValidMove(row, col, direction, board) && stepFrom(row, col, direction, board, 'M', 'o'))
+        return 1;
+
+    printf("\nNo Musketeers spotted!.\n");
+    return 0;
+}
+
+int isValidEnemyMove(int row, int col, char direction, char board[][N]){
+    if (isValidMove(row, col, direction, board) && stepFrom(row, col, direction, board, 'o', '.'))
+        return 1;
+
+    printf("\nNo enemies spotted!\n");
+    return 0;
+}
+
+// makes the move given by the user
+void makeMove(int row, int col, char direction, char board[][N], int mTurn){
+    int newRow, newCol;
+
+    STATS_COUNT(STAT_MAKE_MOVE);
+
+    if ((direction == 'l') || (direction == 'L')){
+        newRow = row;
+        newCol = col - 1;
+    }
+    else if ((direction == 'r') || (direction == 'R')){
+        newRow = row;
+        newCol = col + 1;
+    }
+    else if ((direction == 'u') || (direction == 'U')){
+        newRow = row - 1;
+        newCol = col;
+    }
+    else if ((direction == 'd') || (direction == 'D')){
+        newRow = row + 1;
+        newCol = col;
+    }
+
+    board[row][col] = '.';
+    if (mTurn)
+        board[newRow][newCol] = 'M';
+    else
+        board[newRow][newCol] = 'o';
+}
+
+// finds the squares of the Musketeers; memchr skips the other squares many bytes at a time
+static int findMusketeers(char board[][N], int squares[SQUARES]){
+    const char *cells = &board[0][0], *end = cells + SQUARES, *p = cells;
+    int count = 0;
+
+    while (p < end && (p = memchr(p, 'M', (size_t)(end - p))) != NULL){
+        squares[count++] = (int)(p - cells);
+        p++;
+    }
+    return count;
+}
+
+// no Musketeer has an enemy next to it
+static int musketeersWon(char board[][N], const int squares[], int count){
+    int i;
+
+    STATS_COUNT(STAT_WIN_TEST);
+    for (i = 0; i < count; i++){
+        int row = squares[i] / N, col = squares[i] % N;
+
+        if ((row > 0 && board[row - 1][col] == 'o') || (row < N - 1 && board[row + 1][col] == 'o')
+                || (col > 0 && board[row][col - 1] == 'o') || (col < N - 1 && board[row][col + 1] == 'o'))
+            return 0;
+    }
+    return 1;
+}
+
+// three Musketeers share a row or a column
+static int enemiesWon(const int squares[], int count){
+    int rows[N] = { 0 }, cols[N] = { 0 };
+    int i;
+
+    STATS_COUNT(STAT_WIN_TEST);
+    if (count == 3)
+        return (squares[0] / N == squares[1] / N && squares[1] / N == squares[2] / N)
+            || (squares[0] % N == squares[1] % N && squares[1] % N == squares[2] % N);
+
+    // a board with some other number of them, counted line by line as posWinEnemies does
+    for (i = 0; i < count; i++){
+        rows[squares[i] / N]++;
+        cols[squares[i] % N]++;
+    }
+    for (i = 0; i < N; i++)
+        if (rows[i] == 3 || cols[i] == 3)
+            return 1;
+    return 0;
+}
+
+// returns 1 if the musketeers have won
+int winMusketeers(char board[][N]){
+    int squares[SQUARES];
+    int count = findMusketeers(board, squares);
+
+    return musketeersWon(board, squares, count);
+}
+
+// returns 1 if the enemies have won
+int winEnemies(char board[][N]){
+    int squares[SQUARES];
+    int count = findMusketeers(board, squares);
+
+    return enemiesWon(squares, count);
+}
+
+// returns 1 if any of the opposing teams have won the game; the board is scanned once for both
+int winGame (char board[][N]){
+    int squares[SQUARES];
+    int count = findMusketeers(board, squares);
+
+    if (musketeersWon(board, squares, count) || enemiesWon(squares, count))
+        return 1;
+    return 0;
+}
+
+
@@ -0,0 +1,93 @@
+/**
+ * @file rules.h
+ * @brief The rules of the game as they are checked on the 2D char board
+ * that the players see: the move validators, makeMove and the win tests.
+ * They only look at the squares they need: the validators at the two
+ * squares of the move, the win tests at the Musketeers and the squares
+ * next to them, so they never convert the whole board.
+ * @bug no known bugs
+ *
+*/
+#ifndef RULES_H
+#define RULES_H
+
+#include "bitboard.h"
+
+/**
+ * @brief Checks and validates whether a move is within the 
+ * boundaries of the game board in general and follows
+ * a valid direction (L/l, R/r, U/u, D/d).
+ * @param row The row where the move is initiated.
+ * @param col The column where the move is initiated.
+ * @param direction The direction of the move (L/l, R/r, U/u, D/d).
+ * @param board the 2D array representing the game board.
+ * @return 1 if the move is valid, 0 if it is not.
+*/
+int isValidMove (int row, int col, char direction, char board[][N]);
+
+/**
+ * @brief This function specifically validates moves 
+ * for the Musketeer player, ensuring that they only 
+ * move in valid directions and that there is a 
+ * Musketeer there at all.
+ * @param row The row where the move is initiated.
+ * @param col The column where the move is initiated.
+ * @param direction The direction of the move (L/l, R/r, U/u, D/d).
+ * @param board the 2D array representing the game board.
+ * @return 1 if the move is valid for a Musketeer, 0 if it is not.
+*/
+int isValidMusketeerMove(int row, int col, char direction, char board[][N]);
+
+/**
+ * @brief  This function specifically validates moves 
+ * for the enemies player, ensuring that they only 
+ * move in valid directions and that there are 
+ * enemies in the specific moves they ask for.
+ * @param row The row where the move is initiated.
+ * @param col The column where the move is initiated.
+ * @param direction The direction of the move (L/l, R/r, U/u, D/d).
+ * @param board the 2D array representing the game board.
+ * @return 1 if the move is valid for an enemy, 0 if it is not.
+*/
+int isValidEnemyMove(int row, int col, char direction, char board[][N]);
+
+/**
+ * @brief This function applies a valid move to the game board 
+ * based on the coordinates and direction as well as whose
+ * turn it is (Musketeer or enemy).
+ * @param row The row where the move is initiated.
+ * @param col The column where the move is initiated.
+ * @param direction The direction of the move (L/l, R/r, U/u, D/d).
+ * @param board the 2D array representing the game board.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+*/
+void makeMove(int row, int col, char direction, char board[][N], int mTurn);
+
+/**
+ * @brief determines the game's outcome by checking if
+ * either the Musketeers or the enemies have won the 
+ * game based on the current game board.
+ * @param board the 2D array representing the game board.
+ * @return 1 if any opposing team has won, 0 if none have won.
+*/
+int winGame(char board[][N]);
+
+/**
+ * @brief checks for victory conditions for the Musketeer 
+ * team, ensuring that the enemies cannot capture all Musketeers,
+ * based on the current game board. 
+ * @param board the 2D array representing the game board.
+ * @return 1 if the Musketeers have won, 0 if they have not.
+*/
+int winMusketeers(char board[][N]);
+
+/**
+ * @brief This function checks for victory conditions 
+ * for the enemy team, such as having all three Musketeers 
+ * in the same row or column, based on the current game board.
+ * @param board the 2D array representing the game board.
+ * @return 1 if the enemies have won, 0 if they have not.
+*/
+int winEnemies(char board[][N]);
+
+#endif
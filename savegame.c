@@ -0,0 +1,84 @@
+/**
+ * @file savegame.c
+ * @brief Writing and reading the binary save file.
+ * @bug no known bugs
+ *
+*/
+#include <stdio.h>
+#include <string.h>
+#include "savegame.h"
+
+int saveWrite(const char *filename, const SavedGame *saved){
+    unsigned char data[SAVE_BYTES];
+
+    memcpy(data, SAVE_MAGIC, 4);
+    data[4] = SAVE_VERSION;
+    data[5] = N;
+    data[6] = (unsigned char)saved->moves;
+    data[7] = (unsigned char)(saved->moves >> 8);
+    bbPut(data + 8, saved->pos.musketeers | (saved->mTurn ? SAVE_SIDE : 0));
+    bbPut(data + 8 + BB_BYTES, saved->pos.enemies);
+
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL)
+        return 0;
+
+    // the whole file goes out in one write when the stream is flushed
+    int ok = fwrite(data, 1, sizeof(data), file) == sizeof(data);
+    if (fclose(file) != 0)
+        ok = 0;
+    return ok;
+}
+
+int saveRead(const char *filename, SavedGame *saved){
+    unsigned char data[SAVE_BYTES + 1];
+    FILE *file = fopen(filename, "rb");
+
+    if (file == NULL)
+        return 0;
+    size_t got = fread(data, 1, sizeof(data), file);
+    fclose(file);
+
+    if (got != SAVE_BYTES || memcmp(data, SAVE_MAGIC, 4) != 0 || data[4] != SAVE_VERSION || data[5] != N)
+        return 0;
+
+    Bitboard first = bbGet(data + 8);
+    saved->pos.musketeers = first & ~SAVE_SIDE;
+    saved->pos.enemies = bbGet(data + 8 + BB_BYTES);
+    saved->mTurn = (first & SAVE_SIDE) != 0;
+    saved->moves = data[6] | data[7] << 8;
+
+    // the masks must stay on the board and never share a square
+    return ((saved->pos.musketeers | saved->pos.enemies) & ~BB_FULL) == 0
+        && (saved->pos.musketeers & saved->pos.enemies) == 0;
+}
+
+int saveIsBinary(const char *filename){
+    char magic[4];
+    FILE *file = fopen(filename, "rb");
+
+    if (file == NULL)
+        return 0;
+    int binary = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, SAVE_MAGIC, 4) == 0;
+    fclose(file);
+    return binary;
+}
+
+int saveFileName(const char *filename, const char *extension, char name[], int size){
+    const char *base = strrchr(filename, '/');
+    int dirLength, nameLength;
+
+    base = base ? base + 1 : filename;
+    dirLength = (int)(base - filename);
+    nameLength = (int)strlen(base);
+
+    if (extension != NULL){
+        const char *dot = strrchr(base, '.');
+        if (dot != NULL && dot != base)
+            nameLength = (int)(dot - base);
+    }
+
+    int length = snprintf(name, (size_t)size, "%.*sout-%.*s%s", dirLength, filename, nameLength, base,
+        extension ? extension : "");
+    return length >= 0 && length < size;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file savegame.h
+ * @brief The compact binary save file: 16 bytes holding the position,
+ * the side to move and how many moves have been played, written with a
+ * single write. Unlike the text board it also remembers whose turn it is,
+ * so a game saved after an enemy move resumes with the Musketeers as it
+ * should. The layout, all little-endian:
+ *
+ * - bytes 0-3: "TMSV"
+ * - byte 4: SAVE_VERSION, byte 5: N
+ * - bytes 6-7: the number of moves played so far
+ * - bytes 8-11: the Musketeer mask, with SAVE_SIDE set when they are to move
+ * - bytes 12-15: the enemy mask
+ *
+ * On boards larger than 5x5 (see bitboard.h) the masks take BB_BYTES
+ * bytes each instead of 4, so the file is longer.
+ * @bug no known bugs
+ *
+*/
+#ifndef SAVEGAME_H
+#define SAVEGAME_H
+
+#include <stdint.h>
+#include "bitboard.h"
+
+#define SAVE_MAGIC "TMSV"
+#define SAVE_VERSION 1
+#define SAVE_BYTES (8 + 2 * BB_BYTES)   // the whole file
+#define SAVE_SIDE BB_SPARE              // the side-to-move bit of the Musketeer mask
+#define SAVE_EXTENSION ".tms"
+
+/**
+ * @brief The formats a game can be saved in, as flags.
+*/
+enum {
+    SAVE_TEXT = 1,          /**< the board grid of readBoard and writeBoard */
+    SAVE_BINARY = 2         /**< the 16 byte file described above */
+};
+
+/**
+ * @brief Everything a save file holds.
+*/
+typedef struct {
+    Position pos;           /**< the pieces */
+    int mTurn;              /**< 1 if the Musketeers are to move, 0 for the enemies */
+    int moves;              /**< moves played so far */
+} SavedGame;
+
+/**
+ * @brief Writes a binary save file.
+ * @param filename the file to write.
+ * @param saved the game to save.
+ * @return 1 if writing works successfully, 0 if it fails.
+*/
+int saveWrite(const char *filename, const SavedGame *saved);
+
+/**
+ * @brief Reads a binary save file back.
+ * @param filename the file to read.
+ * @param saved filled in with the game.
+ * @return 1 if reading works successfully, 0 if the file is missing,
+ * damaged or not a binary save.
+*/
+int saveRead(const char *filename, SavedGame *saved);
+
+/**
+ * @brief Checks whether a file starts like a binary save file.
+ * @param filename the file to look at.
+ * @return 1 if it does, 0 if it does not or cannot be opened.
+*/
+int saveIsBinary(const char *filename);
+
+/**
+ * @brief The name a game read from a file is saved under: "out-" in
+ * front of the file's own name, in the same directory. With an extension
+ * given, it replaces the one the name had.
+ * @param filename the file the game was read from.
+ * @param extension the extension to use (with its dot), or NULL to keep the original one.
+ * @param name filled in with the name.
+ * @param size the size of the name buffer.
+ * @return 1 if the name fits, 0 if it would have been cut short.
+*/
+int saveFileName(const char *filename, const char *extension, char name[], int size);
+
+#endif
@@ -0,0 +1,372 @@
+/**
+ * @file search.c
+ * @brief Negamax alpha-beta search with a transposition table, and
+ * killer move and history heuristics for move ordering, run by one
+ * thread or by several sharing the table.
+ * @bug no known bugs
+ *
+*/
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "search.h"
+
+#define ORDER_TT 2000000        // the stored best move is tried first
+#define ORDER_KILLER 1000000    // killers are tried before anything the history table suggests
+#define CLOCK_INTERVAL 1024     // nodes between looks at the clock, a power of two
+
+// the Musketeers' point of view: lined up Musketeers are close to losing,
+// while every enemy next to a Musketeer keeps the game going
+int evaluate(const Game *game){
+    int i, pairs = 0;
+
+    for (i = 0; i < N; i++){
+        pairs += game->rowCount[i] * (game->rowCount[i] - 1) / 2;
+        pairs += game->colCount[i] * (game->colCount[i] - 1) / 2;
+    }
+
+    int score = -60 * pairs - 8 * game->adjacent - 4 * bbCount(game->pos.enemies);
+    return game->mTurn ? score : -score;
+}
+
+// score of a finished game for the side to move, or 0 if it is not over
+static int gameOverScore(const Game *game, int ply){
+    if (gameWinMusketeers(game))
+        return game->mTurn ? SCORE_WIN - ply : -(SCORE_WIN - ply);
+    if (gameWinEnemies(game))
+        return game->mTurn ? -(SCORE_WIN - ply) : SCORE_WIN - ply;
+    return 0;
+}
+
+// score of a tablebase result for the side to move
+static int tablebaseScore(int mTurn, int result, int distance, int ply){
+    int win = (result == TB_MUSKETEERS_WIN) == (mTurn != 0);
+    int score = distance < 0 ? SCORE_TB_WIN : SCORE_WIN - ply - distance;
+
+    return win ? score : -score;
+}
+
+// helpers are told to stop once the main thread is done; what they were searching is thrown away
+static int stopped(const Searcher *s){
+    return (s->stop != NULL && __atomic_load_n(s->stop, __ATOMIC_RELAXED))
+        || (s->cancel != NULL && __atomic_load_n(s->cancel, __ATOMIC_RELAXED));
+}
+
+static double monotonicSeconds(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// the node budget is checked at every node, the clock only now and then
+static void checkLimits(Searcher *s){
+    if (s->nodes >= s->nodeLimit
+            || (s->deadline > 0 && (s->nodes & (CLOCK_INTERVAL - 1)) == 0 && monotonicSeconds() >= s->deadline))
+        __atomic_store_n(s->stop, 1, __ATOMIC_RELAXED);
+}
+
+static int sameMove(Move a, Move b){
+    return a.from == b.from && a.to == b.to;
+}
+
+// won and lost scores are stored relative to the position, not the root
+static int scoreToTT(int score, int ply){
+    if (score > SCORE_MATE_BOUND)
+        return score + ply;
+    if (score < -SCORE_MATE_BOUND)
+        return score - ply;
+    return score;
+}
+
+static int scoreFromTT(int score, int ply){
+    if (score > SCORE_MATE_BOUND)
+        return score - ply;
+    if (score < -SCORE_MATE_BOUND)
+        return score + ply;
+    return score;
+}
+
+static void scoreMoves(const Searcher *s, const MoveList *list, int ply, Move ttMove, int scores[]){
+    int i, side = s->game.mTurn;
+
+    for (i = 0; i < list->count; i++){
+        Move m = list->moves[i];
+
+        if (sameMove(m, ttMove))
+            scores[i] = ORDER_TT;
+        else if (sameMove(m, s->killers[ply][0]))
+            scores[i] = ORDER_KILLER + 1;
+        else if (sameMove(m, s->killers[ply][1]))
+            scores[i] = ORDER_KILLER;
+        else
+            scores[i] = s->history[side][m.from][moveDirection(m)];
+    }
+}
+
+// swaps the most promising of the remaining moves into place i
+static Move pickMove(MoveList *list, int scores[], int i){
+    int k, best = i;
+
+    for (k = i + 1; k < list->count; k++)
+        if (scores[k] > scores[best])
+            best = k;
+
+    Move m = list->moves[best];
+    int sc = scores[best];
+    list->moves[best] = list->moves[i];
+    scores[best] = scores[i];
+    list->moves[i] = m;
+    scores[i] = sc;
+    return m;
+}
+
+static void rememberCutoff(Searcher *s, Move m, int depth, int ply){
+    if (!sameMove(m, s->killers[ply][0])){
+        s->killers[ply][1] = s->killers[ply][0];
+        s->killers[ply][0] = m;
+    }
+    s->history[s->game.mTurn][m.from][moveDirection(m)] += depth * depth;
+}
+
+static int negamax(Searcher *s, int depth, int alpha, int beta, int ply){
+    Game *game = &s->game;
+    s->nodes++;
+    STATS_COUNT(STAT_NODES);
+    if (s->limited)
+        checkLimits(s);
+    if (stopped(s))
+        return 0;
+
+    int over = gameOverScore(game, ply);
+    if (over)
+        return over;
+    if (s->tb){
+        int result, distance;
+
+        if (tbProbe(s->tb, &game->pos, game->mTurn, &result, &distance))
+            return tablebaseScore(game->mTurn, result, distance, ply);
+    }
+    if (depth == 0 || ply >= MAX_PLY - 1)
+        return evaluate(game);
+
+    // symmetric positions share one entry, with its move stored for the canonical image
+    Move ttMove = { 0, 0 };
+    int alphaStart = alpha, transform;
+    uint64_t key = gameCanonicalKey(game, &transform);
+    TTEntry e;
+    if (s->tt && ttProbe(s->tt, key, &e)){
+        ttMove = symMove(symInverse(transform), e.move);
+        if (e.depth >= depth){
+            int score = scoreFromTT(e.score, ply);
+
+            if (e.bound == BOUND_EXACT)
+                return score;
+            if (e.bound == BOUND_LOWER && score > alpha)
+                alpha = score;
+            else if (e.bound == BOUND_UPPER && score < beta)
+                beta = score;
+            if (alpha >= beta)
+                return score;
+        }
+    }
+
+    MoveList list;
+    int scores[MAX_MOVES];
+    if (!generateMoves(&game->pos, game->mTurn, &list))
+        return -(SCORE_WIN - ply);      // a side that cannot move has lost
+    scoreMoves(s, &list, ply, ttMove, scores);
+
+    int i, best = -SCORE_INFINITE;
+    Move bestMove = list.moves[0];
+    for (i = 0; i < list.count; i++){
+        Move m = pickMove(&list, scores, i);
+
+        gameMakeMove(game, m);
+        int score = -negamax(s, depth - 1, -beta, -alpha, ply + 1);
+        gameUnmakeMove(game);
+        if (stopped(s))
+            return 0;
+
+        if (score > best){
+            best = score;
+            bestMove = m;
+        }
+        if (score > alpha)
+            alpha = score;
+        if (alpha >= beta){
+            STATS_COUNT(STAT_CUTOFF);
+            rememberCutoff(s, m, depth, ply);
+            break;
+        }
+    }
+
+    if (s->tt){
+        int bound = best <= alphaStart ? BOUND_UPPER : best >= beta ? BOUND_LOWER : BOUND_EXACT;
+        ttStore(s->tt, key, depth, scoreToTT(best, ply), bound, symMove(transform, bestMove));
+    }
+    return best;
+}
+
+// searches every move of the root to the given depth; 0 if the search was stopped first
+static int searchRoot(Searcher *s, int depth, Move *best, int *bestScore){
+    MoveList list;
+    int scores[MAX_MOVES];
+
+    generateMoves(&s->game.pos, s->game.mTurn, &list);
+
+    Move ttMove = { 0, 0 };
+    int transform;
+    uint64_t key = gameCanonicalKey(&s->game, &transform);
+    TTEntry e;
+    if (s->tt && ttProbe(s->tt, key, &e))
+        ttMove = symMove(symInverse(transform), e.move);
+    scoreMoves(s, &list, 0, ttMove, scores);
+
+    int i, alpha = -SCORE_INFINITE;
+    for (i = 0; i < list.count; i++){
+        Move m = pickMove(&list, scores, i);
+
+        gameMakeMove(&s->game, m);
+        int score = -negamax(s, depth - 1, -SCORE_INFINITE, -alpha, 1);
+        gameUnmakeMove(&s->game);
+        if (stopped(s))
+            return 0;
+
+        if (score > alpha){
+            alpha = score;
+            *best = m;
+            *bestScore = score;
+        }
+    }
+
+    if (s->tt)
+        ttStore(s->tt, key, depth, scoreToTT(alpha, 0), BOUND_EXACT, symMove(transform, *best));
+    return 1;
+}
+
+// a helper deepens its search one ply at a time until it is stopped; odd
+// helpers stay a ply ahead of even ones, so they do not all search alike
+static void *helperThread(void *arg){
+    Searcher *s = arg;
+    Move best;
+    int depth, score;
+
+    for (depth = 1; depth + (s->id & 1) < MAX_PLY - 1 && !stopped(s); depth++)
+        searchRoot(s, depth + (s->id & 1), &best, &score);
+    return NULL;
+}
+
+static void searcherInit(Searcher *s, const Game *game, const SearchSettings *settings){
+    memset(s, 0, sizeof(*s));
+    s->game = *game;
+    s->game.undoCount = 0;              // the tree only needs the moves made below the root
+    s->tt = settings->tt;
+    s->tb = settings->tb;
+    s->cancel = settings->cancel;
+}
+
+int searchBestMove(const Game *game, const SearchSettings *settings, SearchResult *result){
+    Searcher searcher;
+    Searcher *searchers = &searcher;
+    TransTable *tt = settings->tt;
+    int depth = settings->depth;
+    int threads = settings->threads;
+    int limited = settings->moveTime > 0 || settings->nodes > 0;
+    double begin = monotonicSeconds();
+    STATS_BEGIN(timer);
+
+    memset(result, 0, sizeof(*result));
+    result->score = -SCORE_INFINITE;
+    if (depth < 1)
+        depth = 1;
+
+    if (settings->tb){
+        int tbResult, distance;
+
+        if (tbBestMove(settings->tb, &game->pos, game->mTurn, &result->best, &tbResult, &distance)){
+            result->hasMove = 1;
+            result->score = tablebaseScore(game->mTurn, tbResult, distance, 0);
+            STATS_END(STAT_SEARCH, timer);
+            return 1;
+        }
+    }
+
+    MoveList list;
+    if (!generateMoves(&game->pos, game->mTurn, &list)){
+        STATS_END(STAT_SEARCH, timer);
+        return 0;
+    }
+    if (tt && !settings->keepAge)
+        ttNewSearch(tt);
+
+    // helpers only help through the table
+    if (threads > SEARCH_MAX_THREADS)
+        threads = SEARCH_MAX_THREADS;
+    if (threads < 1 || tt == NULL)
+        threads = 1;
+    if (threads > 1){
+        searchers = aligned_alloc(64, (size_t)threads * sizeof(Searcher));
+        if (searchers == NULL){
+            searchers = &searcher;
+            threads = 1;
+        }
+    }
+
+    pthread_t handles[SEARCH_MAX_THREADS];
+    int started[SEARCH_MAX_THREADS];
+    int i, stop = 0;
+    for (i = 0; i < threads; i++){
+        searcherInit(&searchers[i], game, settings);
+        searchers[i].id = i;
+        if (threads > 1 || limited)
+            searchers[i].stop = &stop;
+    }
+    for (i = 1; i < threads; i++)
+        started[i] = pthread_create(&handles[i], NULL, helperThread, &searchers[i]) == 0;
+
+    // with helpers or limits the main thread deepens one ply at a time:
+    // every step starts from what the helpers have found, and a step cut
+    // short by a limit leaves the move of the step before it
+    Searcher *lead = &searchers[0];
+    lead->nodeLimit = settings->nodes > 0 ? settings->nodes : UINT64_MAX;
+    lead->deadline = settings->moveTime > 0 ? begin + settings->moveTime / 1000.0 : 0;
+    result->best = list.moves[0];
+
+    int step;
+    for (step = threads > 1 || limited ? 1 : depth; step <= depth; step++){
+        Move best;
+        int score;
+
+        if (lead->limited && lead->deadline > 0 && monotonicSeconds() >= lead->deadline)
+            break;
+        if (!searchRoot(lead, step, &best, &score))
+            break;
+        result->best = best;
+        result->score = score;
+        result->depth = step;
+
+        if (limited && (score > SCORE_MATE_BOUND || score < -SCORE_MATE_BOUND))
+            break;                          // a forced win or loss does not change with more depth
+        lead->limited = limited;            // from now on there is a move to fall back on
+    }
+
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (i = 1; i < threads; i++)
+        if (started[i])
+            pthread_join(handles[i], NULL);
+
+    result->hasMove = 1;
+    result->threads = threads;
+    for (i = 0; i < threads; i++){
+        result->threadNodes[i] = searchers[i].nodes;
+        result->nodes += searchers[i].nodes;
+    }
+    result->seconds = monotonicSeconds() - begin;
+
+    if (searchers != &searcher)
+        free(searchers);
+    STATS_END(STAT_SEARCH, timer);
+    return 1;
+}
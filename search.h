@@ -0,0 +1,106 @@
+/**
+ * @file search.h
+ * @brief Alpha-beta (negamax) search so that the computer can play
+ * either the Musketeers or Cardinal Richelieu's men. Scores are always
+ * from the point of view of the side to move. Results are shared through
+ * a transposition table when one is given, and positions covered by the
+ * tablebases are looked up instead of searched. Several threads can
+ * search together (Lazy SMP): they all search the same position, each
+ * with its own move ordering heuristics, and share what they find through
+ * the transposition table.
+ * @bug no known bugs
+ *
+*/
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdint.h>
+#include "game.h"
+#include "tt.h"
+#include "tbprobe.h"
+
+#define SCORE_WIN 10000         // score of a won game, less one for every move it takes
+#define SCORE_INFINITE 30000
+#define MAX_PLY UNDO_CAPACITY   // deeper than any game can last
+#define SCORE_MATE_BOUND (SCORE_WIN - MAX_PLY)  // scores beyond it are forced wins or losses
+#define SCORE_TB_WIN 5000       // a win known from WDL tablebases, which give no distance
+#define SEARCH_MAX_THREADS 256
+
+/**
+ * @brief What a search may use and how far it goes.
+*/
+typedef struct {
+    int depth;              /**< how many moves ahead to look */
+    TransTable *tt;         /**< the transposition table to use, or NULL to search without one */
+    TBProbe *tb;            /**< the tablebases to probe, or NULL */
+    int threads;            /**< how many threads search; more than one needs a transposition table */
+    int moveTime;           /**< milliseconds the search may take, or 0 for no limit */
+    uint64_t nodes;         /**< positions the main thread may visit, or 0 for no limit */
+    const int *cancel;      /**< set from another thread to end the search at once, or NULL */
+    int keepAge;            /**< 1 when the search is one of many that make up a bigger one, whose
+                                 caller ages the table once for all of them with ttNewSearch */
+} SearchSettings;
+
+/**
+ * @brief The outcome of a search.
+*/
+typedef struct {
+    Move best;              /**< the move to play */
+    int hasMove;            /**< 0 when the side to move has no legal move at all */
+    int score;              /**< score of the best move for the side to move */
+    int depth;              /**< depth of the last search that was finished */
+    uint64_t nodes;         /**< positions visited by all the threads */
+    int threads;            /**< threads that searched */
+    uint64_t threadNodes[SEARCH_MAX_THREADS];   /**< positions visited by each thread */
+    double seconds;         /**< how long the search took */
+} SearchResult;
+
+/**
+ * @brief The working state of one search thread: the game it moves up and
+ * down the tree in place, and the move ordering heuristics it learns as it
+ * goes. Each has a cache line of its own so the node counters of threads
+ * next to each other do not slow each other down.
+*/
+typedef struct {
+    Game game;                                  /**< the game being searched */
+    TransTable *tt;                             /**< shared search results, or NULL */
+    TBProbe *tb;                                /**< tablebases, or NULL */
+    Move killers[MAX_PLY][2];                   /**< moves that caused a cutoff at each ply */
+    int history[2][SQUARES][DIRECTIONS];        /**< cutoff counts per side, square and direction */
+    uint64_t nodes;                             /**< positions visited so far */
+    int *stop;                                  /**< set when the threads searching with it should stop, or NULL */
+    const int *cancel;                          /**< set when the whole search is called off, or NULL */
+    int id;                                     /**< 0 for the thread whose result is used, 1 and up for helpers */
+    int limited;                                /**< 1 once this thread should watch the limits below */
+    uint64_t nodeLimit;                         /**< stop on reaching this many nodes */
+    double deadline;                            /**< stop at this time of the monotonic clock, or 0 */
+} __attribute__((aligned(64))) Searcher;
+
+/**
+ * @brief Scores a position without searching, from the point of view
+ * of the side to move. The Musketeers want to stay out of each other's
+ * rows and columns and to run out of enemies to capture; the enemies
+ * want the opposite.
+ * @param game the game.
+ * @return the score for the side to move.
+*/
+int evaluate(const Game *game);
+
+/**
+ * @brief Picks the best move for the side to move: straight from the
+ * tablebases when they cover the position, otherwise by searching it
+ * to a fixed depth. With a time or node limit the search deepens one ply
+ * at a time, up to that depth, until the limit is reached, and the move
+ * of the last depth finished is played; the first ply is always finished,
+ * so there is always a move. With more than one thread the helpers keep
+ * deepening their own searches, filling the table for the main thread,
+ * until the main thread has its answer. A search that is cancelled
+ * stops where it is, with the move of the last depth finished, if any.
+ * @param game the game to search. It is not changed.
+ * @param settings the depth, transposition table and tablebases to use.
+ * @param result filled in with the best move and its score.
+ * @return 1 if a move was found, 0 if the side to move has none.
+*/
+int searchBestMove(const Game *game, const SearchSettings *settings, SearchResult *result);
+
+#endif
@@ -0,0 +1,339 @@
+/**
+ * @file selfplay.c
+ * @brief Plays many games between two computer players at once, to tune
+ * and compare them. Every game is independent: it has its own Game and
+ * starts its players afresh from a seed made from its number, so the
+ * results do not depend on the number of threads or on which thread
+ * plays which game. The games are shared out by the work-stealing pool,
+ * and each worker keeps its own players and statistics, so nothing is
+ * locked or printed while the games are played. The statistics are added
+ * up and printed at the end.
+ *
+ * With "--export FILE" every position a player moved from goes to a
+ * training data file (see traindata.h) with the player's score and the
+ * result, once its game is over; "--augment" adds every symmetric image.
+ * The workers only copy a finished game's records into the writer's
+ * buffer, and a thread of its own writes them out.
+ * @bug no known bugs
+ *
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "boardio.h"
+#include "player.h"
+#include "traindata.h"
+#include "workpool.h"
+
+#define DEFAULT_GAMES 1000
+#define DEFAULT_OPENING 4           // random moves at the start of every game, so games differ
+#define DEFAULT_DEPTH 4             // search depth of the searching player
+#define DEFAULT_HASH 4              // megabytes of transposition table per searching player
+#define DEFAULT_PLAYOUTS 2000      // random games per move of a Monte Carlo player
+#define DEFAULT_SEED 1
+#define LENGTHS (UNDO_CAPACITY + 1) // every game length there can be
+
+/**
+ * @brief The results of the games played by one worker (or, added up,
+ * by all of them).
+*/
+typedef struct {
+    uint64_t games;                 /**< games played */
+    uint64_t musketeerWins;         /**< games the Musketeers won */
+    uint64_t enemyWins;             /**< games Cardinal Richelieu's men won */
+    uint64_t unfinished;            /**< games stopped because they ran too long */
+    uint64_t moves;                 /**< moves played in all the games */
+    uint64_t lengths[LENGTHS];      /**< games by their number of moves */
+} __attribute__((aligned(64))) SelfPlayStats;
+
+/**
+ * @brief Everything the games share, and each worker's own players and results.
+*/
+typedef struct {
+    Position start;                                         /**< where every game starts */
+    int opening;                                            /**< random moves to start with */
+    uint64_t seed;                                          /**< the seed of the whole run */
+    Player players[WORKPOOL_MAX_WORKERS][2];                /**< per worker: [1] the Musketeers, [0] the enemies */
+    SelfPlayStats stats[WORKPOOL_MAX_WORKERS];              /**< per worker */
+    TrainWriter *export;                                    /**< where the positions go, or NULL */
+    int augment;                                            /**< 1 to export every symmetric image too */
+} SelfPlay;
+
+/**
+ * @brief Plays one whole game: a task of the work pool.
+ * @param task the number of the game.
+ * @param worker the worker playing it.
+ * @param context the SelfPlay.
+*/
+void playGame(uint64_t task, int worker, void *context);
+
+/**
+ * @brief Prints the results of the run.
+ * @param total the statistics of every game.
+ * @param names the players, [1] for the Musketeers and [0] for the enemies.
+ * @param seconds how long the games took.
+ * @param workers the number of threads.
+ * @param histogram 1 to also print how many games lasted each number of moves.
+*/
+void printStats(const SelfPlayStats *total, const char *names[2], double seconds, int workers, int histogram);
+
+/**
+ * @brief Reads the options, plays the games and prints the results.
+ * @param argc
+ * @param argv "--games N", "--threads T", "--musketeers P" and "--enemies P"
+ * for the players, "--depth D" and "--hash MB" for searching players,
+ * "--playouts N" for Monte Carlo players,
+ * "--tb DIR", "--opening K", "--seed S", "--histogram", "--export FILE"
+ * and "--augment" for training data, and an optional board file to start
+ * from (the usual starting board if there is none).
+ * @return 0 if the games were played, 1 if not
+*/
+int main (int argc, char *argv[]){
+    static SelfPlay selfPlay;
+    const char *names[2] = { "random", "random" };
+    const PlayerType *types[2];
+    PlayerSettings settings;
+    uint64_t games = DEFAULT_GAMES;
+    int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int histogram = 0, i, side;
+    char *filename = NULL, *tablebaseDir = NULL, *exportFile = NULL;
+
+    settings.depth = DEFAULT_DEPTH;
+    settings.hashMegabytes = DEFAULT_HASH;
+    settings.tb = NULL;
+    settings.playouts = DEFAULT_PLAYOUTS;
+    selfPlay.opening = DEFAULT_OPENING;
+    selfPlay.seed = DEFAULT_SEED;
+
+    for (i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+            games = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--musketeers") == 0 && i + 1 < argc)
+            names[1] = argv[++i];
+        else if (strcmp(argv[i], "--enemies") == 0 && i + 1 < argc)
+            names[0] = argv[++i];
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            settings.depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc)
+            settings.hashMegabytes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--playouts") == 0 && i + 1 < argc)
+            settings.playouts = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--tb") == 0 && i + 1 < argc)
+            tablebaseDir = argv[++i];
+        else if (strcmp(argv[i], "--opening") == 0 && i + 1 < argc)
+            selfPlay.opening = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            selfPlay.seed = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--histogram") == 0)
+            histogram = 1;
+        else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc)
+            exportFile = argv[++i];
+        else if (strcmp(argv[i], "--augment") == 0)
+            selfPlay.augment = 1;
+        else if (argv[i][0] != '-' && filename == NULL)
+            filename = argv[i];
+        else
+            workers = 0;                        // anything else is a mistake
+    }
+
+    types[0] = playerType(names[0]);
+    types[1] = playerType(names[1]);
+    if (workers < 1 || workers > WORKPOOL_MAX_WORKERS || types[0] == NULL || types[1] == NULL
+            || settings.depth < 1 || settings.hashMegabytes < 1 || selfPlay.opening < 0){
+        printf("Usage: %s [--games N] [--threads T] [--musketeers %s] [--enemies %s] [--depth D] [--hash MB] [--playouts N]"
+               " [--tb DIR] [--opening K] [--seed S] [--histogram] [--export FILE [--augment]] [board file]\n", argv[0], playerNames(), playerNames());
+        return 1;
+    }
+
+    char board[N][N];
+    if (filename != NULL){
+        if (!readBoard(board, filename)){
+            printf("Failed to read the board from the file.\n");
+            return 1;
+        }
+        posFromBoard(board, &selfPlay.start);
+    }
+    else
+        posStart(&selfPlay.start);
+
+    TBProbe tb;
+    if (tablebaseDir != NULL){
+        tbProbeOpen(&tb, tablebaseDir);
+        settings.tb = &tb;
+    }
+
+    for (i = 0; i < workers; i++)
+        for (side = 0; side < 2; side++)
+            if (!playerInit(&selfPlay.players[i][side], types[side], &settings)){
+                printf("Not enough memory for the players.\n");
+                return 1;
+            }
+
+    TrainWriter writer;
+    if (exportFile != NULL){
+        if (!trainWriterOpen(&writer, exportFile)){
+            printf("Failed to create %s.\n", exportFile);
+            return 1;
+        }
+        selfPlay.export = &writer;
+    }
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    if (!workPoolRun(workers, games, playGame, &selfPlay)){
+        printf("Failed to start the threads.\n");
+        return 1;
+    }
+    if (selfPlay.export != NULL && !trainWriterClose(&writer)){
+        printf("Failed to write %s.\n", exportFile);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    SelfPlayStats total;
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < workers; i++){
+        const SelfPlayStats *stats = &selfPlay.stats[i];
+        int length;
+
+        total.games += stats->games;
+        total.musketeerWins += stats->musketeerWins;
+        total.enemyWins += stats->enemyWins;
+        total.unfinished += stats->unfinished;
+        total.moves += stats->moves;
+        for (length = 0; length < LENGTHS; length++)
+            total.lengths[length] += stats->lengths[length];
+
+        for (side = 0; side < 2; side++)
+            playerFree(&selfPlay.players[i][side]);
+    }
+    if (settings.tb != NULL)
+        tbProbeClose(&tb);
+
+    printStats(&total, names, (double)(end.tv_sec - begin.tv_sec) + (double)(end.tv_nsec - begin.tv_nsec) / 1e9,
+        workers, histogram);
+
+    // read back through the mapping, as a training loader would
+    TrainData data;
+    if (exportFile != NULL){
+        if (!trainOpen(&data, exportFile)){
+            printf("Failed to read %s back.\n", exportFile);
+            return 1;
+        }
+        printf("%llu positions exported to %s\n", (unsigned long long)data.count, exportFile);
+        trainClose(&data);
+    }
+    return 0;
+}
+
+void playGame(uint64_t task, int worker, void *context){
+    SelfPlay *selfPlay = context;
+    SelfPlayStats *stats = &selfPlay->stats[worker];
+    Player *players = selfPlay->players[worker];
+    uint64_t random = selfPlay->seed ^ (task + 1) * 0xD1B54A32D192ED03ull;
+    TrainRecord records[LENGTHS], images[LENGTHS * SYMMETRIES];
+    int i, count = 0, result = 0;
+    Game game;
+
+    gameInit(&game, &selfPlay->start, 1);               // the Musketeers always start
+    playerNewGame(&players[0], randomNext(&random));
+    playerNewGame(&players[1], randomNext(&random));
+
+    for (;;){
+        MoveList list;
+        Move move;
+        int outcome = gameOutcome(&game, &list);
+
+        if (outcome == OUTCOME_MUSKETEERS){
+            stats->musketeerWins++;
+            result = 1;
+            break;
+        }
+        if (outcome == OUTCOME_ENEMIES){
+            stats->enemyWins++;
+            result = -1;
+            break;
+        }
+
+        if (game.ply < selfPlay->opening)
+            move = list.moves[randomNext(&random) % (uint64_t)list.count];
+        else {
+            // there is a move, so a player only fails to find one when something is wrong with it
+            if (!playerMove(&players[game.mTurn], &game, &move)){
+                stats->unfinished++;
+                break;
+            }
+
+            // the positions the players chose a move in, scored if they gave one
+            if (selfPlay->export != NULL){
+                TrainRecord *record = &records[count++];
+                int score = players[game.mTurn].score;
+
+                record->musketeers = game.pos.musketeers;
+                record->enemies = game.pos.enemies;
+                record->score = (int16_t)(score == PLAYER_NO_SCORE ? TRAIN_NO_SCORE : score);
+                record->mTurn = (uint8_t)game.mTurn;
+                record->ply = (uint16_t)game.ply;
+            }
+        }
+
+        if (!gameMakeMove(&game, move)){
+            stats->unfinished++;
+            break;
+        }
+    }
+
+    stats->games++;
+    stats->moves += (uint64_t)game.ply;
+    stats->lengths[game.ply]++;
+
+    if (selfPlay->export == NULL || count == 0)
+        return;
+    for (i = 0; i < count; i++){
+        records[i].result = (int8_t)result;
+        records[i].length = (uint16_t)game.ply;
+    }
+
+    // the whole game goes to the writer at once, so it is locked once per game
+    if (selfPlay->augment){
+        int total = 0;
+
+        for (i = 0; i < count; i++)
+            total += trainAugment(&records[i], images + total);
+        trainWriterAdd(selfPlay->export, images, (size_t)total);
+    }
+    else
+        trainWriterAdd(selfPlay->export, records, (size_t)count);
+}
+
+void printStats(const SelfPlayStats *total, const char *names[2], double seconds, int workers, int histogram){
+    double games = total->games > 0 ? (double)total->games : 1.0;
+    int length, shortest = -1, longest = 0;
+
+    for (length = 0; length < LENGTHS; length++)
+        if (total->lengths[length] > 0){
+            if (shortest < 0)
+                shortest = length;
+            longest = length;
+        }
+
+    printf("%llu games in %.3fs (%.1f games/s) with %d thread%s\n", (unsigned long long)total->games,
+        seconds, seconds > 0 ? (double)total->games / seconds : 0.0, workers, workers == 1 ? "" : "s");
+    printf("The Musketeers (%s) won %llu (%.1f%%)\n", names[1], (unsigned long long)total->musketeerWins,
+        100.0 * (double)total->musketeerWins / games);
+    printf("Cardinal Richelieu's men (%s) won %llu (%.1f%%)\n", names[0], (unsigned long long)total->enemyWins,
+        100.0 * (double)total->enemyWins / games);
+    if (total->unfinished > 0)
+        printf("Unfinished: %llu\n", (unsigned long long)total->unfinished);
+    printf("Moves per game: %.2f on average, %d to %d\n", (double)total->moves / games,
+        shortest < 0 ? 0 : shortest, longest);
+
+    if (histogram)
+        for (length = 0; length < LENGTHS; length++)
+            if (total->lengths[length] > 0)
+                printf("%3d moves: %llu\n", length, (unsigned long long)total->lengths[length]);
+}
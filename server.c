@@ -0,0 +1,249 @@
+/**
+ * @file server.c
+ * @brief Hosts many games at once over TCP from one thread: a single epoll
+ * loop waits on the listening socket and on every connection, and each
+ * connection plays its own game from the board file (see session.h for
+ * what the clients send and get back). Sockets never block, so a slow or
+ * silent client holds up no one else; a client that stops reading its
+ * answers just stops being read from until it catches up.
+ * @bug no known bugs
+ *
+*/
+#define _GNU_SOURCE            // for accept4
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "boardio.h"
+#include "savegame.h"
+#include "session.h"
+
+#define DEFAULT_PORT 7777
+#define DEFAULT_SESSIONS 4096       // games at the same time
+#define SERVER_EVENTS 256           // events taken from epoll at a time
+#define SERVER_LISTENER UINT32_MAX  // the epoll tag of the listening socket
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void onInterrupt(int signal){
+    (void)signal;
+    interrupted = 1;
+}
+
+// the socket the clients connect to, or -1
+static int openListener(int port){
+    struct sockaddr_in address;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0), yes = 1;
+
+    if (fd < 0)
+        return -1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((uint16_t)port);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// tells epoll what a session waits for: more input, or room to send its output
+static void watch(int epoll, const Session *session, uint32_t index, int operation){
+    struct epoll_event event;
+
+    event.events = session->outStart < session->outLength ? EPOLLOUT : EPOLLIN;
+    event.data.u32 = index;
+    epoll_ctl(epoll, operation, session->fd, &event);
+}
+
+static void endSession(int epoll, SessionTable *table, uint32_t index){
+    Session *session = sessionAt(table, index);
+
+    epoll_ctl(epoll, EPOLL_CTL_DEL, session->fd, NULL);
+    close(session->fd);
+    sessionClose(table, index);
+}
+
+// sends what it can; 0 if the connection is gone
+static int flush(Session *session){
+    while (session->outStart < session->outLength){
+        ssize_t sent = send(session->fd, session->out + session->outStart,
+            session->outLength - session->outStart, MSG_NOSIGNAL);
+
+        if (sent < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        session->outStart += (size_t)sent;
+    }
+    return 1;
+}
+
+// takes every connection waiting; those that find the table full are turned away
+static void acceptClients(int epoll, int listener, SessionTable *table){
+    for (;;){
+        int fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK);
+
+        if (fd < 0)
+            return;
+
+        uint32_t index = sessionOpen(table, fd);
+        if (index == SESSION_NONE){
+            close(fd);
+            continue;
+        }
+
+        Session *session = sessionAt(table, index);
+        if (!flush(session)){
+            close(fd);
+            sessionClose(table, index);
+            continue;
+        }
+        watch(epoll, session, index, EPOLL_CTL_ADD);
+    }
+}
+
+// reads, answers and sends for one session until it has to wait
+static void serve(int epoll, SessionTable *table, uint32_t index){
+    Session *session = sessionAt(table, index);
+    int waitedForOutput = session->outStart < session->outLength;
+
+    for (;;){
+        if (!flush(session)){
+            endSession(epoll, table, index);
+            return;
+        }
+        if (session->outStart < session->outLength)
+            break;                          // the client is not keeping up with its answers
+        if (session->closing){
+            endSession(epoll, table, index);
+            return;
+        }
+
+        // input left over from before is answered before anything new is read
+        sessionHandleInput(session);
+        if (session->outStart < session->outLength || session->closing)
+            continue;
+
+        ssize_t got = recv(session->fd, session->in + session->inLength, SESSION_INPUT - session->inLength, 0);
+        if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)){
+            endSession(epoll, table, index);
+            return;
+        }
+        if (got < 0)
+            break;
+        session->inLength += (size_t)got;
+    }
+
+    if (waitedForOutput != (session->outStart < session->outLength))
+        watch(epoll, session, index, EPOLL_CTL_MOD);
+}
+
+/**
+ * @brief Reads the options and the board, and serves games until it is
+ * stopped with Ctrl-C.
+ * @param argc
+ * @param argv "--port P" to listen on (7777 by default), "--sessions S"
+ * for the most games at the same time, "--enemies" to start a text board
+ * with the enemies to move, and the board file every game starts from (a
+ * text board or a binary save).
+ * @return 0 when it was stopped, 1 if it could not start
+*/
+int main (int argc, char *argv[]){
+    char *filename = NULL;
+    int port = DEFAULT_PORT, capacity = DEFAULT_SESSIONS, enemiesFirst = 0, mistake = 0, i;
+
+    for (i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+            port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc)
+            capacity = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--enemies") == 0)
+            enemiesFirst = 1;
+        else if (argv[i][0] != '-' && filename == NULL)
+            filename = argv[i];
+        else
+            mistake = 1;
+    }
+    if (mistake || filename == NULL || port < 1 || port > 65535 || capacity < 1){
+        printf("Usage: %s [--port P] [--sessions S] [--enemies] <board file>\n", argv[0]);
+        return 1;
+    }
+
+    SavedGame start;
+    if (saveIsBinary(filename)){
+        if (!saveRead(filename, &start)){
+            printf("The saved game is damaged: %s\n", filename);
+            return 1;
+        }
+    }
+    else {
+        char board[N][N];
+
+        if (!readBoard(board, filename)){
+            printf("Failed to read the board from the file.\n");
+            return 1;
+        }
+        posFromBoard(board, &start.pos);
+        start.mTurn = !enemiesFirst;
+    }
+
+    SessionTable table;
+    if (!sessionTableInit(&table, (uint32_t)capacity, &start.pos, start.mTurn)){
+        printf("Not enough memory for %d sessions.\n", capacity);
+        return 1;
+    }
+
+    int listener = openListener(port);
+    int epoll = epoll_create1(0);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = SERVER_LISTENER;
+    if (listener < 0 || epoll < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event) != 0){
+        printf("Cannot listen on port %d: %s\n", port, strerror(errno));
+        sessionTableFree(&table);
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onInterrupt;        // no SA_RESTART, so epoll_wait wakes up
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Serving up to %d games on port %d.\n", capacity, port);
+    fflush(stdout);
+
+    struct epoll_event events[SERVER_EVENTS];
+    while (!interrupted){
+        int count = epoll_wait(epoll, events, SERVER_EVENTS, -1);
+
+        if (count < 0 && errno != EINTR){
+            printf("epoll_wait failed: %s\n", strerror(errno));
+            break;
+        }
+        for (i = 0; i < count; i++){
+            if (events[i].data.u32 == SERVER_LISTENER)
+                acceptClients(epoll, listener, &table);
+            else if (sessionAt(&table, events[i].data.u32)->fd >= 0)
+                serve(epoll, &table, events[i].data.u32);
+        }
+    }
+
+    uint32_t k;
+    for (k = 0; k < table.slab.count; k++)
+        if (sessionAt(&table, k)->fd >= 0)
+            endSession(epoll, &table, k);
+    printf("Stopped.\n");
+    close(epoll);
+    close(listener);
+    sessionTableFree(&table);
+    return 0;
+}
@@ -0,0 +1,184 @@
+/**
+ * @file session.c
+ * @brief The session table and the protocol of one session.
+ * @bug no known bugs
+ *
+*/
+#include <string.h>
+#include "moveparse.h"
+#include "session.h"
+
+int sessionTableInit(SessionTable *table, uint32_t capacity, const Position *start, int mTurn){
+    uint32_t i;
+
+    if (!slabInit(&table->slab, sizeof(Session), capacity))
+        return 0;
+    table->start = *start;
+    table->startTurn = mTurn;
+    for (i = 0; i < capacity; i++)
+        sessionAt(table, i)->fd = -1;
+    return 1;
+}
+
+void sessionTableFree(SessionTable *table){
+    slabFree(&table->slab);
+}
+
+// the answer to one line or frame: the status, then the board and the side to move
+static void answer(Session *session, int status){
+    const Game *game = &session->game;
+
+    if (session->binary){
+        unsigned char *frame = (unsigned char *)session->out + session->outLength;
+
+        frame[0] = (unsigned char)status;
+        frame[1] = (unsigned char)game->mTurn;
+        frame[2] = frame[3] = 0;
+        bbPut(frame + 4, game->pos.musketeers);
+        bbPut(frame + 4 + BB_BYTES, game->pos.enemies);
+        session->outLength += SESSION_FRAME;
+        return;
+    }
+
+    static const char *const words[] = { "ok", "illegal", "error", "musketeers", "enemies", "new" };
+    char board[N][N], *line = session->out + session->outLength;
+    int row, col, length = (int)strlen(words[status]);
+
+    memcpy(line, words[status], (size_t)length);
+    line[length++] = ' ';
+    posToBoard(&game->pos, board);
+    for (row = 0; row < N; row++)
+        for (col = 0; col < N; col++)
+            line[length++] = board[row][col];
+    line[length++] = ' ';
+    line[length++] = game->mTurn ? 'm' : 'e';
+    line[length++] = '\n';
+    session->outLength += (size_t)length;
+}
+
+// whether the game is over, and who won; the enemies lose when they cannot move
+static int gameStatus(const Game *game){
+    MoveList list;
+
+    switch (gameOutcome(game, &list)){
+        case OUTCOME_MUSKETEERS: return SESSION_MUSKETEERS_WIN;
+        case OUTCOME_ENEMIES:    return SESSION_ENEMIES_WIN;
+    }
+    return SESSION_OK;
+}
+
+// plays a move if the rules allow it, and says what became of it
+static int tryMove(Session *session, Move move){
+    int status = gameStatus(&session->game);
+
+    if (status != SESSION_OK)
+        return status;                      // the game is over, nothing moves any more
+    if (!isLegalMove(&session->game.pos, session->game.mTurn, move))
+        return SESSION_ILLEGAL;
+    gameMakeMove(&session->game, move);
+    return gameStatus(&session->game);
+}
+
+// whether a line is one of the words that are not moves
+static int isCommand(const char *line, const char *end, const char *word){
+    size_t length = strlen(word);
+
+    while (end > line && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t'))
+        end--;
+    return (size_t)(end - line) == length && memcmp(line, word, length) == 0;
+}
+
+// one text line, from line up to its newline at end
+static void handleLine(Session *session, const char *line, const char *end){
+    ParsedMove parsed;
+    const char *cursor = line;
+    int code = parseMove(&cursor, end, &parsed);
+
+    if (code == PARSE_INTERRUPT){
+        session->closing = 1;
+        answer(session, gameStatus(&session->game));
+    }
+    else if (code == PARSE_MOVE){
+        Move move = moveAt(parsed.row, parsed.col, parsed.dir);
+        int legal = session->game.mTurn ? posIsValidMusketeerMove(&session->game.pos, parsed.row, parsed.col, parsed.dir)
+                                        : posIsValidEnemyMove(&session->game.pos, parsed.row, parsed.col, parsed.dir);
+
+        answer(session, legal ? tryMove(session, move) : SESSION_ILLEGAL);
+    }
+    else if (isCommand(line, end, "board"))
+        answer(session, gameStatus(&session->game));
+    else if (isCommand(line, end, "stats"))
+        session->outLength += (size_t)statsFormat(session->out + session->outLength);
+    else if (isCommand(line, end, "binary")){
+        session->binary = 1;                // this answer is already a frame
+        answer(session, gameStatus(&session->game));
+    }
+    else
+        answer(session, SESSION_ERROR);
+}
+
+uint32_t sessionOpen(SessionTable *table, int fd){
+    uint32_t index = slabTake(&table->slab);
+
+    if (index == SESSION_NONE)
+        return SESSION_NONE;
+
+    // the block is reused as it is: only what a new game needs is set
+    Session *session = sessionAt(table, index);
+    session->fd = fd;
+    session->binary = session->closing = session->skipping = 0;
+    session->inLength = session->outStart = session->outLength = 0;
+    gameInit(&session->game, &table->start, table->startTurn);
+
+    answer(session, SESSION_NEW);
+    return index;
+}
+
+void sessionClose(SessionTable *table, uint32_t index){
+    sessionAt(table, index)->fd = -1;
+    slabGive(&table->slab, index);
+}
+
+void sessionHandleInput(Session *session){
+    size_t used = 0;
+
+    for (;;){
+        // room for the longest answer, kept at the front once the old output has gone
+        if (session->outStart == session->outLength)
+            session->outStart = session->outLength = 0;
+        if (session->closing || SESSION_OUTPUT - session->outLength < SESSION_LINE)
+            break;
+
+        if (session->binary){
+            if (session->inLength - used < 2)
+                break;
+
+            Move move = { (unsigned char)session->in[used], (unsigned char)session->in[used + 1] };
+            used += 2;
+            answer(session, tryMove(session, move));
+            continue;
+        }
+
+        char *start = session->in + used;
+        char *end = memchr(start, '\n', session->inLength - used);
+        if (end == NULL){
+            // a line that fills the whole buffer is too long to be a command
+            if (used == 0 && session->inLength == SESSION_INPUT){
+                if (!session->skipping)
+                    answer(session, SESSION_ERROR);
+                session->skipping = 1;
+                used = session->inLength;
+            }
+            break;
+        }
+
+        used = (size_t)(end - session->in) + 1;
+        if (session->skipping)
+            session->skipping = 0;          // the end of the line that was too long
+        else
+            handleLine(session, start, end);
+    }
+
+    memmove(session->in, session->in + used, session->inLength - used);
+    session->inLength -= used;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file session.h
+ * @brief The games of the server: one session per connection, with its
+ * own board and undo stack, whose turn it is and its unsent input and
+ * output, all in one cache-aligned block of a slab (see slab.h) allocated
+ * when the server starts. A session that ends gives its block back for
+ * the next connection, so connecting, playing and disconnecting allocate
+ * nothing.
+ *
+ * A session speaks text lines by default. The client sends a move as on
+ * the command line ("A,5=L"), "board" to see the position again,
+ * "binary" to switch to binary frames, "stats" for the counters of
+ * stats.h on one line, or "0,0=E" to leave. Every other answer
+ * is one line: "ok", "illegal", "error" or, when the game is over,
+ * "musketeers" or "enemies", then the N * N squares ('M', 'o' or '.') row by
+ * row and 'm' or 'e' for the side to move. In binary mode the client sends
+ * two bytes per move, the square it goes from and the square it goes to,
+ * and every answer is a SESSION_FRAME byte frame: the status, the side to
+ * move, two zero bytes, and the Musketeer and enemy bitboards in little
+ * endian (BB_BYTES each). A binary client leaves by closing the connection.
+ * @bug no known bugs
+ *
+*/
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+#include "slab.h"
+#include "stats.h"
+
+#define SESSION_INPUT 64        // longest line a client may send
+#define SESSION_OUTPUT 2048     // answers waiting to be sent
+#define SESSION_LINE STATS_LINE // longest text answer, with its newline
+#define SESSION_FRAME (4 + 2 * BB_BYTES)    // bytes of a binary answer, 12 on 5x5
+#define SESSION_NONE SLAB_NONE
+
+/**
+ * @brief The status of an answer, the first byte of a binary frame.
+*/
+enum { SESSION_OK, SESSION_ILLEGAL, SESSION_ERROR, SESSION_MUSKETEERS_WIN, SESSION_ENEMIES_WIN,
+       SESSION_NEW /**< the welcome line, never in a frame */ };
+
+/**
+ * @brief One game and its connection.
+*/
+typedef struct {
+    int fd;                         /**< the connection, or -1 when the session is free */
+    int binary;                     /**< 1 once the client has switched to binary frames */
+    int closing;                    /**< 1 when the session ends as soon as its output is sent */
+    int skipping;                   /**< 1 while the rest of a line that was too long is thrown away */
+    Game game;                      /**< the game */
+    size_t inLength;                /**< bytes received but not handled yet */
+    size_t outStart;                /**< the first byte of out not sent yet */
+    size_t outLength;               /**< the end of the bytes to send */
+    char in[SESSION_INPUT];         /**< what the client sent */
+    char out[SESSION_OUTPUT];       /**< what it has not been sent yet */
+} __attribute__((aligned(SLAB_ALIGN))) Session;
+
+/**
+ * @brief Every session of the server.
+*/
+typedef struct {
+    Slab slab;              /**< a block for every session there can be */
+    Position start;         /**< where every game starts */
+    int startTurn;          /**< and its side to move */
+} SessionTable;
+
+/**
+ * @brief Allocates the table.
+ * @param table the table to set up.
+ * @param capacity the most sessions at the same time, at least 1.
+ * @param start the position every game starts from.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @return 1 if the memory was allocated, 0 if it was not.
+*/
+int sessionTableInit(SessionTable *table, uint32_t capacity, const Position *start, int mTurn);
+
+/**
+ * @brief Frees the table; the connections are not closed.
+ * @param table the table.
+*/
+void sessionTableFree(SessionTable *table);
+
+/**
+ * @brief Takes a free session for a new connection, starts its game and
+ * queues the welcome line: "new", the board and the side to move.
+ * @param table the table.
+ * @param fd the connection.
+ * @return the session's index, or SESSION_NONE if the table is full.
+*/
+uint32_t sessionOpen(SessionTable *table, int fd);
+
+/**
+ * @brief Gives a session's block back; the connection is not closed.
+ * @param table the table.
+ * @param index the session.
+*/
+void sessionClose(SessionTable *table, uint32_t index);
+
+/**
+ * @brief One session of the table, taken or free.
+ * @param table the table.
+ * @param index the session, below table->slab.count.
+ * @return the session.
+*/
+static inline Session *sessionAt(const SessionTable *table, uint32_t index){
+    return slabBlock(&table->slab, index);
+}
+
+/**
+ * @brief Handles every complete line or frame in the session's input and
+ * queues the answers. It stops early, keeping the rest of the input, when
+ * the output has no room left for another answer or the session is closing.
+ * @param session the session, after new bytes were added to in.
+*/
+void sessionHandleInput(Session *session);
+
+#endif
@@ -0,0 +1,36 @@
+/**
+ * @file slab.c
+ * @brief Setting up and freeing a slab.
+ * @bug no known bugs
+ *
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "slab.h"
+
+int slabInit(Slab *slab, size_t size, uint32_t count){
+    uint32_t i;
+
+    slab->blockSize = (size + SLAB_ALIGN - 1) / SLAB_ALIGN * SLAB_ALIGN;
+    slab->count = count;
+    slab->memory = aligned_alloc(SLAB_ALIGN, slab->blockSize * count);
+    slab->freeStack = malloc(count * sizeof(uint32_t));
+    if (slab->memory == NULL || slab->freeStack == NULL){
+        slabFree(slab);
+        return 0;
+    }
+    memset(slab->memory, 0, slab->blockSize * count);
+
+    // block 0 on top, so the blocks are first handed out in order
+    for (i = 0; i < count; i++)
+        slab->freeStack[i] = count - 1 - i;
+    slab->freeCount = count;
+    return 1;
+}
+
+void slabFree(Slab *slab){
+    free(slab->memory);
+    free(slab->freeStack);
+    slab->memory = NULL;
+    slab->freeStack = NULL;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file solve.c
+ * @brief Proves who wins a board with perfect play, with df-pn (see
+ * dfpn.h). A line of progress is printed every so often, and with a
+ * checkpoint file the search table is saved regularly and when the
+ * program is stopped with Ctrl-C, so that running it again with the same
+ * file and memory carries on where it stopped.
+ * @bug no known bugs
+ *
+*/
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "boardio.h"
+#include "dfpn.h"
+#include "savegame.h"
+
+#define DEFAULT_HASH 256            // megabytes for the proof-number table
+#define DEFAULT_CHECKPOINT 600      // seconds between checkpoints
+#define DEFAULT_PROGRESS 10         // seconds between progress lines
+
+static volatile sig_atomic_t interrupted = 0;
+
+// Ctrl-C only asks the search to stop, so that it can save its table first
+static void onInterrupt(int signal){
+    (void)signal;
+    interrupted = 1;
+}
+
+/**
+ * @brief Reads the options and the board, and solves it.
+ * @param argc
+ * @param argv "--hash MB" for the table, "--tb DIR" for tablebases to end
+ * the search with, "--checkpoint FILE" and "--every S" for the checkpoint
+ * file and how often it is written, "--progress S" for how often progress
+ * is printed (0 for never), "--enemies" to start with the enemies to move,
+ * and the board file (a text board or a binary save, which knows whose
+ * turn it is).
+ * @return 0 if the board was solved, 1 if not
+*/
+int main (int argc, char *argv[]){
+    char *filename = NULL, *tablebaseDir = NULL, *checkpoint = NULL;
+    int megabytes = DEFAULT_HASH, every = DEFAULT_CHECKPOINT, progress = DEFAULT_PROGRESS;
+    int enemiesFirst = 0, mistake = 0, i;
+
+    for (i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc)
+            megabytes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--tb") == 0 && i + 1 < argc)
+            tablebaseDir = argv[++i];
+        else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+            checkpoint = argv[++i];
+        else if (strcmp(argv[i], "--every") == 0 && i + 1 < argc)
+            every = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--progress") == 0 && i + 1 < argc)
+            progress = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--enemies") == 0)
+            enemiesFirst = 1;
+        else if (argv[i][0] != '-' && filename == NULL)
+            filename = argv[i];
+        else
+            mistake = 1;
+    }
+    if (mistake || filename == NULL || megabytes < 1 || every < 1 || progress < 0){
+        printf("Usage: %s [--hash MB] [--tb DIR] [--checkpoint FILE [--every S]] [--progress S] [--enemies] <board file>\n", argv[0]);
+        return 1;
+    }
+
+    SavedGame start;
+    if (saveIsBinary(filename)){
+        if (!saveRead(filename, &start)){
+            printf("The saved game is damaged: %s\n", filename);
+            return 1;
+        }
+    }
+    else {
+        char board[N][N];
+
+        if (!readBoard(board, filename)){
+            printf("Failed to read the board from the file.\n");
+            return 1;
+        }
+        posFromBoard(board, &start.pos);
+        start.mTurn = !enemiesFirst;
+    }
+
+    PNSolver solver;
+    if (!pnInit(&solver, (size_t)megabytes)){
+        printf("Not enough memory for the table.\n");
+        return 1;
+    }
+    TBProbe tb;
+    if (tablebaseDir){
+        tbProbeOpen(&tb, tablebaseDir);
+        solver.tb = &tb;
+    }
+    solver.checkpoint = checkpoint;
+    solver.checkpointInterval = every;
+    solver.progressInterval = progress;
+    solver.stop = &interrupted;
+    signal(SIGINT, onInterrupt);
+    signal(SIGTERM, onInterrupt);
+
+    int result, solved;
+    Move best;
+    solved = pnSolve(&solver, &start.pos, start.mTurn, &result, &best);
+
+    if (solved){
+        printf("%s win with perfect play", result == TB_MUSKETEERS_WIN ? "The Musketeers" : "Cardinal Richelieu's men");
+        if (best.from != best.to){
+            char text[MOVE_TEXT];
+
+            moveToString(best, text);
+            printf(", starting with %s", text);
+        }
+        printf(" (%llu positions searched).\n", (unsigned long long)solver.nodes);
+    }
+    else if (checkpoint)
+        printf("Stopped after %llu positions; the search is saved in %s.\n", (unsigned long long)solver.nodes, checkpoint);
+    else
+        printf("Stopped after %llu positions.\n", (unsigned long long)solver.nodes);
+
+    if (tablebaseDir)
+        tbProbeClose(&tb);
+    pnFree(&solver);
+    return !solved;
+}
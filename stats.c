@@ -0,0 +1,115 @@
+/**
+ * @file stats.c
+ * @brief The per-thread blocks of the counters, adding them up, and the
+ * dump at exit. Only built with -DTM_STATS.
+ * @bug no known bugs
+ *
+*/
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+#define STATS_BLOCKS 256        // threads that can count at the same time with a block of their own
+
+static const char *const names[STATS] = {
+    "parse", "validate", "make_move", "win_test", "search", "nodes",
+    "tt_probe", "tt_hit", "cutoff", "read_board", "write_board"
+};
+static const int timed[STATS] = { [STAT_PARSE] = 1, [STAT_SEARCH] = 1, [STAT_READ_BOARD] = 1, [STAT_WRITE_BOARD] = 1 };
+
+_Thread_local StatsBlock *statsMine = NULL;
+
+static StatsBlock blocks[STATS_BLOCKS];
+static int taken[STATS_BLOCKS];
+static StatsBlock retired = { .shared = 1 };    // the ended threads, and the threads that found no free block
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t key;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+uint64_t statsNow(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// a thread that ends adds its block to the total and gives it back
+static void release(void *arg){
+    StatsBlock *block = arg;
+    int i;
+
+    pthread_mutex_lock(&lock);
+    for (i = 0; i < STATS; i++){
+        __atomic_fetch_add(&retired.count[i], __atomic_load_n(&block->count[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+        __atomic_fetch_add(&retired.nanoseconds[i], __atomic_load_n(&block->nanoseconds[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+    memset(block->count, 0, sizeof(block->count));
+    memset(block->nanoseconds, 0, sizeof(block->nanoseconds));
+    taken[block - blocks] = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+static void dump(void){
+    char line[STATS_LINE];
+    int length = statsFormat(line);
+
+    fwrite(line, 1, (size_t)length, stderr);
+}
+
+static void setUp(void){
+    pthread_key_create(&key, release);
+    atexit(dump);
+}
+
+StatsBlock *statsClaim(void){
+    int i;
+
+    pthread_once(&once, setUp);
+    pthread_mutex_lock(&lock);
+    statsMine = &retired;
+    for (i = 0; i < STATS_BLOCKS; i++)
+        if (!taken[i]){
+            taken[i] = 1;
+            statsMine = &blocks[i];
+            break;
+        }
+    pthread_mutex_unlock(&lock);
+
+    if (statsMine != &retired)
+        pthread_setspecific(key, statsMine);
+    return statsMine;
+}
+
+int statsFormat(char out[]){
+    uint64_t count[STATS], nanoseconds[STATS];
+    int i, k, length;
+
+    // the threads still counting are read while they run, so the totals are only roughly at one moment
+    pthread_mutex_lock(&lock);
+    for (i = 0; i < STATS; i++){
+        count[i] = __atomic_load_n(&retired.count[i], __ATOMIC_RELAXED);
+        nanoseconds[i] = __atomic_load_n(&retired.nanoseconds[i], __ATOMIC_RELAXED);
+        for (k = 0; k < STATS_BLOCKS; k++)
+            if (taken[k]){
+                count[i] += __atomic_load_n(&blocks[k].count[i], __ATOMIC_RELAXED);
+                nanoseconds[i] += __atomic_load_n(&blocks[k].nanoseconds[i], __ATOMIC_RELAXED);
+            }
+    }
+    pthread_mutex_unlock(&lock);
+
+    length = snprintf(out, STATS_LINE, "stats");
+    for (i = 0; i < STATS && length < STATS_LINE; i++){
+        if (timed[i])
+            length += snprintf(out + length, (size_t)(STATS_LINE - length), " %s=%llu/%lluns", names[i],
+                (unsigned long long)count[i], (unsigned long long)(count[i] ? nanoseconds[i] / count[i] : 0));
+        else
+            length += snprintf(out + length, (size_t)(STATS_LINE - length), " %s=%llu", names[i], (unsigned long long)count[i]);
+    }
+    if (length > STATS_LINE - 1)
+        length = STATS_LINE - 1;
+    out[length++] = '\n';
+    return length;
+}
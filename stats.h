@@ -0,0 +1,119 @@
+/**
+ * @file stats.h
+ * @brief Counters and timers on the hot paths: move parsing, validation,
+ * making moves, win tests, the engine search and the board files. They
+ * are compiled out unless the program is built with -DTM_STATS (and
+ * stats.c): the STATS_ macros then expand to nothing and cost nothing.
+ *
+ * Every thread counts into a block of its own, so counting needs no lock
+ * and no atomic read-modify-write, only a plain add. The blocks are added
+ * up when the counters are read; a block whose thread has ended is added
+ * into a running total and reused. The totals are printed on stderr when
+ * the program exits, and the server answers "stats" with them.
+ * @bug no known bugs
+ *
+*/
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief What is counted. Those that are timed also add up nanoseconds.
+*/
+enum {
+    STAT_PARSE,             /**< move lines parsed, timed */
+    STAT_VALIDATE,          /**< moves checked against the rules */
+    STAT_MAKE_MOVE,         /**< moves made */
+    STAT_WIN_TEST,          /**< win tests */
+    STAT_SEARCH,            /**< engine searches, timed */
+    STAT_NODES,             /**< positions searched */
+    STAT_TT_PROBE,          /**< transposition table probes */
+    STAT_TT_HIT,            /**< probes that found the position */
+    STAT_CUTOFF,            /**< beta cutoffs */
+    STAT_READ_BOARD,        /**< boards read from text files, timed */
+    STAT_WRITE_BOARD,       /**< boards written to text files, timed */
+    STATS
+};
+
+#define STATS_LINE 512      // the longest line statsFormat writes, with its newline
+
+#ifdef TM_STATS
+
+/**
+ * @brief One thread's counters, on cache lines of their own.
+*/
+typedef struct {
+    uint64_t count[STATS];          /**< how many times each thing happened */
+    uint64_t nanoseconds[STATS];    /**< how long the timed ones took */
+    int shared;                     /**< 1 for the block every thread adds to with atomics, when there are too many threads */
+} __attribute__((aligned(64))) StatsBlock;
+
+extern _Thread_local StatsBlock *statsMine;
+
+/**
+ * @brief The calling thread's block, claimed the first time it counts.
+ * @return the block.
+*/
+StatsBlock *statsClaim(void);
+
+/**
+ * @brief The monotonic clock, for the timers.
+ * @return nanoseconds since some fixed point.
+*/
+uint64_t statsNow(void);
+
+static inline void statsAdd(uint64_t *counter, int shared, uint64_t amount){
+    if (shared)
+        __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+    else                            // only this thread writes it; readers load it atomically
+        __atomic_store_n(counter, *counter + amount, __ATOMIC_RELAXED);
+}
+
+static inline void statsCount(int stat, uint64_t amount){
+    StatsBlock *block = statsMine ? statsMine : statsClaim();
+    statsAdd(&block->count[stat], block->shared, amount);
+}
+
+static inline void statsTime(int stat, uint64_t begin){
+    StatsBlock *block = statsMine ? statsMine : statsClaim();
+    statsAdd(&block->count[stat], block->shared, 1);
+    statsAdd(&block->nanoseconds[stat], block->shared, statsNow() - begin);
+}
+
+#define STATS_COUNT(stat) statsCount((stat), 1)
+#define STATS_ADD(stat, amount) statsCount((stat), (amount))
+#define STATS_BEGIN(name) uint64_t name = statsNow()
+#define STATS_END(stat, name) statsTime((stat), (name))
+
+#else
+
+#define STATS_COUNT(stat) ((void)0)
+#define STATS_ADD(stat, amount) ((void)0)
+#define STATS_BEGIN(name) ((void)0)
+#define STATS_END(stat, name) ((void)0)
+
+#endif
+
+/**
+ * @brief Writes every counter on one line, "stats name=count ..." with
+ * the average nanoseconds after the count of the timed ones, or "stats
+ * off" when they were compiled out.
+ * @param out a buffer of at least STATS_LINE bytes; no null is added.
+ * @return the number of bytes written, newline included.
+*/
+#ifdef TM_STATS
+int statsFormat(char out[]);
+#else
+static inline int statsFormat(char out[]){
+    static const char off[] = "stats off\n";
+    int i;
+
+    for (i = 0; off[i] != '\0'; i++)
+        out[i] = off[i];
+    return i;
+}
+#endif
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * @file symmetry.c
+ * @brief Board symmetries built from three bitboard operations: reversing
+ * the columns, reversing the rows and transposing along the main diagonal.
+ * @bug no known bugs
+ *
+*/
+#include "symmetry.h"
+
+#define BB_DIAGONAL ((BB_SQUARE(N * (N + 1)) - 1) / (BB_SQUARE(N + 1) - 1))     // A1, B2, C3, ...: one square every N + 1 bits
+
+// reverses the order of the columns
+static Bitboard bbMirror(Bitboard b){
+    Bitboard out = 0;
+    int c;
+
+    for (c = 0; c < N; c++)
+        out |= ((b >> c) & BB_COL_FIRST) << (N - 1 - c);
+    return out;
+}
+
+// reverses the order of the rows
+static Bitboard bbFlip(Bitboard b){
+    Bitboard out = 0;
+    int r;
+
+    for (r = 0; r < N; r++)
+        out |= ((b >> (r * N)) & BB_ROW_FIRST) << ((N - 1 - r) * N);
+    return out;
+}
+
+// swaps rows and columns: every square with col - row == d moves d * (N - 1) bits
+static Bitboard bbTranspose(Bitboard b){
+    Bitboard out = b & BB_DIAGONAL;
+    int d;
+
+    for (d = 1; d < N; d++){
+        out |= (b & (BB_DIAGONAL >> (d * N))) << (d * (N - 1));
+        out |= (b & ((BB_DIAGONAL << (d * N)) & BB_FULL)) >> (d * (N - 1));
+    }
+    return out;
+}
+
+int symSquare(int t, int sq){
+    int row = sq / N, col = sq % N;
+
+    switch (t){
+        case SYM_ROT90:         return SQUARE(col, N - 1 - row);
+        case SYM_ROT180:        return SQUARE(N - 1 - row, N - 1 - col);
+        case SYM_ROT270:        return SQUARE(N - 1 - col, row);
+        case SYM_MIRROR:        return SQUARE(row, N - 1 - col);
+        case SYM_FLIP:          return SQUARE(N - 1 - row, col);
+        case SYM_TRANSPOSE:     return SQUARE(col, row);
+        case SYM_ANTITRANSPOSE: return SQUARE(N - 1 - col, N - 1 - row);
+    }
+    return sq;
+}
+
+Move symMove(int t, Move move){
+    Move out;
+    out.from = (unsigned char)symSquare(t, move.from);
+    out.to = (unsigned char)symSquare(t, move.to);
+    return out;
+}
+
+Bitboard symBitboard(int t, Bitboard b){
+    switch (t){
+        case SYM_ROT90:         return bbMirror(bbTranspose(b));
+        case SYM_ROT180:        return bbMirror(bbFlip(b));
+        case SYM_ROT270:        return bbFlip(bbTranspose(b));
+        case SYM_MIRROR:        return bbMirror(b);
+        case SYM_FLIP:          return bbFlip(b);
+        case SYM_TRANSPOSE:     return bbTranspose(b);
+        case SYM_ANTITRANSPOSE: return bbMirror(bbFlip(bbTranspose(b)));
+    }
+    return b;
+}
+
+void symPosition(int t, const Position *pos, Position *out){
+    out->musketeers = symBitboard(t, pos->musketeers);
+    out->enemies = symBitboard(t, pos->enemies);
+}
+
+// keeps the smaller of the current best and a candidate image
+static void keepSmaller(Position *best, int *bestT, Bitboard m, Bitboard e, int t){
+    if (m < best->musketeers || (m == best->musketeers && e < best->enemies)){
+        best->musketeers = m;
+        best->enemies = e;
+        *bestT = t;
+    }
+}
+
+int posCanonical(const Position *pos, Position *out){
+    // the transposed masks are shared by the four symmetries that swap rows and columns
+    Bitboard m = pos->musketeers, e = pos->enemies;
+    Bitboard tm = bbTranspose(m), te = bbTranspose(e);
+    int t = SYM_IDENTITY;
+
+    *out = *pos;
+    keepSmaller(out, &t, bbMirror(m), bbMirror(e), SYM_MIRROR);
+    keepSmaller(out, &t, bbFlip(m), bbFlip(e), SYM_FLIP);
+    keepSmaller(out, &t, bbMirror(bbFlip(m)), bbMirror(bbFlip(e)), SYM_ROT180);
+    keepSmaller(out, &t, tm, te, SYM_TRANSPOSE);
+    keepSmaller(out, &t, bbMirror(tm), bbMirror(te), SYM_ROT90);
+    keepSmaller(out, &t, bbFlip(tm), bbFlip(te), SYM_ROT270);
+    keepSmaller(out, &t, bbMirror(bbFlip(tm)), bbMirror(bbFlip(te)), SYM_ANTITRANSPOSE);
+    return t;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file symmetry.h
+ * @brief The 8 symmetries of the square board (4 rotations, each with or
+ * without a mirror image). Symmetric positions have the same outcome, so
+ * a cache or a table only needs to store one of them: the canonical one,
+ * which is the smallest of the 8 images. All transforms work on whole
+ * bitboards with shifts and masks, so they are cheap enough to run at
+ * every search node, and moves are mapped through the same transforms.
+ * @bug no known bugs
+ *
+*/
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+#include "bitboard.h"
+
+/**
+ * @brief The symmetries of the board, written as where square (row, col) goes.
+*/
+enum {
+    SYM_IDENTITY,           /**< (row, col) */
+    SYM_ROT90,              /**< (col, N-1-row), a quarter turn clockwise */
+    SYM_ROT180,             /**< (N-1-row, N-1-col) */
+    SYM_ROT270,             /**< (N-1-col, row) */
+    SYM_MIRROR,             /**< (row, N-1-col), columns reversed */
+    SYM_FLIP,               /**< (N-1-row, col), rows reversed */
+    SYM_TRANSPOSE,          /**< (col, row), about the A1-E5 diagonal */
+    SYM_ANTITRANSPOSE,      /**< (N-1-col, N-1-row), about the A5-E1 diagonal */
+    SYMMETRIES
+};
+
+/**
+ * @brief The symmetry that undoes another one.
+ * @param t the symmetry.
+ * @return the inverse symmetry.
+*/
+static inline int symInverse(int t){
+    if (t == SYM_ROT90)
+        return SYM_ROT270;
+    if (t == SYM_ROT270)
+        return SYM_ROT90;
+    return t;
+}
+
+/**
+ * @brief Where a square goes under a symmetry.
+ * @param t the symmetry.
+ * @param sq the square.
+ * @return the square it is mapped to.
+*/
+int symSquare(int t, int sq);
+
+/**
+ * @brief Maps a move through a symmetry.
+ * @param t the symmetry.
+ * @param move the move.
+ * @return the same move on the transformed board.
+*/
+Move symMove(int t, Move move);
+
+/**
+ * @brief Maps every square of a mask through a symmetry.
+ * @param t the symmetry.
+ * @param b the mask.
+ * @return the transformed mask.
+*/
+Bitboard symBitboard(int t, Bitboard b);
+
+/**
+ * @brief Maps a position through a symmetry.
+ * @param t the symmetry.
+ * @param pos the position.
+ * @param out filled in with the transformed position.
+*/
+void symPosition(int t, const Position *pos, Position *out);
+
+/**
+ * @brief Finds the canonical version of a position: of its 8 symmetric
+ * images, the one with the smallest Musketeer mask, and of those the one
+ * with the smallest enemy mask.
+ * @param pos the position.
+ * @param out filled in with the canonical position.
+ * @return the symmetry that maps pos onto out. Moves found in the canonical
+ * position are mapped back with symMove(symInverse(t), move).
+*/
+int posCanonical(const Position *pos, Position *out);
+
+#endif
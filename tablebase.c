@@ -0,0 +1,440 @@
+/**
+ * @file tablebase.c
+ * @brief Solving the layers and reading and writing the tablebase files.
+ * @bug no known bugs
+ *
+*/
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "tablebase.h"
+#include "winbatch.h"
+
+#define TB_BATCH 256            // positions whose win tests are done together
+
+// the next larger mask with the same number of bits set
+static Bitboard nextCombination(Bitboard v){
+    Bitboard t = v | (v - 1);
+    return (t + 1) | (((~t & -~t) - 1) >> (bbFirst(v) + 1));
+}
+
+// best result for the side to move over the entries of its moves
+static unsigned char bestOf(int mTurn, const unsigned char children[], int count){
+    int win = mTurn ? TB_MUSKETEERS_WIN : TB_ENEMIES_WIN;
+    int i, fastestWin = 64, slowestLoss = -1;
+
+    for (i = 0; i < count; i++){
+        int d = TB_DISTANCE(children[i]);
+
+        if (TB_RESULT(children[i]) == win){
+            if (d < fastestWin)
+                fastestWin = d;
+        }
+        else if (d > slowestLoss)
+            slowestLoss = d;
+    }
+
+    if (fastestWin < 64)
+        return TB_ENTRY(win, fastestWin + 1);
+    return TB_ENTRY(mTurn ? TB_ENEMIES_WIN : TB_MUSKETEERS_WIN, slowestLoss + 1);
+}
+
+// wins holds the position's WIN_BATCH_ flags; the Musketeers' entries of
+// the same triple are in same, whose first entry has the index start
+static unsigned char solvePosition(const Position *pos, int mTurn, int wins, const unsigned char *same, uint64_t start,
+        const TBLayer *below){
+    unsigned char children[MAX_MOVES];
+    MoveList list;
+    int i;
+
+    switch (posOutcomeFrom(pos, mTurn, wins & WIN_BATCH_MUSKETEERS, wins & WIN_BATCH_ENEMIES, &list)){
+        case OUTCOME_MUSKETEERS: return TB_ENTRY(TB_MUSKETEERS_WIN, 0);
+        case OUTCOME_ENEMIES:    return TB_ENTRY(TB_ENEMIES_WIN, 0);
+    }
+
+    for (i = 0; i < list.count; i++){
+        Position child = *pos;
+        posMakeMove(&child, list.moves[i], mTurn);
+
+        if (mTurn)
+            children[i] = below->table[0][tbIndex(&child)];
+        else
+            children[i] = same[tbIndex(&child) - start];
+    }
+    return bestOf(mTurn, children, list.count);
+}
+
+// Solves the triples from first up to last of layer k into table, whose
+// first entry has the index start. An enemy move leaves the Musketeers
+// where they are, so it stays within its triple and any run of triples can
+// be solved on its own, once the layer below is known.
+static void solveTriples(int k, int first, int last, unsigned char *table[2], uint64_t start, const TBLayer *below){
+    uint64_t per = rankChoose(TB_MAX_ENEMIES, k);
+    int side, triple;
+
+    // the Musketeers first: the enemies' moves lead to their positions
+    for (side = 1; side >= 0; side--)
+        for (triple = first; triple < last; triple++){
+            Bitboard musketeers[TB_BATCH], enemies[TB_BATCH];
+            unsigned char wins[TB_BATCH], captures[TB_BATCH];
+            Bitboard v = BB_SQUARE(k) - 1;      // the first k-subset in rank order
+            Bitboard three = rankCanonicalTriple(triple);
+            uint64_t r, base = (uint64_t)triple * per - start;
+            int i, batch;
+
+            // the win tests of a whole batch at once, then the moves of each position
+            for (r = 0; r < per; r += (uint64_t)batch){
+                batch = per - r < TB_BATCH ? (int)(per - r) : TB_BATCH;
+                for (i = 0; i < batch; i++){
+                    musketeers[i] = three;
+                    enemies[i] = rankExpand(v, three);
+                    if (k > 0)
+                        v = nextCombination(v);
+                }
+                winBatch(musketeers, enemies, (size_t)batch, wins, captures);
+
+                for (i = 0; i < batch; i++){
+                    Position pos = { musketeers[i], enemies[i] };
+                    table[side][base + r + i] = solvePosition(&pos, side, wins[i], table[1], start, below);
+                }
+            }
+        }
+}
+
+int tbSolveLayer(TBLayer *layer, const TBLayer *below){
+    layer->size = tbLayerSize(layer->enemies);
+    layer->table[0] = malloc(layer->size);
+    layer->table[1] = malloc(layer->size);
+    if (layer->table[0] == NULL || layer->table[1] == NULL){
+        tbFreeLayer(layer);
+        return 0;
+    }
+
+    solveTriples(layer->enemies, 0, rankCanonicalTriples(), layer->table, 0, below);
+    return 1;
+}
+
+int tbSolveShard(TBShard *shard, const TBLayer *below){
+    uint64_t per = rankChoose(TB_MAX_ENEMIES, shard->enemies);
+
+    shard->start = (uint64_t)shard->first * per;
+    shard->size = (uint64_t)(shard->last - shard->first) * per;
+    shard->table[0] = malloc(shard->size);
+    shard->table[1] = malloc(shard->size);
+    if (shard->table[0] == NULL || shard->table[1] == NULL){
+        tbFreeShard(shard);
+        return 0;
+    }
+
+    solveTriples(shard->enemies, shard->first, shard->last, shard->table, shard->start, below);
+    return 1;
+}
+
+void tbFreeShard(TBShard *shard){
+    free(shard->table[0]);
+    free(shard->table[1]);
+    shard->table[0] = shard->table[1] = NULL;
+}
+
+void tbFileName(const char *dir, int enemies, int format, char name[], int size){
+    snprintf(name, (size_t)size, "%s/tb-%02d%s.tmtb", dir, enemies, format == TB_FORMAT_WDL ? ".wdl" : "");
+}
+
+// packs the winners of one side's entries four to a byte
+static int writeWDL(const unsigned char *table, uint64_t size, FILE *file){
+    unsigned char buffer[4096];
+    uint64_t i;
+    size_t used = 0;
+
+    for (i = 0; i < size; i += 4){
+        unsigned char packed = 0;
+        int j;
+
+        for (j = 0; j < 4 && i + j < size; j++)
+            packed |= (unsigned char)(TB_RESULT(table[i + j]) << (2 * j));
+        buffer[used++] = packed;
+        if (used == sizeof(buffer)){
+            if (fwrite(buffer, 1, used, file) != used)
+                return 0;
+            used = 0;
+        }
+    }
+    return fwrite(buffer, 1, used, file) == used;
+}
+
+int tbWriteLayer(const TBLayer *layer, const char *dir, int format){
+    char name[FILENAME_MAX], part[FILENAME_MAX + 32];
+    TBHeader header;
+
+    // renamed when it is whole, like a shard, so a crash or full disk never leaves a damaged layer file
+    tbFileName(dir, layer->enemies, format, name, sizeof(name));
+    snprintf(part, sizeof(part), "%s.%ld.part", name, (long)getpid());
+    FILE *file = fopen(part, "wb");
+    if (file == NULL){
+        printf("Error opening the tablebase file: %s\n", part);
+        return 0;
+    }
+
+    memcpy(header.magic, TB_MAGIC, 4);
+    header.version = TB_VERSION;
+    header.boardSize = N;
+    header.enemies = (uint32_t)layer->enemies;
+    header.size = layer->size;
+    header.format = (uint32_t)format;
+    header.reserved = 0;
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (format == TB_FORMAT_WDL)
+        ok = ok && writeWDL(layer->table[1], layer->size, file) && writeWDL(layer->table[0], layer->size, file);
+    else
+        ok = ok && fwrite(layer->table[1], 1, layer->size, file) == layer->size
+                && fwrite(layer->table[0], 1, layer->size, file) == layer->size;
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0)
+        ok = 0;
+    if (ok && rename(part, name) != 0)
+        ok = 0;
+    if (!ok)
+        unlink(part);
+    return ok;
+}
+
+void tbShardName(const char *dir, int enemies, int first, int last, char name[], int size){
+    snprintf(name, (size_t)size, "%s/tb-%02d.t%04d-%04d.tmts", dir, enemies, first, last);
+}
+
+int tbWriteShard(const TBShard *shard, const char *dir){
+    char name[FILENAME_MAX], part[FILENAME_MAX + 32];
+    TBShardHeader header;
+
+    // written under another name and renamed when it is whole, so a worker
+    // that dies half way never leaves a shard that looks finished
+    tbShardName(dir, shard->enemies, shard->first, shard->last, name, sizeof(name));
+    snprintf(part, sizeof(part), "%s.%ld.part", name, (long)getpid());
+    FILE *file = fopen(part, "wb");
+    if (file == NULL){
+        printf("Error opening the shard file: %s\n", part);
+        return 0;
+    }
+
+    memcpy(header.magic, TB_SHARD_MAGIC, 4);
+    header.version = TB_VERSION;
+    header.boardSize = N;
+    header.enemies = (uint32_t)shard->enemies;
+    header.first = (uint32_t)shard->first;
+    header.last = (uint32_t)shard->last;
+    header.size = shard->size;
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1
+          && fwrite(shard->table[1], 1, shard->size, file) == shard->size
+          && fwrite(shard->table[0], 1, shard->size, file) == shard->size
+          && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0)
+        ok = 0;
+    if (ok && rename(part, name) != 0)
+        ok = 0;
+    if (!ok)
+        unlink(part);
+    return ok;
+}
+
+// opens a shard file and checks its header and length; NULL if it is not right
+static FILE *openShard(const char *dir, int enemies, int first, int last, uint64_t *size){
+    char name[FILENAME_MAX];
+    TBShardHeader header;
+    struct stat st;
+
+    tbShardName(dir, enemies, first, last, name, sizeof(name));
+    FILE *file = fopen(name, "rb");
+    if (file == NULL)
+        return NULL;
+
+    *size = (uint64_t)(last - first) * rankChoose(TB_MAX_ENEMIES, enemies);
+    if (fstat(fileno(file), &st) != 0 || (uint64_t)st.st_size != sizeof(header) + 2 * *size
+            || fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TB_SHARD_MAGIC, 4) != 0
+            || header.version != TB_VERSION || header.boardSize != N || header.enemies != (uint32_t)enemies
+            || header.first != (uint32_t)first || header.last != (uint32_t)last || header.size != *size){
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+int tbCheckShard(const char *dir, int enemies, int first, int last){
+    uint64_t size;
+    FILE *file = openShard(dir, enemies, first, last, &size);
+
+    if (file == NULL)
+        return 0;
+    fclose(file);
+    return 1;
+}
+
+static int byFirst(const void *a, const void *b){
+    const TBShardRange *x = a, *y = b;
+
+    if (x->first != y->first)
+        return x->first < y->first ? -1 : 1;
+    return y->last - x->last;
+}
+
+TBShardRange *tbListShards(const char *dir, int enemies, int *count){
+    int triples = rankCanonicalTriples(), found = 0, capacity = 16;
+    TBShardRange *ranges = malloc((size_t)capacity * sizeof(*ranges));
+    DIR *listing = opendir(dir);
+    struct dirent *entry;
+
+    if (ranges == NULL || listing == NULL){
+        free(ranges);
+        if (listing != NULL)
+            closedir(listing);
+        return NULL;
+    }
+
+    // every shard file of the layer, whatever split it came from
+    while ((entry = readdir(listing)) != NULL){
+        int k, first, last;
+        char extra;
+
+        if (sscanf(entry->d_name, "tb-%d.t%d-%d.tmts%c", &k, &first, &last, &extra) != 3 || k != enemies
+                || first < 0 || first >= last || last > triples)
+            continue;
+        if (found == capacity){
+            TBShardRange *grown = realloc(ranges, (size_t)(capacity *= 2) * sizeof(*ranges));
+            if (grown == NULL)
+                break;
+            ranges = grown;
+        }
+        ranges[found].first = first;
+        ranges[found++].last = last;
+    }
+    closedir(listing);
+
+    qsort(ranges, (size_t)found, sizeof(*ranges), byFirst);
+    *count = found;
+    return ranges;
+}
+
+TBShardRange *tbFindShards(const char *dir, int enemies, int *count){
+    int triples = rankCanonicalTriples(), found, used = 0, i, t;
+    TBShardRange *ranges = tbListShards(dir, enemies, &found);
+    int *via = malloc((size_t)(triples + 1) * sizeof(int));
+    int *steps = malloc((size_t)(triples + 1) * sizeof(int));
+
+    if (ranges == NULL || via == NULL || steps == NULL){
+        free(ranges);
+        free(via);
+        free(steps);
+        return NULL;
+    }
+
+    // the fewest whole shards that reach each triple from the first one;
+    // in the order of their first triples, every shard that ends where
+    // another starts has been seen before it, so one pass finds them all
+    // and shards left over from another split cannot hide a cover
+    for (t = 0; t <= triples; t++)
+        via[t] = -1;
+    steps[0] = 0;
+    for (i = 0; i < found; i++){
+        int first = ranges[i].first, last = ranges[i].last;
+
+        if ((first != 0 && via[first] < 0) || !tbCheckShard(dir, enemies, first, last))
+            continue;
+        if (via[last] < 0 || steps[first] + 1 < steps[last]){
+            via[last] = i;
+            steps[last] = steps[first] + 1;
+        }
+    }
+
+    if (via[triples] < 0){
+        free(ranges);
+        free(via);
+        free(steps);
+        return NULL;
+    }
+
+    // back from the last triple, then turned around into triple order
+    TBShardRange *cover = malloc((size_t)steps[triples] * sizeof(*cover));
+    if (cover != NULL){
+        for (t = triples; t > 0; t = ranges[via[t]].first)
+            cover[steps[triples] - 1 - used++] = ranges[via[t]];
+        *count = used;
+    }
+    free(ranges);
+    free(via);
+    free(steps);
+    return cover;
+}
+
+// a layer put together from its shard files
+static int readShards(TBLayer *layer, const char *dir, int enemies){
+    int count, i, ok;
+    TBShardRange *ranges = tbFindShards(dir, enemies, &count);
+
+    if (ranges == NULL)
+        return 0;
+    layer->enemies = enemies;
+    layer->size = tbLayerSize(enemies);
+    layer->table[1] = malloc(layer->size);
+    layer->table[0] = malloc(layer->size);
+    ok = layer->table[0] != NULL && layer->table[1] != NULL;
+
+    for (i = 0; ok && i < count; i++){
+        uint64_t size, start = (uint64_t)ranges[i].first * rankChoose(TB_MAX_ENEMIES, enemies);
+        FILE *file = openShard(dir, enemies, ranges[i].first, ranges[i].last, &size);
+
+        ok = file != NULL && fread(layer->table[1] + start, 1, size, file) == size
+                          && fread(layer->table[0] + start, 1, size, file) == size;
+        if (file != NULL)
+            fclose(file);
+    }
+    free(ranges);
+
+    if (!ok)
+        tbFreeLayer(layer);
+    return ok;
+}
+
+int tbReadLayer(TBLayer *layer, const char *dir, int enemies){
+    char name[FILENAME_MAX];
+    TBHeader header;
+
+    layer->table[0] = layer->table[1] = NULL;
+    tbFileName(dir, enemies, TB_FORMAT_DTM, name, sizeof(name));
+    FILE *file = fopen(name, "rb");
+    if (file == NULL)
+        return readShards(layer, dir, enemies);
+
+    // a layer file that is not right, say from an older version, leaves the shards to be tried
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TB_MAGIC, 4) != 0
+            || header.version != TB_VERSION || header.boardSize != N
+            || header.enemies != (uint32_t)enemies || header.size != tbLayerSize(enemies)
+            || header.format != TB_FORMAT_DTM){
+        fclose(file);
+        return readShards(layer, dir, enemies);
+    }
+
+    layer->enemies = enemies;
+    layer->size = header.size;
+    layer->table[1] = malloc(layer->size);
+    layer->table[0] = malloc(layer->size);
+    int ok = layer->table[0] != NULL && layer->table[1] != NULL
+          && fread(layer->table[1], 1, layer->size, file) == layer->size
+          && fread(layer->table[0], 1, layer->size, file) == layer->size;
+    fclose(file);
+
+    if (!ok){
+        tbFreeLayer(layer);
+        return readShards(layer, dir, enemies);
+    }
+    return ok;
+}
+
+void tbFreeLayer(TBLayer *layer){
+    free(layer->table[0]);
+    free(layer->table[1]);
+    layer->table[0] = layer->table[1] = NULL;
+}
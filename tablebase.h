@@ -0,0 +1,274 @@
+/**
+ * @file tablebase.h
+ * @brief Endgame tablebases: the perfect-play result of every position,
+ * solved one enemy count (a "layer") at a time. A Musketeer move always
+ * captures, so it leads into the layer below, and an enemy move leads to a
+ * Musketeer move in the same layer. Each layer can therefore be solved from
+ * the one below it alone, written to its own file and freed.
+ *
+ * Positions are indexed by their canonical rank (see posrank.h), which
+ * numbers them up to symmetry without a hash table. That index is a
+ * perfect hash, so the files are
+ * just the entries in index order: one byte per position holding who wins
+ * and how many moves it takes until the game ends (the DTM format), or
+ * two bits per position holding only who wins (the WDL format).
+ *
+ * A layer too big for one machine can be solved in shards instead: runs
+ * of canonical Musketeer triples, each solved on its own from the layer
+ * below (an enemy move never changes the triple) and written to a shard
+ * file of its own. A layer whose file is missing is read from a set of
+ * shard files covering every triple, both here and when probing.
+ * @bug no known bugs
+ *
+*/
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <stdint.h>
+#include "bitboard.h"
+#include "posrank.h"
+
+#define TB_MUSKETEERS RANK_MUSKETEERS           // pieces on the Musketeers' side
+#define TB_MAX_ENEMIES RANK_OTHERS
+
+// An entry: the winner in the top two bits, the distance to the end below
+// (at most 45 moves on 5x5; larger boards are too big to solve anyway)
+#define TB_RESULT(entry) ((entry) >> 6)
+#define TB_DISTANCE(entry) ((entry) & 63)
+#define TB_ENTRY(result, distance) ((unsigned char)(((result) << 6) | (distance)))
+
+/**
+ * @brief Who wins a position with perfect play.
+*/
+enum { TB_UNKNOWN, TB_MUSKETEERS_WIN, TB_ENEMIES_WIN };
+
+/**
+ * @brief The two file formats.
+*/
+enum {
+    TB_FORMAT_DTM = 1,      /**< one byte per position: winner and distance to the end */
+    TB_FORMAT_WDL = 2       /**< two bits per position: the winner only */
+};
+
+#define TB_MAGIC "TMTB"
+#define TB_VERSION 2
+
+/**
+ * @brief The start of every tablebase file. It is followed by the
+ * entries with the Musketeers to move and then those with the enemies to
+ * move, each tbTableBytes() long.
+*/
+typedef struct {
+    char magic[4];          /**< "TMTB" */
+    uint32_t version;       /**< TB_VERSION */
+    uint32_t boardSize;     /**< N */
+    uint32_t enemies;       /**< the layer */
+    uint64_t size;          /**< entries per side to move */
+    uint32_t format;        /**< TB_FORMAT_DTM or TB_FORMAT_WDL */
+    uint32_t reserved;      /**< always 0 */
+} TBHeader;
+
+#define TB_SHARD_MAGIC "TMTS"
+
+/**
+ * @brief The start of a shard file. It is followed by the shard's entries
+ * with the Musketeers to move and then those with the enemies to move,
+ * size bytes each, in the DTM format.
+*/
+typedef struct {
+    char magic[4];          /**< "TMTS" */
+    uint32_t version;       /**< TB_VERSION */
+    uint32_t boardSize;     /**< N */
+    uint32_t enemies;       /**< the layer */
+    uint32_t first;         /**< the first canonical triple */
+    uint32_t last;          /**< one past the last triple */
+    uint64_t size;          /**< entries per side to move */
+} TBShardHeader;
+
+/**
+ * @brief The triples a shard covers, from first up to but not including last.
+*/
+typedef struct {
+    int first;              /**< the first canonical triple */
+    int last;               /**< one past the last */
+} TBShardRange;
+
+/**
+ * @brief One solved layer: every position with the same number of
+ * enemies, once with the Musketeers to move and once with the enemies.
+*/
+typedef struct {
+    int enemies;                    /**< enemies on the board in this layer */
+    uint64_t size;                  /**< positions per side to move */
+    unsigned char *table[2];        /**< the entries, [1] with the Musketeers to move, [0] with the enemies */
+} TBLayer;
+
+/**
+ * @brief Part of a layer: the positions of a run of canonical triples.
+ * Their entries are the ones from index start of the layer's tables.
+*/
+typedef struct {
+    int enemies;                    /**< the layer */
+    int first;                      /**< the first canonical triple */
+    int last;                       /**< one past the last */
+    uint64_t start;                 /**< the layer index of the first entry */
+    uint64_t size;                  /**< entries per side to move */
+    unsigned char *table[2];        /**< the entries, [1] with the Musketeers to move, [0] with the enemies */
+} TBShard;
+
+/**
+ * @brief The number of positions in a layer, per side to move.
+ * @param enemies the number of enemies.
+ * @return the size of the layer.
+*/
+static inline uint64_t tbLayerSize(int enemies){
+    return rankCanonicalSize(enemies);
+}
+
+/**
+ * @brief The number of bytes one side's entries take up in a file.
+ * @param size the entries per side to move.
+ * @param format TB_FORMAT_DTM or TB_FORMAT_WDL.
+ * @return the size in bytes.
+*/
+static inline uint64_t tbTableBytes(uint64_t size, int format){
+    return format == TB_FORMAT_WDL ? (size + 3) / 4 : size;
+}
+
+/**
+ * @brief Finds where a position is stored in its layer. Symmetric
+ * positions may share an entry.
+ * @param pos a position with three Musketeers.
+ * @return its index in the layer of its enemy count.
+*/
+static inline uint64_t tbIndex(const Position *pos){
+    return rankCanonical(pos, NULL);
+}
+
+/**
+ * @brief The position stored at an index (the canonical one, if several
+ * symmetric positions share it).
+ * @param enemies the layer.
+ * @param index the index in that layer.
+ * @param pos filled in with the position.
+*/
+static inline void tbPosition(int enemies, uint64_t index, Position *pos){
+    unrankCanonical(enemies, index, pos);
+}
+
+/**
+ * @brief Solves a layer. The layer below must already be solved (its
+ * table with the enemies to move is the only one used) unless this is
+ * the layer without enemies.
+ * @param layer the layer to solve; its enemy count must be set.
+ * @param below the solved layer with one enemy less, or NULL for layer 0.
+ * @return 1 if the layer was solved, 0 if there was not enough memory.
+*/
+int tbSolveLayer(TBLayer *layer, const TBLayer *below);
+
+/**
+ * @brief Writes a solved layer to its file in a directory, through a
+ * temporary file that is renamed once it is whole.
+ * @param layer the layer.
+ * @param dir the directory.
+ * @param format TB_FORMAT_DTM or TB_FORMAT_WDL.
+ * @return 1 if writing works successfully, 0 if it fails.
+*/
+int tbWriteLayer(const TBLayer *layer, const char *dir, int format);
+
+/**
+ * @brief Reads a layer back from its DTM file (a WDL file does not hold
+ * enough to solve the next layer from), or from its shard files when
+ * there is no layer file or it cannot be read.
+ * @param layer the layer to fill in.
+ * @param dir the directory.
+ * @param enemies the layer to read.
+ * @return 1 if reading works successfully, 0 if the file is missing or damaged.
+*/
+int tbReadLayer(TBLayer *layer, const char *dir, int enemies);
+
+/**
+ * @brief Frees the tables of a layer.
+ * @param layer the layer.
+*/
+void tbFreeLayer(TBLayer *layer);
+
+/**
+ * @brief Solves part of a layer. The layer below must already be solved,
+ * as for tbSolveLayer.
+ * @param shard the part to solve; its enemies, first and last must be set.
+ * @param below the solved layer with one enemy less, or NULL for layer 0.
+ * @return 1 if the shard was solved, 0 if there was not enough memory.
+*/
+int tbSolveShard(TBShard *shard, const TBLayer *below);
+
+/**
+ * @brief Writes a solved shard to its file, under a temporary name that
+ * is renamed once the file is whole and on the disk.
+ * @param shard the shard.
+ * @param dir the directory.
+ * @return 1 if writing works successfully, 0 if it fails.
+*/
+int tbWriteShard(const TBShard *shard, const char *dir);
+
+/**
+ * @brief Frees the tables of a shard.
+ * @param shard the shard.
+*/
+void tbFreeShard(TBShard *shard);
+
+/**
+ * @brief Checks that a shard file is there and whole.
+ * @param dir the directory.
+ * @param enemies the layer.
+ * @param first the first triple of the shard.
+ * @param last one past its last triple.
+ * @return 1 if it is, 0 if it is missing or damaged.
+*/
+int tbCheckShard(const char *dir, int enemies, int first, int last);
+
+/**
+ * @brief Lists the shard files of a layer, whole or not.
+ * @param dir the directory.
+ * @param enemies the layer.
+ * @param count set to the number of files.
+ * @return their ranges, by first triple, to be freed with free(), or NULL
+ * if the directory cannot be read.
+*/
+TBShardRange *tbListShards(const char *dir, int enemies, int *count);
+
+/**
+ * @brief Looks for whole shard files that together cover a layer, the
+ * fewest there are, wherever the splits they came from overlap.
+ * @param dir the directory.
+ * @param enemies the layer.
+ * @param count set to the number of shards.
+ * @return the shards in triple order, to be freed with free(), or NULL if
+ * they do not cover the layer.
+*/
+TBShardRange *tbFindShards(const char *dir, int enemies, int *count);
+
+/**
+ * @brief The name of a shard file: tb-KK.tFFFF-LLLL.tmts for the triples
+ * from FFFF up to LLLL.
+ * @param dir the directory.
+ * @param enemies the layer.
+ * @param first the first triple.
+ * @param last one past the last.
+ * @param name filled in with the path.
+ * @param size the size of the name buffer.
+*/
+void tbShardName(const char *dir, int enemies, int first, int last, char name[], int size);
+
+/**
+ * @brief The name of the file holding a layer: tb-KK.tmtb for the DTM
+ * format and tb-KK.wdl.tmtb for the WDL format.
+ * @param dir the directory.
+ * @param enemies the layer.
+ * @param format TB_FORMAT_DTM or TB_FORMAT_WDL.
+ * @param name filled in with the path.
+ * @param size the size of the name buffer.
+*/
+void tbFileName(const char *dir, int enemies, int format, char name[], int size);
+
+#endif
@@ -0,0 +1,396 @@
+/**
+ * @file tbgen.c
+ * @brief Builds the endgame tablebases, one layer (enemy count) at a time,
+ * starting from the layer without enemies. Layers whose files are already
+ * there are read back instead of solved again, so an interrupted run picks
+ * up where it stopped. Only the layer being solved and the table of the
+ * layer below with the enemies to move are ever in memory.
+ *
+ * With "--shards S" the program coordinates instead of solving: every
+ * layer is cut into S runs of canonical Musketeer triples, and each one is
+ * solved by a worker (this program again, with "--shard K:FIRST:LAST")
+ * that writes a shard file of its own. Up to "--jobs J" workers run at a
+ * time, started through "--run CMD" (e.g. "ssh node%d", %d being the
+ * worker's slot) when they are to run on other machines sharing the
+ * directory. A worker that fails, or leaves no whole shard, is started
+ * again up to "--retries R" times; shards already there are kept, so a
+ * stopped run picks up where it stopped. The next layer starts once every
+ * shard of this one is done.
+ * @bug no known bugs
+ *
+*/
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "tablebase.h"
+
+#define DEFAULT_RETRIES 2       // times a failed shard is tried again
+
+/**
+ * @brief How the shards of each layer are farmed out.
+*/
+typedef struct {
+    const char *dir;            /**< where the files go */
+    const char *self;           /**< this program, for the workers */
+    const char *run;            /**< the command the workers are started through, or NULL to start them here */
+    int shards;                 /**< shards per layer */
+    int jobs;                   /**< workers at a time */
+    int retries;                /**< times a failed shard is tried again */
+} Coordinator;
+
+/**
+ * @brief One shard of the layer being solved, and its worker.
+*/
+typedef struct {
+    TBShardRange range;         /**< the triples */
+    int tries;                  /**< workers started on it so far */
+    int slot;                   /**< the slot of its worker */
+    pid_t pid;                  /**< its worker while it runs, 0 otherwise */
+} ShardJob;
+
+/**
+ * @brief Prints what a layer holds: its size, how many positions each
+ * side wins and the longest game with perfect play.
+ * @param layer the solved layer.
+*/
+void printLayer(const TBLayer *layer);
+
+/**
+ * @brief Solves one shard as a worker: reads the layer below, solves the
+ * triples and writes the shard file.
+ * @param dir the directory.
+ * @param shard "K:FIRST:LAST", the layer and the triples from FIRST up to LAST.
+ * @return 0 if the shard was written, 1 if not.
+*/
+int solveShard(const char *dir, const char *shard);
+
+/**
+ * @brief Solves a layer in shards, starting workers for every shard that
+ * is not there yet and again for those that fail.
+ * @param coordinator how to start the workers.
+ * @param enemies the layer.
+ * @return 1 if every shard of the layer is done, 0 if not.
+*/
+int coordinateLayer(const Coordinator *coordinator, int enemies);
+
+/**
+ * @brief Solves every layer up to the given enemy count, keeping a
+ * checkpoint file per layer.
+ * @param argc
+ * @param argv "--dir DIR" for where the files go (the current directory by
+ * default), "--max-enemies K" for the last layer (22 by default) and
+ * "--wdl" to also write the compact files that only hold the winner;
+ * "--shards S", "--jobs J", "--run CMD" and "--retries R" to solve in
+ * shards, and "--shard K:FIRST:LAST" for a worker.
+ * @return 0 if every layer was solved, 1 if not
+*/
+int main (int argc, char *argv[]){
+    const char *dir = ".", *shard = NULL;
+    Coordinator coordinator = { .run = NULL, .shards = 0, .jobs = 1, .retries = DEFAULT_RETRIES };
+    int maxEnemies = TB_MAX_ENEMIES;
+    int wdl = 0;
+    int i, k;
+
+    for (i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+            dir = argv[++i];
+        else if (strcmp(argv[i], "--max-enemies") == 0 && i + 1 < argc)
+            maxEnemies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--wdl") == 0)
+            wdl = 1;
+        else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc)
+            coordinator.shards = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            coordinator.jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--run") == 0 && i + 1 < argc)
+            coordinator.run = argv[++i];
+        else if (strcmp(argv[i], "--retries") == 0 && i + 1 < argc)
+            coordinator.retries = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--shard") == 0 && i + 1 < argc)
+            shard = argv[++i];
+        else {
+            printf("Usage: %s [--dir DIR] [--max-enemies K] [--wdl] [--shards S [--jobs J] [--run CMD] [--retries R]]\n"
+                   "       %s [--dir DIR] --shard K:FIRST:LAST\n", argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (shard != NULL)
+        return solveShard(dir, shard);
+    if (maxEnemies < 0 || maxEnemies > TB_MAX_ENEMIES){
+        printf("The number of enemies must be between 0 and %d.\n", TB_MAX_ENEMIES);
+        return 1;
+    }
+    if (coordinator.shards < 0 || coordinator.jobs < 1 || coordinator.retries < 0){
+        printf("The shards and retries must be at least 0 and the jobs at least 1.\n");
+        return 1;
+    }
+
+    // the workers run this same program, by its full path on the other machines
+    char self[PATH_MAX];
+    if (coordinator.shards > 0){
+        if (coordinator.run == NULL)
+            snprintf(self, sizeof(self), "/proc/self/exe");
+        else if (realpath(argv[0], self) == NULL){
+            printf("Failed to find the path of %s.\n", argv[0]);
+            return 1;
+        }
+        coordinator.dir = dir;
+        coordinator.self = self;
+    }
+
+    TBLayer below, layer;
+    below.table[0] = below.table[1] = NULL;
+
+    for (k = 0; k <= maxEnemies; k++){
+        clock_t start = clock();
+
+        if (tbReadLayer(&layer, dir, k))
+            printf("Layer %2d: already solved, ", k);
+        else if (coordinator.shards > 0){
+            time_t begin = time(NULL);
+
+            if (!coordinateLayer(&coordinator, k) || !tbReadLayer(&layer, dir, k)){
+                printf("Failed to solve the shards of layer %d.\n", k);
+                tbFreeLayer(&below);
+                return 1;
+            }
+            printf("Layer %2d: solved in shards in %.0fs, ", k, difftime(time(NULL), begin));
+        }
+        else {
+            layer.enemies = k;
+            if (!tbSolveLayer(&layer, k > 0 ? &below : NULL)){
+                printf("Not enough memory to solve layer %d.\n", k);
+                tbFreeLayer(&below);
+                return 1;
+            }
+            if (!tbWriteLayer(&layer, dir, TB_FORMAT_DTM)){
+                printf("Failed to save layer %d.\n", k);
+                tbFreeLayer(&below);
+                tbFreeLayer(&layer);
+                return 1;
+            }
+            printf("Layer %2d: solved in %.1fs, ", k, (double)(clock() - start) / CLOCKS_PER_SEC);
+        }
+        printLayer(&layer);
+
+        if (wdl && !tbWriteLayer(&layer, dir, TB_FORMAT_WDL)){
+            printf("Failed to save the WDL file of layer %d.\n", k);
+            tbFreeLayer(&below);
+            tbFreeLayer(&layer);
+            return 1;
+        }
+
+        // the next layer only needs this one with the enemies to move
+        tbFreeLayer(&below);
+        below = layer;
+        free(below.table[1]);
+        below.table[1] = NULL;
+    }
+
+    tbFreeLayer(&below);
+    return 0;
+}
+
+void printLayer(const TBLayer *layer){
+    uint64_t wins[2] = { 0, 0 }, i;
+    int side, longest = 0;
+
+    for (side = 0; side < 2; side++)
+        for (i = 0; i < layer->size; i++){
+            unsigned char e = layer->table[side][i];
+
+            if (TB_RESULT(e) == TB_MUSKETEERS_WIN)
+                wins[side]++;
+            if (TB_DISTANCE(e) > longest)
+                longest = TB_DISTANCE(e);
+        }
+
+    printf("%llu positions per side, Musketeers win %llu with the move and %llu without, longest game %d moves\n",
+        (unsigned long long)layer->size, (unsigned long long)wins[1], (unsigned long long)wins[0], longest);
+}
+
+int solveShard(const char *dir, const char *text){
+    TBShard shard;
+    TBLayer below;
+    char extra;
+    clock_t start = clock();
+
+    if (sscanf(text, "%d:%d:%d%c", &shard.enemies, &shard.first, &shard.last, &extra) != 3
+            || shard.enemies < 0 || shard.enemies > TB_MAX_ENEMIES
+            || shard.first < 0 || shard.first >= shard.last || shard.last > rankCanonicalTriples()){
+        printf("The shard must be K:FIRST:LAST, with K up to %d and 0 <= FIRST < LAST <= %d.\n",
+            TB_MAX_ENEMIES, rankCanonicalTriples());
+        return 1;
+    }
+
+    // only the entries with the enemies to move are needed from the layer below
+    below.table[0] = below.table[1] = NULL;
+    if (shard.enemies > 0){
+        if (!tbReadLayer(&below, dir, shard.enemies - 1)){
+            printf("Layer %d is not solved yet.\n", shard.enemies - 1);
+            return 1;
+        }
+        free(below.table[1]);
+        below.table[1] = NULL;
+    }
+
+    int ok = tbSolveShard(&shard, shard.enemies > 0 ? &below : NULL);
+    tbFreeLayer(&below);
+    if (!ok){
+        printf("Not enough memory to solve shard %s.\n", text);
+        return 1;
+    }
+    ok = tbWriteShard(&shard, dir);
+    tbFreeShard(&shard);
+    if (!ok){
+        printf("Failed to save shard %s.\n", text);
+        return 1;
+    }
+    printf("Shard %s: solved in %.1fs\n", text, (double)(clock() - start) / CLOCKS_PER_SEC);
+    return 0;
+}
+
+// starts the worker of a shard, through the run command if there is one
+static pid_t startWorker(const Coordinator *coordinator, int enemies, ShardJob *job){
+    char shard[64];
+
+    snprintf(shard, sizeof(shard), "%d:%d:%d", enemies, job->range.first, job->range.last);
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    if (coordinator->run == NULL)
+        execl(coordinator->self, coordinator->self, "--dir", coordinator->dir, "--shard", shard, (char *)NULL);
+    else {
+        char command[4 * PATH_MAX];
+        const char *p;
+        size_t length = 0;
+
+        // the run command with every %d made the slot, then the worker's own command line
+        for (p = coordinator->run; *p != '\0' && length + 16 < sizeof(command); p++)
+            if (p[0] == '%' && p[1] == 'd'){
+                length += (size_t)snprintf(command + length, sizeof(command) - length, "%d", job->slot);
+                p++;
+            }
+            else
+                command[length++] = *p;
+        snprintf(command + length, sizeof(command) - length, " '%s' --dir '%s' --shard %s",
+            coordinator->self, coordinator->dir, shard);
+        execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+    }
+    _exit(127);
+}
+
+// says whether a shard that failed is tried again
+static int retryShard(const Coordinator *coordinator, int enemies, const ShardJob *job){
+    if (job->tries <= coordinator->retries){
+        printf("Shard %d:%d:%d failed, starting it again.\n", enemies, job->range.first, job->range.last);
+        return 1;
+    }
+    printf("Shard %d:%d:%d failed %d times.\n", enemies, job->range.first, job->range.last, job->tries);
+    return 0;
+}
+
+int coordinateLayer(const Coordinator *coordinator, int enemies){
+    int triples = rankCanonicalTriples();
+    int count = coordinator->shards < triples ? coordinator->shards : triples;
+    ShardJob *jobs = calloc((size_t)count, sizeof(ShardJob));
+    int *pending = malloc((size_t)count * sizeof(int));
+    int *slots = malloc((size_t)coordinator->jobs * sizeof(int));
+    int i, head = 0, waiting = 0, running = 0, freeSlots = 0, failed = 0;
+
+    if (jobs == NULL || pending == NULL || slots == NULL){
+        free(jobs);
+        free(pending);
+        free(slots);
+        return 0;
+    }
+    for (i = coordinator->jobs - 1; i >= 0; i--)
+        slots[freeSlots++] = i;
+
+    // the shards already there from an earlier run are kept
+    for (i = 0; i < count; i++){
+        jobs[i].range.first = (int)((int64_t)triples * i / count);
+        jobs[i].range.last = (int)((int64_t)triples * (i + 1) / count);
+        if (!tbCheckShard(coordinator->dir, enemies, jobs[i].range.first, jobs[i].range.last))
+            pending[(head + waiting++) % count] = i;
+    }
+
+    // files from a run with another number of shards are not solved again, but they are not needed either
+    int found, k;
+    TBShardRange *files = tbListShards(coordinator->dir, enemies, &found);
+    for (k = 0; files != NULL && k < found; k++){
+        for (i = 0; i < count; i++)
+            if (jobs[i].range.first == files[k].first && jobs[i].range.last == files[k].last)
+                break;
+        if (i == count){
+            char name[FILENAME_MAX];
+
+            tbShardName(coordinator->dir, enemies, files[k].first, files[k].last, name, sizeof(name));
+            printf("%s is not part of this split into %d shards and can be removed.\n", name, count);
+        }
+    }
+    free(files);
+
+    while (waiting > 0 || running > 0){
+        // as many workers as there are free slots
+        while (waiting > 0 && freeSlots > 0){
+            ShardJob *job = &jobs[pending[head]];
+
+            head = (head + 1) % count;
+            waiting--;
+            job->slot = slots[--freeSlots];
+            job->tries++;
+            job->pid = startWorker(coordinator, enemies, job);
+            if (job->pid < 0){
+                printf("Failed to start a worker.\n");
+                job->pid = 0;
+                slots[freeSlots++] = job->slot;
+                if (retryShard(coordinator, enemies, job))
+                    pending[(head + waiting++) % count] = (int)(job - jobs);
+                else
+                    failed++;
+                break;                  // fork may only be short of processes for a moment
+            }
+            running++;
+        }
+        if (running == 0){
+            if (waiting == 0)
+                break;
+            sleep(1);
+            continue;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0)
+            break;
+        for (i = 0; i < count && jobs[i].pid != pid; i++)
+            ;
+        if (i == count)
+            continue;                   // not one of the workers
+
+        ShardJob *job = &jobs[i];
+        job->pid = 0;
+        running--;
+        slots[freeSlots++] = job->slot;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0
+                && tbCheckShard(coordinator->dir, enemies, job->range.first, job->range.last))
+            continue;
+
+        if (retryShard(coordinator, enemies, job))
+            pending[(head + waiting++) % count] = i;
+        else
+            failed++;
+    }
+
+    free(jobs);
+    free(pending);
+    free(slots);
+    return failed == 0;
+}
@@ -0,0 +1,213 @@
+/**
+ * @file tbprobe.c
+ * @brief Lazy memory mapping and lookup of tablebase files.
+ * @bug no known bugs
+ *
+*/
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "tbprobe.h"
+
+void tbProbeOpen(TBProbe *tb, const char *dir){
+    memset(tb->layers, 0, sizeof(tb->layers));
+    snprintf(tb->dir, sizeof(tb->dir), "%s", dir);
+    pthread_mutex_init(&tb->lock, NULL);
+}
+
+// unmaps the shard files of a layer
+static void unmapShards(TBMappedLayer *layer){
+    int i;
+
+    for (i = 0; i < layer->shards; i++)
+        munmap((void *)layer->shard[i].map, layer->shard[i].mapSize);
+    free(layer->shard);
+    free(layer->shardOf);
+    layer->shards = 0;
+    layer->shard = NULL;
+    layer->shardOf = NULL;
+}
+
+void tbProbeClose(TBProbe *tb){
+    int k;
+
+    for (k = 0; k <= TB_MAX_ENEMIES; k++)
+        if (tb->layers[k].state == 1){
+            if (tb->layers[k].shards > 0)
+                unmapShards(&tb->layers[k]);
+            else
+                munmap((void *)tb->layers[k].map, tb->layers[k].mapSize);
+        }
+    memset(tb->layers, 0, sizeof(tb->layers));
+    pthread_mutex_destroy(&tb->lock);
+}
+
+// maps one file if its header is right for this layer
+static int mapFile(TBMappedLayer *layer, const char *name, int enemies, int format){
+    int fd = open(name, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    TBHeader header;
+    uint64_t size = tbLayerSize(enemies);
+    size_t expected = sizeof(header) + 2 * tbTableBytes(size, format);
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != expected
+            || read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)
+            || memcmp(header.magic, TB_MAGIC, 4) != 0 || header.version != TB_VERSION
+            || header.boardSize != N || header.enemies != (uint32_t)enemies
+            || header.size != size || header.format != (uint32_t)format){
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, expected, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+    madvise(map, expected, MADV_RANDOM);        // probes jump all over the file
+
+    layer->format = format;
+    layer->size = size;
+    layer->map = map;
+    layer->mapSize = expected;
+    return 1;
+}
+
+// maps every shard file of a layer, if they cover it
+static int mapShards(TBMappedLayer *layer, const char *dir, int enemies){
+    uint64_t per = rankChoose(TB_MAX_ENEMIES, enemies);
+    int count, i, t, ok;
+    TBShardRange *ranges = tbFindShards(dir, enemies, &count);
+
+    if (ranges == NULL)
+        return 0;
+    layer->shard = calloc((size_t)count, sizeof(TBMappedShard));
+    layer->shardOf = malloc((size_t)rankCanonicalTriples() * sizeof(unsigned short));
+    ok = layer->shard != NULL && layer->shardOf != NULL;
+
+    for (i = 0; ok && i < count; i++){
+        char name[FILENAME_MAX];
+        TBMappedShard *shard = &layer->shard[i];
+        int fd;
+
+        tbShardName(dir, enemies, ranges[i].first, ranges[i].last, name, sizeof(name));
+        shard->start = (uint64_t)ranges[i].first * per;
+        shard->size = (uint64_t)(ranges[i].last - ranges[i].first) * per;
+        shard->mapSize = sizeof(TBShardHeader) + 2 * shard->size;
+        if ((fd = open(name, O_RDONLY)) < 0){
+            ok = 0;
+            break;
+        }
+        void *map = mmap(NULL, shard->mapSize, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED){
+            ok = 0;
+            break;
+        }
+        madvise(map, shard->mapSize, MADV_RANDOM);
+        shard->map = map;
+        layer->shards = i + 1;
+        for (t = ranges[i].first; t < ranges[i].last; t++)
+            layer->shardOf[t] = (unsigned short)i;
+    }
+    free(ranges);
+
+    if (!ok){
+        unmapShards(layer);
+        return 0;
+    }
+    layer->format = TB_FORMAT_DTM;
+    layer->size = tbLayerSize(enemies);
+    return 1;
+}
+
+// the layer's file, mapped on first use
+static const TBMappedLayer *getLayer(TBProbe *tb, int enemies){
+    TBMappedLayer *layer = &tb->layers[enemies];
+    int state = __atomic_load_n(&layer->state, __ATOMIC_ACQUIRE);
+
+    if (state == 0){
+        char name[FILENAME_MAX];
+
+        pthread_mutex_lock(&tb->lock);
+        state = layer->state;
+        if (state == 0){
+            tbFileName(tb->dir, enemies, TB_FORMAT_DTM, name, sizeof(name));
+            if (!mapFile(layer, name, enemies, TB_FORMAT_DTM)){
+                tbFileName(tb->dir, enemies, TB_FORMAT_WDL, name, sizeof(name));
+                if (!mapFile(layer, name, enemies, TB_FORMAT_WDL) && !mapShards(layer, tb->dir, enemies))
+                    state = -1;
+            }
+            if (state == 0)
+                state = 1;
+            __atomic_store_n(&layer->state, state, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&tb->lock);
+    }
+    return state == 1 ? layer : NULL;
+}
+
+int tbProbe(TBProbe *tb, const Position *pos, int mTurn, int *result, int *distance){
+    int enemies = bbCount(pos->enemies);
+    if (bbCount(pos->musketeers) != TB_MUSKETEERS || enemies > TB_MAX_ENEMIES)
+        return 0;
+
+    const TBMappedLayer *layer = getLayer(tb, enemies);
+    if (layer == NULL)
+        return 0;
+
+    // the Musketeers' entries come first
+    uint64_t index = tbIndex(pos);
+    const unsigned char *table;
+    if (layer->shards > 0){
+        const TBMappedShard *shard = &layer->shard[layer->shardOf[index / rankChoose(TB_MAX_ENEMIES, enemies)]];
+
+        table = shard->map + sizeof(TBShardHeader) + (mTurn ? 0 : shard->size);
+        index -= shard->start;
+    }
+    else
+        table = layer->map + sizeof(TBHeader) + (mTurn ? 0 : tbTableBytes(layer->size, layer->format));
+
+    if (layer->format == TB_FORMAT_WDL){
+        *result = (table[index / 4] >> (2 * (index % 4))) & 3;
+        *distance = -1;
+    }
+    else {
+        *result = TB_RESULT(table[index]);
+        *distance = TB_DISTANCE(table[index]);
+    }
+    return *result != TB_UNKNOWN;
+}
+
+int tbBestMove(TBProbe *tb, const Position *pos, int mTurn, Move *best, int *result, int *distance){
+    if (posWinGame(pos) || !tbProbe(tb, pos, mTurn, result, distance))
+        return 0;
+
+    MoveList list;
+    int i, win = mTurn ? TB_MUSKETEERS_WIN : TB_ENEMIES_WIN;
+    int bestDistance = 0, found = 0;
+
+    generateMoves(pos, mTurn, &list);
+    for (i = 0; i < list.count; i++){
+        Position child = *pos;
+        int r, d;
+
+        posMakeMove(&child, list.moves[i], mTurn);
+        if (!tbProbe(tb, &child, !mTurn, &r, &d))
+            return 0;
+
+        // a winning move must keep the win; among those the fastest, otherwise the slowest loss
+        if (*result == win ? (r == win && (!found || d < bestDistance))
+                           : (!found || d > bestDistance)){
+            *best = list.moves[i];
+            bestDistance = d;
+            found = 1;
+        }
+    }
+    return found;
+}
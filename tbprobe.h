@@ -0,0 +1,93 @@
+/**
+ * @file tbprobe.h
+ * @brief Looking positions up in the tablebase files at run time. Files are
+ * memory-mapped the first time a position of their layer is probed, so
+ * opening the tablebases costs nothing and only the pages holding positions
+ * that are actually reached are ever read from disk. DTM files are preferred;
+ * WDL files are used when they are all there is, and then give no distance.
+ * A layer with neither is mapped from its shard files, if they cover it.
+ * Probing is safe from several threads at once.
+ * @bug no known bugs
+ *
+*/
+#ifndef TBPROBE_H
+#define TBPROBE_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "tablebase.h"
+
+/**
+ * @brief One shard file of a layer that has no file of its own.
+*/
+typedef struct {
+    uint64_t start;                 /**< the layer index of its first entry */
+    uint64_t size;                  /**< entries per side to move */
+    const unsigned char *map;       /**< the whole file */
+    size_t mapSize;                 /**< length of the mapping */
+} TBMappedShard;
+
+/**
+ * @brief One layer's file, once it has been looked for.
+*/
+typedef struct {
+    int state;                      /**< 0 not looked for yet, 1 mapped, -1 not available */
+    int format;                     /**< TB_FORMAT_DTM or TB_FORMAT_WDL */
+    uint64_t size;                  /**< entries per side to move */
+    const unsigned char *map;       /**< the whole file */
+    size_t mapSize;                 /**< length of the mapping */
+    int shards;                     /**< 0 for a layer file, otherwise the number of shard files mapped instead */
+    TBMappedShard *shard;           /**< the shard files, in triple order */
+    unsigned short *shardOf;        /**< the shard holding every canonical triple */
+} TBMappedLayer;
+
+/**
+ * @brief A set of tablebase files in one directory.
+*/
+typedef struct {
+    char dir[FILENAME_MAX];                         /**< where the files are */
+    TBMappedLayer layers[TB_MAX_ENEMIES + 1];       /**< the files, by enemy count */
+    pthread_mutex_t lock;                           /**< held while a file is being mapped */
+} TBProbe;
+
+/**
+ * @brief Gets ready to probe the files in a directory. No file is opened yet.
+ * @param tb the tablebases.
+ * @param dir the directory holding the files.
+*/
+void tbProbeOpen(TBProbe *tb, const char *dir);
+
+/**
+ * @brief Unmaps every file that was mapped.
+ * @param tb the tablebases.
+*/
+void tbProbeClose(TBProbe *tb);
+
+/**
+ * @brief Looks a position up.
+ * @param tb the tablebases.
+ * @param pos the position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @param result set to TB_MUSKETEERS_WIN or TB_ENEMIES_WIN.
+ * @param distance set to the number of moves until the game ends with
+ * perfect play, or -1 if only a WDL file is available.
+ * @return 1 if the position was found, 0 if its layer is not available.
+*/
+int tbProbe(TBProbe *tb, const Position *pos, int mTurn, int *result, int *distance);
+
+/**
+ * @brief Picks a perfect move using the tablebases: the quickest win if
+ * there is one, otherwise the slowest loss. With WDL files any winning
+ * move is taken.
+ * @param tb the tablebases.
+ * @param pos the position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @param best set to the move.
+ * @param result set to the result of the position.
+ * @param distance set to the distance to the end, or -1 with WDL files.
+ * @return 1 if a move was found, 0 if the tablebases cannot tell or there is no move.
+*/
+int tbBestMove(TBProbe *tb, const Position *pos, int mTurn, Move *best, int *result, int *distance);
+
+#endif
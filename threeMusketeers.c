@@ -9,31 +9,131 @@
  * @bug no known bugs
  * 
 */
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <ctype.h>
-#define N 5
+#include <unistd.h>
+#include "game.h"
+#include "search.h"
+#include "mcts.h"
+#include "corpus.h"
+#include "savegame.h"
+#include "boardio.h"
+#include "rules.h"
+#include "moveparse.h"
+#include "journal.h"
+#include "ponder.h"
+
+#define DEFAULT_DEPTH 8         // moves the computer looks ahead unless told otherwise
+#define DEFAULT_HASH 16         // megabytes for the computer's transposition table
+#define SCRIPT_CHUNK 65536      // bytes read at a time from a batch move script
+#define MOVE_LINE 64            // longest move line, newline included; a longer one is rejected whole
+#define LINE_TOO_LONG -1        // what readLine says about a line longer than that
 
 /**
- * @brief Reads the contents of a specified file and uses it to
- * initialize the game board represented as a 2D character array. It checks
- * the validity of the input and ensures the proper dimensions of the board.
- * @param board the 2D array representing the game board.
- * @param filename the name of the file from which to read the game board.
- * @return 1 if reading the board works successfully, 0 if it fails.
+ * @brief The command line settings that change how a game is played.
 */
-int readBoard (char board[][N], char filename[]);
+typedef struct {
+    int engineSide;     /**< side the computer plays: 1 for Musketeers, 0 for enemies, -1 for none */
+    int depth;          /**< how many moves ahead the computer looks */
+    int hashMegabytes;  /**< memory budget of the transposition table */
+    char *tablebaseDir; /**< directory of the tablebase files, or NULL */
+    int batch;          /**< 1 to play a move script without printing boards or prompts */
+    char *movesFile;    /**< the move script in batch mode, or NULL for stdin */
+    int corpus;         /**< 1 when the file is a corpus of positions to analyse */
+    int saveFormats;    /**< what a game is saved as: SAVE_TEXT, SAVE_BINARY or both */
+    int threads;        /**< how many threads the computer searches with */
+    int analyse;        /**< 1 to search the board once and report on the search */
+    int moveTime;       /**< milliseconds the computer may think per move, or 0 for no limit */
+    uint64_t nodes;     /**< positions the computer may search per move, or 0 for no limit */
+    int mcts;           /**< 1 for the computer to play with Monte Carlo Tree Search */
+    uint64_t playouts;  /**< random games it plays per move, or 0 for its default */
+    char *journalFile;  /**< the journal the game is kept in, or NULL */
+    int syncEvery;      /**< moves between fsyncs of the journal, or 0 for none */
+    int ponder;         /**< 1 for the computer to think while the player types */
+} PlayOptions;
 
 /**
- * @brief Writes and saves the current game state, represented by the 2D array, 
- * to the specified file. It creates a text file containing the board layout and 
- * allows you to save your progress and continue the game later.
- * @param board the 2D array representing the game board.
- * @param filename the name of the file from which to write the game board.
- * @return 1 if writing the board works successfully, 0 if it fails.
+ * @brief What has been read from the standard input but not used yet.
+*/
+typedef struct {
+    char data[MOVE_LINE];   /**< the bytes read */
+    size_t length;          /**< how many there are */
+    int ended;              /**< 1 once the input has ended */
+    int skipping;           /**< 1 while the rest of a line that was too long is thrown away */
+} LineInput;
+
+/**
+ * @brief Everything the computer plays with.
+*/
+typedef struct {
+    SearchSettings settings;    /**< the alpha-beta search, pointing at tt and tb when they are used */
+    TransTable tt;              /**< the transposition table */
+    TBProbe tb;                 /**< the tablebases */
+    int useMcts;                /**< 1 to pick moves with Monte Carlo Tree Search instead */
+    Mcts mcts;                  /**< its trees, one per thread */
+    MctsSettings mctsSettings;  /**< how long it searches */
+} Engine;
+
+/**
+ * @brief Reads the command line options and the name of the board file.
+ * "--computer musketeers" (or M) and "--computer enemies" (or o) let the
+ * computer play one side, "--depth D" sets how far it looks ahead and
+ * "--hash MB" how much memory its transposition table may use,
+ * "--threads T" how many threads it searches with (all the processors by
+ * default), and "--tb DIR" where to find tablebase files. "--movetime MS"
+ * and "--nodes N" limit the time and positions of every search; without
+ * "--depth" the search then goes as deep as the limits allow. "--mcts"
+ * plays with Monte Carlo Tree Search instead, "--playouts N" random games
+ * (or "--movetime MS") per move, in the memory "--hash" gives. "--batch" (or "--quiet") plays
+ * a whole move script, read from "--moves FILE" or stdin, headlessly, and
+ * "--corpus" analyses every position of a corpus file instead of playing.
+ * "--analyse" searches the board once and reports the speed of each thread.
+ * "--save text|binary|both" picks the save files written (text by default).
+ * "--journal FILE" keeps every move in a journal and, when the file is
+ * already a journal, carries on the game it holds instead of starting from
+ * the board file; "--sync N" fsyncs it every N moves. "--no-ponder" stops
+ * the computer from thinking while the player types.
+ * @param argc the number of command line arguments.
+ * @param argv the command line arguments.
+ * @param options filled in with the settings given.
+ * @param filename set to the name of the board file.
+ * @return 1 if the command line makes sense, 0 if it does not.
+*/
+int parseArguments(int argc, char *argv[], PlayOptions *options, char **filename);
+
+/**
+ * @brief Reads the next line typed in, waiting for it with poll so that
+ * the pondering thread has the processor in the meantime. A line that
+ * does not fit is thrown away up to its newline, and reported once.
+ * @param input what was read before and not used yet.
+ * @param line filled in with the line, newline included, and a '\0'.
+ * @param size the size of line, at most MOVE_LINE.
+ * @return 1 if there is a line, LINE_TOO_LONG if it did not fit, 0 once
+ * the input has ended.
+*/
+int readLine(LineInput *input, char line[], size_t size);
+
+/**
+ * @brief Reads the game to start from: a binary save file, which knows
+ * whose turn it is, or else a text board, which starts with the Musketeers.
+ * @param saved filled in with the game.
+ * @param filename the name of the file to read.
+ * @return 1 if reading works successfully, 0 if it fails.
 */
-int writeBoard(char board[][N], char filename[]);
+int loadGame(SavedGame *saved, char filename[]);
+
+/**
+ * @brief Saves a game in every format the options ask for.
+ * @param saved the game to save.
+ * @param filename the name of the file the game was read from.
+ * @param options the command line settings.
+ * @param quiet 1 to save without telling the user, 0 to print where it went.
+ * @return 1 if every file was written, 0 if one of them failed.
+*/
+int saveGame(const SavedGame *saved, char filename[], const PlayOptions *options, int quiet);
 
 /**
  * @brief Prints the current state of the game board to the console,
@@ -45,96 +145,110 @@ void display_board(char board[][N]);
 /**
  * @brief This function basically initiates and controlls the game. 
  * It takes user input for moves and keeps going in a loop until 
- * someone from either teams has won.
- * @param board the 2D array representing the game board.
+ * someone from either teams has won. When the computer plays one
+ * of the sides, it searches for that side's moves instead.
+ * @param start the game to start from.
+ * @param outfile the name used for the saved game file.
+ * @param options the command line settings.
+ * @param journal where every move is written as soon as it is played, or NULL.
 */
-void play(char board[][N], char outfile[]);
+void play(const SavedGame *start, char outfile[], const PlayOptions *options, Journal *journal);
 
 /**
- * @brief Checks and validates whether a move is within the 
- * boundaries of the game board in general and follows
- * a valid direction (L/l, R/r, U/u, D/d).
- * @param row The row where the move is initiated.
- * @param col The column where the move is initiated.
- * @param direction The direction of the move (L/l, R/r, U/u, D/d).
- * @param board the 2D array representing the game board.
- * @return 1 if the move is valid, 0 if it is not.
+ * @brief Plays a whole move script in one go, for replaying games
+ * without a terminal. The script is read in full first, one move per
+ * line as in play(), and nothing is printed until the end: then the
+ * result and the saved board go out in a single write. Moves that are
+ * not legal are skipped, just like play() asks again for them.
+ * @param start the game to start from.
+ * @param outfile the name used for the saved game file.
+ * @param moves the move script.
+ * @param options the command line settings.
+ * @param journal where the moves are written, all together at the end, or NULL.
+ * @return 1 if the script could be read, 0 if it could not.
 */
-int isValidMove (int row, int col, char direction, char board[][N]);
+int playBatch(const SavedGame *start, char outfile[], FILE *moves, const PlayOptions *options, Journal *journal);
 
 /**
- * @brief This function specifically validates moves 
- * for the Musketeer player, ensuring that they only 
- * move in valid directions and that there is a 
- * Musketeer there at all.
- * @param row The row where the move is initiated.
- * @param col The column where the move is initiated.
- * @param direction The direction of the move (L/l, R/r, U/u, D/d).
- * @param board the 2D array representing the game board.
- * @return 1 if the move is valid for a Musketeer, 0 if it is not.
+ * @brief Takes down where a game has got to, ready to be saved.
+ * @param game the game in progress.
+ * @param start the game it started from.
+ * @param now filled in with the current position, side and move count.
 */
-int isValidMusketeerMove(int row, int col, char direction, char board[][N]);
+void gameSnapshot(const Game *game, const SavedGame *start, SavedGame *now);
 
 /**
- * @brief  This function specifically validates moves 
- * for the enemies player, ensuring that they only 
- * move in valid directions and that there are 
- * enemies in the specific moves they ask for.
- * @param row The row where the move is initiated.
- * @param col The column where the move is initiated.
- * @param direction The direction of the move (L/l, R/r, U/u, D/d).
- * @param board the 2D array representing the game board.
- * @return 1 if the move is valid for an enemy, 0 if it is not.
+ * @brief Plays a move and adds it to the journal, if there is one.
+ * @param game the game.
+ * @param start the game it started from.
+ * @param journal the journal, or NULL.
+ * @param move an already validated move.
+ * @return 1 if the move was played, 0 if the undo stack is full and it was not.
 */
-int isValidEnemyMove(int row, int col, char direction, char board[][N]);
+int playMove(Game *game, const SavedGame *start, Journal *journal, Move move);
 
 /**
- * @brief This function applies a valid move to the game board 
- * based on the coordinates and direction as well as whose
- * turn it is (Musketeer or enemy).
- * @param row The row where the move is initiated.
- * @param col The column where the move is initiated.
- * @param direction The direction of the move (L/l, R/r, U/u, D/d).
- * @param board the 2D array representing the game board.
- * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @brief Searches every position of a corpus (see corpus.h) and prints
+ * one line for each: its number, then the best move and its score for
+ * the side to move, or "over" and the winner if the game has ended.
+ * @param filename the corpus, or "-" for the standard input.
+ * @param options the command line settings (depth, hash and tablebases).
+ * @return 1 if the corpus was read, 0 if it could not be.
 */
-void makeMove(int row, int col, char direction, char board[][N], int mTurn);
+int analyseCorpus(char filename[], const PlayOptions *options);
 
 /**
- * @brief This function is called when the user inputs a 
- * specific command to interrupt the game. It saves 
- * the current game state to a file by calling the
- * writeBoard function, for later resumption.
- * @param board the 2D array representing the game board.
+ * @brief Searches the game to start from once, and prints the best move,
+ * its score, and the nodes and nodes per second of every search thread.
+ * @param start the game to search.
+ * @param options the command line settings (depth, hash, threads and tablebases).
+ * @return 1 if there was a move to search for, 0 if there was not.
 */
-void gameInterrupt (char board[][N], char outfile[]);
+int analyseGame(const SavedGame *start, const PlayOptions *options);
 
 /**
- * @brief determines the game's outcome by checking if
- * either the Musketeers or the enemies have won the 
- * game based on the current game board.
- * @param board the 2D array representing the game board.
- * @return 1 if any opposing team has won, 0 if none have won.
+ * @brief Sets up what the computer needs: a transposition table (or the
+ * Monte Carlo trees) when it plays a side or analyses, and the tablebases
+ * when a directory was given.
+ * @param options the command line settings.
+ * @param engine filled in; it must stay where it is until engineStop.
 */
-int winGame(char board[][N]);
+void engineStart(const PlayOptions *options, Engine *engine);
 
 /**
- * @brief checks for victory conditions for the Musketeer 
- * team, ensuring that the enemies cannot capture all Musketeers,
- * based on the current game board. 
- * @param board the 2D array representing the game board.
- * @return 1 if the Musketeers have won, 0 if they have not.
+ * @brief Picks the computer's move: from the tablebases when they cover
+ * the position, otherwise with the search the options asked for.
+ * @param engine what engineStart set up.
+ * @param game the game. It is not changed.
+ * @param move set to the move.
+ * @return 1 if a move was found, 0 if the side to move has none.
 */
-int winMusketeers(char board[][N]);
+int engineMove(Engine *engine, const Game *game, Move *move);
 
 /**
- * @brief This function checks for victory conditions 
- * for the enemy team, such as having all three Musketeers 
- * in the same row or column, based on the current game board.
- * @param board the 2D array representing the game board.
- * @return 1 if the enemies have won, 0 if they have not.
+ * @brief Frees what engineStart set up.
+ * @param engine what engineStart set up.
 */
-int winEnemies(char board[][N]);
+void engineStop(Engine *engine);
+
+/**
+ * @brief Prints what the tablebases say about the current position,
+ * if its layer is available.
+ * @param tb the tablebases.
+ * @param game the game in progress.
+*/
+void printVerdict(TBProbe *tb, const Game *game);
+
+/**
+ * @brief This function is called when the user inputs a 
+ * specific command to interrupt the game. It saves 
+ * the current game state to a file by calling the
+ * saveGame function, for later resumption.
+ * @param now the game as it stands.
+ * @param outfile the name used for the saved game file.
+ * @param options the command line settings.
+*/
+void gameInterrupt (const SavedGame *now, char outfile[], const PlayOptions *options);
 
 /**
  * @brief reads the user file input and proceeds to play the game
@@ -144,87 +258,235 @@ int winEnemies(char board[][N]);
  * @return 0 if the program is done running 
 */
 int main (int argc, char *argv[]){
-    char board[N][N];
-    // const char* filename;                           // input file
-   // const char* outputFile = "out-inputfile.txt";   // output file
-    
-    readBoard(board, argv[1]);
+    SavedGame start;
+    char *filename;
+    PlayOptions options;
+
+    if (!parseArguments(argc, argv, &options, &filename)){
+        printf("Usage: %s [--computer musketeers|enemies] [--depth D] [--hash MB] [--threads T] [--movetime MS] [--nodes N] [--mcts [--playouts N]] [--tb DIR] [--batch [--moves FILE]] [--corpus] [--analyse] [--save text|binary|both] [--journal FILE [--sync N]] [--no-ponder] <board file>\n", argv[0]);
+        return 0;
+    }
+
+    if (options.corpus)
+        return !analyseCorpus(filename, &options);
 
     // read the board and print an error message if it fails
-    if (!readBoard(board, argv[1])){
+    if (!loadGame(&start, filename)){
         printf("Failed to read the board from the file.\n");
         return 0;
     }
 
-    play(board, argv[1]);
+    if (options.analyse)
+        return !analyseGame(&start, &options);
 
-    return 0;
-}
+    // a journal that is already there holds the game to carry on
+    Journal journal, *kept = NULL;
+    if (options.journalFile){
+        if (journalResume(&journal, options.journalFile, &start, options.syncEvery)){
+            if (!options.batch)
+                printf("Carrying on from %s after %d moves.\n", options.journalFile, start.moves);
+            kept = &journal;
+        }
+        else if (journalCreate(&journal, options.journalFile, &start, options.syncEvery))
+            kept = &journal;
+        else
+            printf("Error creating the journal: %s\n", options.journalFile);
+    }
 
-// Reads the board from a given file
-int readBoard (char board[][N], char filename[]){
-    FILE* file = fopen(filename, "r");
+    if (options.batch){
+        FILE *moves = options.movesFile ? fopen(options.movesFile, "r") : stdin;
 
-    if (file == NULL){
-        printf("Error opening the file: %s\n", filename);
-        return 0;
+        if (moves == NULL)
+            printf("Error opening the move script: %s\n", options.movesFile);
+        else {
+            if (!playBatch(&start, filename, moves, &options, kept))
+                printf("Failed to read the move script.\n");
+            if (moves != stdin)
+                fclose(moves);
+        }
     }
+    else
+        play(&start, filename, &options, kept);
 
-    int i,k;
-    for (i = 0; i < N; i++)
-        for (k = 0; k < N; k++){
-            int ch = fgetc(file);
+    if (kept && !journalClose(kept))
+        printf("Error writing the journal: %s\n", options.journalFile);
+    return 0;
+}
 
-            if (ch == EOF || ch != 'o' && ch != 'M' && ch != '\n' && ch != ' ' && ch != '.'){
-                printf("Invalid character in the input file\n");
-                fclose(file);
+// Reads the options given on the command line
+int parseArguments(int argc, char *argv[], PlayOptions *options, char **filename){
+    options->engineSide = -1;
+    options->depth = DEFAULT_DEPTH;
+    options->hashMegabytes = DEFAULT_HASH;
+    options->tablebaseDir = NULL;
+    options->batch = 0;
+    options->movesFile = NULL;
+    options->corpus = 0;
+    options->saveFormats = SAVE_TEXT;
+    options->threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (options->threads > SEARCH_MAX_THREADS)
+        options->threads = SEARCH_MAX_THREADS;
+    options->analyse = 0;
+    options->moveTime = 0;
+    options->nodes = 0;
+    options->mcts = 0;
+    options->playouts = 0;
+    options->journalFile = NULL;
+    options->syncEvery = 0;
+    options->ponder = 1;
+    *filename = NULL;
+
+    int i, depthGiven = 0;
+    for (i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--computer") == 0 && i + 1 < argc){
+            char side = argv[++i][0];
+
+            if (side == 'M' || side == 'm')
+                options->engineSide = 1;
+            else if (side == 'o' || side == 'e' || side == 'E')
+                options->engineSide = 0;
+            else
                 return 0;
-            }
-
-            if (ch != '\n' && ch != ' ')
-                board[i][k] = (char)ch;
+        }
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc){
+            options->depth = atoi(argv[++i]);
+            if (options->depth < 1)
+                return 0;
+            depthGiven = 1;
+        }
+        else if (strcmp(argv[i], "--movetime") == 0 && i + 1 < argc){
+            options->moveTime = atoi(argv[++i]);
+            if (options->moveTime < 1)
+                return 0;
+        }
+        else if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc){
+            options->nodes = strtoull(argv[++i], NULL, 10);
+            if (options->nodes < 1)
+                return 0;
+        }
+        else if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc){
+            options->hashMegabytes = atoi(argv[++i]);
+            if (options->hashMegabytes < 1)
+                return 0;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc){
+            options->threads = atoi(argv[++i]);
+            if (options->threads < 1 || options->threads > SEARCH_MAX_THREADS)
+                return 0;
+        }
+        else if (strcmp(argv[i], "--mcts") == 0)
+            options->mcts = 1;
+        else if (strcmp(argv[i], "--playouts") == 0 && i + 1 < argc){
+            options->playouts = strtoull(argv[++i], NULL, 10);
+            if (options->playouts < 1)
+                return 0;
+        }
+        else if (strcmp(argv[i], "--no-ponder") == 0)
+            options->ponder = 0;
+        else if (strcmp(argv[i], "--analyse") == 0)
+            options->analyse = 1;
+        else if (strcmp(argv[i], "--tb") == 0 && i + 1 < argc)
+            options->tablebaseDir = argv[++i];
+        else if (strcmp(argv[i], "--batch") == 0 || strcmp(argv[i], "--quiet") == 0)
+            options->batch = 1;
+        else if (strcmp(argv[i], "--moves") == 0 && i + 1 < argc)
+            options->movesFile = argv[++i];
+        else if (strcmp(argv[i], "--corpus") == 0)
+            options->corpus = 1;
+        else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc)
+            options->journalFile = argv[++i];
+        else if (strcmp(argv[i], "--sync") == 0 && i + 1 < argc){
+            options->syncEvery = atoi(argv[++i]);
+            if (options->syncEvery < 0)
+                return 0;
+        }
+        else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc){
+            i++;
+            if (strcmp(argv[i], "text") == 0)
+                options->saveFormats = SAVE_TEXT;
+            else if (strcmp(argv[i], "binary") == 0)
+                options->saveFormats = SAVE_BINARY;
+            else if (strcmp(argv[i], "both") == 0)
+                options->saveFormats = SAVE_TEXT | SAVE_BINARY;
             else
-                k--;
+                return 0;
         }
+        else if (strcmp(argv[i], "-") == 0 && *filename == NULL)
+            *filename = argv[i];                // a corpus on the standard input
+        else if (argv[i][0] == '-' || *filename != NULL)
+            return 0;
+        else
+            *filename = argv[i];
+    }
 
-    fclose(file);
-    return 1;
-}
+    // with a limit the depth is only a ceiling
+    if ((options->moveTime || options->nodes) && !depthGiven)
+        options->depth = MAX_PLY;
 
-// Saves the current game state to a file
-int writeBoard(char board[][N], char filename[]) {
-    char outputfile[30] = "out-";
-    char *p;
-    p = strcat(outputfile, filename);
-    FILE *file = fopen(outputfile, "w+");
+    // a move script only makes sense when the moves are not typed in
+    if (options->movesFile && !options->batch)
+        return 0;
+    return *filename != NULL;
+}
 
-    if (file == NULL){
-        printf("Error opening the saved file: %s\n", filename);
+// Reads a binary save or a text board
+int loadGame(SavedGame *saved, char filename[]){
+    if (saveIsBinary(filename)){
+        if (saveRead(filename, saved))
+            return 1;
+        printf("The saved game is damaged: %s\n", filename);
         return 0;
     }
 
-    int i,k;
-    for (i = 0; i < N; i++){
-        for (k = 0; k < N; k++){
-            fputc(board[i][k], file);
+    char board[N][N];
+    if (!readBoard(board, filename))
+        return 0;
+    posFromBoard(board, &saved->pos);
+    saved->mTurn = 1;                                       // the Musketeers always start
+    saved->moves = 0;
+    return 1;
+}
 
-             // Add a space after each character except the last in a row
-            if (k < N - 1) 
-                fputc(' ', file);
+// Saves the game in the formats asked for
+int saveGame(const SavedGame *saved, char filename[], const PlayOptions *options, int quiet){
+    int ok = 1;
+
+    if (options->saveFormats & SAVE_BINARY){
+        char outputfile[FILENAME_MAX];
+
+        if (!saveFileName(filename, SAVE_EXTENSION, outputfile, sizeof(outputfile)) || !saveWrite(outputfile, saved)){
+            printf("Error writing the saved file: %s\n", outputfile);
+            ok = 0;
         }
-        fputc('\n', file);
-     }
-    fclose(file);
-    printf("Saving %s...Done.\nAu revoir!\n\n", outputfile);
-    return 1;
+        else if (!quiet)
+            printf("Saving %s...Done.\n%s", outputfile, options->saveFormats & SAVE_TEXT ? "" : "Au revoir!\n\n");
+    }
+
+    if (options->saveFormats & SAVE_TEXT){
+        char board[N][N];
+
+        posToBoard(&saved->pos, board);
+        if (!writeBoard(board, filename, quiet))
+            ok = 0;
+    }
+    return ok;
 }
 
 // Function to display the game board
 void display_board(char board[][N]) {
-    printf("\n    1   2   3   4   5\n");
-    printf("  +---+---+---+---+---+\n");
-
+    char border[4 * N + 4];                 // "  +---+---+ ... +" for the size of the board
     int i, k;
+
+    memcpy(border, "  +", 3);
+    for (k = 0; k < N; k++)
+        memcpy(border + 3 + 4 * k, "---+", 4);
+    border[3 + 4 * N] = '\0';
+
+    printf("\n  ");
+    for (k = 0; k < N; k++)
+        printf("%s%d", k == 0 ? "  " : "   ", k + 1);
+    printf("\n%s\n", border);
+
     for (i = 0; i < N; i++) {
         printf("%c |", 'A' + i);            // increase the index of A for each row
 
@@ -233,238 +495,501 @@ void display_board(char board[][N]) {
         }
         
         printf("\n");
-        printf("  +---+---+---+---+---+\n");
+        printf("%s\n", border);
     }
 }
 
 // play the game
-void play (char board[][N], char outfile[]){
+void play (const SavedGame *start, char outfile[], const PlayOptions *options, Journal *journal){
 
-    int   row, col, musketeersTurn = 1; // musketeers turn = 1, enemies turn = 0
+    char board[N][N];
+    int   row, col;
     char direction;
-    char *playerMove = (char *) malloc(11 * sizeof(char));  // declare the player move parameter and allocate memory
+    char playerMove[MOVE_LINE];                             // the player move as typed
+
+    // Printing the intro message needed for the instructions of the game, with the letters and numbers of the board
+    int i;
+    printf("*** The Three Musketeers Game ***\nTo make a move, enter the location of the piece you want to move,\nand the direction you want it to move. Locations are indicated as\na letter (");
+    for (i = 0; i < N; i++)
+        printf("%s%c", i == 0 ? "" : ", ", 'A' + i);
+    printf(") followed by a nnumber (");
+    for (i = 0; i < N; i++)
+        printf("%s%d", i == 0 ? "" : i < N - 1 ? ", " : ", or ", i + 1);
+    printf(").\nDirections are indicated as left, right, up, down (L/l, R/r, U/u, D/d).\nFor example, to move the Musketeer from the top right-hand corner\nto the row below, enter 'A,%d = L' or 'a,%d=l'(without quotes).\nFor convenience in typing, use lowercase letters.\n\n", N, N);
+
+    Game game;
+    SavedGame now;
+    gameInit(&game, &start->pos, start->mTurn);             // keep the game state as bitboards
+    posToBoard(&start->pos, board);
 
-    // Printing the intro message needed for the instructions of the game
-    printf("*** The Three Musketeers Game ***\nTo make a move, enter the location of the piece you want to move,\nand the direction you want it to move. Locations are indicated as\na letter (A, B, C, D, E) followed by a nnumber (1, 2, 3, 4, or 5).\nDirections are indicated as left, right, up, down (L/l, R/r, U/u, D/d).\nFor example, to move the Musketeer from the top right-hand corner\nto the row below, enter 'A,5 = L' or 'a,5=l'(without quotes).\nFor convenience in typing, use lowercase letters.\n\n");
+    Engine engine;
+    engineStart(options, &engine);
+
+    // the computer thinks on the player's time, with alpha-beta only
+    Ponder ponder;
+    LineInput input = { .length = 0, .ended = 0, .skipping = 0 };
+    int pondering = options->ponder && options->engineSide != -1 && !engine.useMcts;
+    ponder.count = 0;
+    ponder.running = 0;
 
     display_board(board);                                   // display the current board
 
-    while (!winGame(board)){
+    int shownPly = -1, outcome, full = 0;
+    MoveList list;
+    while ((outcome = gameOutcome(&game, &list)) == OUTCOME_PLAYING){
+        if (journal && !journalFlush(journal))             // the moves so far are safe before the next one
+            printf("Error writing the journal.\n");
 
-        if (musketeersTurn){
-            printf("\nGive the Musketeer's move\n>");
-            fgets(playerMove, sizeof(playerMove), stdin);           // read the player move as a string
+        if (engine.settings.tb && game.ply != shownPly){
+            printVerdict(engine.settings.tb, &game);
+            shownPly = game.ply;
         }
-        else {
+
+        if (game.mTurn == options->engineSide){                // the computer's turn
+            Move move;
+            char text[MOVE_TEXT];
+
+            // a reply pondered to the full depth is played at once
+            if (!ponderReply(&ponder, &game, &move) && !engineMove(&engine, &game, &move)){
+                printf("\nThe computer has no move left to play.\n");
+                break;
+            }
+
+            if (!playMove(&game, start, journal, move)){
+                full = 1;
+                break;
+            }
+            moveToString(move, text);
+            printf("\nThe computer plays %s\n", text);
+            posToBoard(&game.pos, board);
+            display_board(board);
+            continue;
+        }
+
+        if (game.mTurn)
+            printf("\nGive the Musketeer's move\n>");
+        else
             printf("\nGive the enemy's move\n>");
-            fgets(playerMove, sizeof(playerMove), stdin);           // read the player move as a string
+        fflush(stdout);
+        if (pondering && !ponderStart(&ponder, &game, &engine.settings))
+            ponder.count = 0;
+        int typed = readLine(&input, playerMove, sizeof(playerMove));
+        ponderStop(&ponder);
+        if (typed == LINE_TOO_LONG){
+            printf("Invalid input format. The line is too long. Use i,j=value (e.g., A,5=L).\n");
+            continue;
         }
+        if (!typed)                                             // the input has ended: stop as if asked to
+            strcpy(playerMove, "0,0=E\n");
+
+        const char *cursor = playerMove;
+        ParsedMove parsed;
+        int code = parseMove(&cursor, playerMove + strlen(playerMove), &parsed);
 
-        if ((strcmp(playerMove, "0,0=E\n") == 0) || (strcmp(playerMove, "0,0=e\n") == 0)) {               // if the game is interrupted
+        if (code == PARSE_INTERRUPT) {                                  // if the game is interrupted
             // User wants to quit the game
             printf("\nGame interrupted. Exiting...\n");
-            gameInterrupt(board, outfile);
+            gameSnapshot(&game, start, &now);
+            gameInterrupt(&now, outfile, options);
             break;
         }
 
-        // Parse the move input
-        if ((sscanf(playerMove, " %c,%c=%c", (char*)&row, (char*)&col, &direction) == 3) || (sscanf(playerMove, " %c,%c = %c", (char*)&row, (char*)&col, &direction) == 3)) {
-            row = tolower(playerMove[0]) - 'a';  // Convert row to index (0-4)
-            col = playerMove[2] - '1';           // Convert col to index (0-4)
-            
-            if (musketeersTurn){
-                if (isValidMusketeerMove(row, col, direction, board)){ 
-                    makeMove(row, col, direction, board, musketeersTurn);
-                    musketeersTurn = !musketeersTurn;
-                    display_board(board);
-                }
-            }
-            else{
-                if (isValidEnemyMove(row, col, direction, board)) {
-                    makeMove(row, col, direction, board, musketeersTurn);
-                    musketeersTurn = !musketeersTurn;
-                    display_board(board);
+        if (code == PARSE_MOVE) {
+            row = parsed.row;
+            col = parsed.col;
+            direction = directionToChar(parsed.dir);
+
+            int legal = game.mTurn ? isValidMusketeerMove(row, col, direction, board)
+                                   : isValidEnemyMove(row, col, direction, board);
+
+            if (legal){
+                if (!playMove(&game, start, journal, moveAt(row, col, directionFromChar(direction)))){
+                    full = 1;
+                    break;
                 }
+                posToBoard(&game.pos, board);
+                display_board(board);
             }
         }
         else {
-            printf("Invalid input format. Use i,j=value (e.g., A,5=L).\n");
+            printf("Invalid input format. %s Use i,j=value (e.g., A,5=L).\n", parseMessage(code));
         }
     }
 
-    if (winMusketeers(board)){
-        printf("\nThe Musketeers win!\n\n");
-        gameInterrupt(board, outfile);
+    if (full){
+        printf("\nThe undo stack is full, so the move was not played. Exiting...\n");
+        gameSnapshot(&game, start, &now);
+        gameInterrupt(&now, outfile, options);
     }
-
-    else if (winEnemies(board)){
-        printf("\nCardinal Richelieu's men win!\n\n");
-        gameInterrupt(board, outfile);
+    else if (outcome != OUTCOME_PLAYING){
+        if (outcome == OUTCOME_MUSKETEERS)
+            printf("\nThe Musketeers win!\n\n");
+        else
+            printf("\nCardinal Richelieu's men win!\n\n");
+        gameSnapshot(&game, start, &now);
+        gameInterrupt(&now, outfile, options);
     }
+
+    engineStop(&engine);
 }   
 
-// make sure the move the user has inserted is valid
-int isValidMove (int row, int col, char direction, char board[][N]){
-    int cnt = 0;
-
-        if (row >= 0 && row < N && col >= 0 && col < N) {
-              if (direction == 'L' || direction == 'l' || direction == 'R' || direction == 'r' ||
-                    direction == 'U' || direction == 'u' || direction == 'D' || direction == 'd')
-                    // Valid move, apply it to the board
-                    cnt++;
-              else 
-                    printf("Invalid direction. Use L/l, R/r, U/u, or D/d.\n");
+// replays a move script without showing anything until the end
+int playBatch(const SavedGame *start, char outfile[], FILE *moves, const PlayOptions *options, Journal *journal){
+    size_t length = 0, capacity = 0;
+    char *script = NULL;
+
+    // read the whole script up front, a large chunk at a time
+    for (;;){
+        if (capacity - length < SCRIPT_CHUNK){
+            char *grown = realloc(script, capacity + SCRIPT_CHUNK);
+            if (grown == NULL){
+                free(script);
+                return 0;
+            }
+            script = grown;
+            capacity += SCRIPT_CHUNK;
         }
-        else 
-              printf("\nThis move gets out of the board or is a wrong move.\n");  
-    
-    if (cnt > 0)
-        return 1;
-    return 0;
-}
 
-int isValidMusketeerMove(int row, int col, char direction, char board[][N]){
-    int cnt = 0;
-
-    if (isValidMove(row, col, direction, board)){
-        if ((board[row][col] == 'M') && (board[row-1][col] == 'o') && ((direction == 'U') || (direction == 'u')) && (row > 0))
-            cnt++;
-        if ((board[row][col] == 'M') && (board[row+1][col] == 'o') && ((direction == 'D') || (direction == 'd')) && (row < N-1))
-            cnt++;
-        if ((board[row][col] == 'M') && (board[row][col-1] == 'o') && ((direction == 'L') || (direction == 'l')) && (col > 0))
-            cnt++;
-        if ((board[row][col] == 'M') && (board[row][col+1] == 'o') && ((direction == 'R') || (direction == 'r')) && (col < N-1))
-            cnt++;
+        size_t got = fread(script + length, 1, capacity - length, moves);
+        length += got;
+        if (got == 0)
+            break;
+    }
+    if (ferror(moves)){
+        free(script);
+        return 0;
     }
 
-    if (cnt > 0)
-        return 1;
+    Game game;
+    gameInit(&game, &start->pos, start->mTurn);
 
-    printf("\nNo Musketeers spotted!.\n");
-    return 0;
-}
+    Engine engine;
+    engineStart(options, &engine);
+
+    const char *outcome = "The game is not over yet.";
+    int rejected = 0, full = 0, result;
+    const char *line = script, *end = script + length;
+    MoveList list;
 
-int isValidEnemyMove(int row, int col, char direction, char board[][N]){
-    int cnt = 0;
-
-    if (isValidMove(row, col, direction, board)){
-         if ((board[row][col] == 'o') && (board[row-1][col] == '.') && ((direction == 'U') || (direction == 'u')))
-            cnt++;
-        if ((board[row][col] == 'o') && (board[row+1][col] == '.') && ((direction == 'D') || (direction == 'd')))
-            cnt++;
-        if ((board[row][col] == 'o') && (board[row][col-1] == '.') && ((direction == 'L') || (direction == 'l')))
-            cnt++;
-        if ((board[row][col] == 'o') && (board[row][col+1] == '.') && ((direction == 'R') || (direction == 'r')))
-            cnt++;
+    while ((result = gameOutcome(&game, &list)) == OUTCOME_PLAYING){
+        if (game.mTurn == options->engineSide){            // the computer's turn
+            Move move;
+
+            if (!engineMove(&engine, &game, &move)){
+                outcome = "The computer has no move left to play.";
+                break;
+            }
+            if (!playMove(&game, start, journal, move)){
+                full = 1;
+                break;
+            }
+            continue;
+        }
+
+        if (line == end)                                    // the script has run out
+            break;
+
+        ParsedMove parsed;
+        int code = parseMove(&line, end, &parsed);
+        if (code == PARSE_INTERRUPT){
+            outcome = "Game interrupted.";
+            break;
+        }
+
+        if (code == PARSE_MOVE){
+            int legal = game.mTurn ? posIsValidMusketeerMove(&game.pos, parsed.row, parsed.col, parsed.dir)
+                                   : posIsValidEnemyMove(&game.pos, parsed.row, parsed.col, parsed.dir);
+
+            if (!legal)
+                rejected++;
+            else if (!playMove(&game, start, journal, moveAt(parsed.row, parsed.col, parsed.dir))){
+                full = 1;
+                break;
+            }
+        }
+        else if (code != PARSE_BLANK)                       // blank lines are not moves
+            rejected++;
     }
 
-    if (cnt > 0)
-        return 1;
+    engineStop(&engine);
+    free(script);
 
-    printf("\nNo enemies spotted!\n");
-    return 0;
-}
+    if (full)
+        outcome = "The undo stack is full, so the last move was not played.";
+    else if (result == OUTCOME_MUSKETEERS)
+        outcome = "The Musketeers win!";
+    else if (result == OUTCOME_ENEMIES)
+        outcome = "Cardinal Richelieu's men win!";
 
-// makes the move given by the user
-void makeMove(int row, int col, char direction, char board[][N], int mTurn){
-    int newRow, newCol;
+    SavedGame now;
+    char board[N][N];
+    gameSnapshot(&game, start, &now);
+    posToBoard(&now.pos, board);
+    int saved = saveGame(&now, outfile, options, 1);
+
+    // the only output of the whole game, in one write
+    char text[256 + BOARD_TEXT];
+    int used = snprintf(text, sizeof(text), "%s\n%d moves played, %d rejected, board %s:\n",
+        outcome, game.ply, rejected, saved ? "saved" : "not saved");
+    used += formatBoard(board, text + used);
+    fwrite(text, 1, (size_t)used, stdout);
+    fflush(stdout);
+    return 1;
+}
 
-    if ((direction == 'l') || (direction == 'L')){
-        newRow = row;
-        newCol = col - 1;
+// searches one position of a corpus
+static int analysePosition(const Position *pos, int mTurn, uint64_t number, void *context){
+    const SearchSettings *settings = context;
+    SearchResult result;
+    char text[MOVE_TEXT];
+    Game game;
+
+    gameInit(&game, pos, mTurn);
+    if (gameWinMusketeers(&game))
+        printf("%llu over musketeers\n", (unsigned long long)number);
+    else if (gameWinEnemies(&game))
+        printf("%llu over enemies\n", (unsigned long long)number);
+    else if (!searchBestMove(&game, settings, &result))
+        printf("%llu over musketeers\n", (unsigned long long)number);     // the enemies are stuck
+    else {
+        moveToString(result.best, text);
+        printf("%llu %s %d\n", (unsigned long long)number, text, result.score);
     }
-    else if ((direction == 'r') || (direction == 'R')){
-        newRow = row;
-        newCol = col + 1;
+    return 1;
+}
+
+// analyses a whole corpus in one pass
+int analyseCorpus(char filename[], const PlayOptions *options){
+    static char output[1 << 16];
+    Engine engine;
+    CorpusStats stats;
+
+    setvbuf(stdout, output, _IOFBF, sizeof(output));    // the results are only for files and pipes
+    engineStart(options, &engine);
+    int ok = corpusRead(filename, analysePosition, &engine.settings, &stats);
+    engineStop(&engine);
+
+    if (ok)
+        fprintf(stderr, "%llu positions analysed, %llu lines or records skipped\n",
+            (unsigned long long)stats.positions, (unsigned long long)stats.rejected);
+    fflush(stdout);
+    return ok;
+}
+
+// searches the board once, to see what the search makes of it and how fast it goes
+int analyseGame(const SavedGame *start, const PlayOptions *options){
+    Engine engine;
+    SearchResult result;
+    MctsResult mctsResult;
+    char text[MOVE_TEXT];
+    Game game;
+    int found = 0, tbResult, distance, i;
+
+    gameInit(&game, &start->pos, start->mTurn);
+    engineStart(options, &engine);
+
+    if (gameWinGame(&game))
+        printf("The game is already over.\n");
+    else if (engine.useMcts && !(engine.settings.tb
+            && tbBestMove(engine.settings.tb, &game.pos, game.mTurn, &result.best, &tbResult, &distance))){
+        if (!mctsSearch(&engine.mcts, &game, &engine.mctsSettings, &mctsResult))
+            printf("The %s have no move.\n", game.mTurn ? "Musketeers" : "enemies");
+        else {
+            moveToString(mctsResult.best, text);
+            printf("Best move %s, won %.1f%% of its random games\n", text, 100.0 * mctsResult.winRate);
+            printf("%llu playouts in %.3fs (%.0f playouts/s) with %d thread%s\n",
+                (unsigned long long)mctsResult.playouts, mctsResult.seconds,
+                mctsResult.seconds > 0 ? (double)mctsResult.playouts / mctsResult.seconds : 0.0,
+                mctsResult.threads, mctsResult.threads == 1 ? "" : "s");
+            for (i = 0; i < mctsResult.threads; i++)
+                printf("Thread %d: %llu playouts, %.0f playouts/s\n", i, (unsigned long long)mctsResult.threadPlayouts[i],
+                    mctsResult.seconds > 0 ? (double)mctsResult.threadPlayouts[i] / mctsResult.seconds : 0.0);
+            found = 1;
+        }
     }
-    else if ((direction == 'u') || (direction == 'U')){
-        newRow = row - 1;
-        newCol = col;
+    else if (!searchBestMove(&game, &engine.settings, &result))
+        printf("The %s have no move.\n", game.mTurn ? "Musketeers" : "enemies");
+    else if (result.threads == 0){
+        moveToString(result.best, text);
+        printf("Best move %s, score %d, from the tablebases\n", text, result.score);
+        found = 1;
     }
-    else if ((direction == 'd') || (direction == 'D')){
-        newRow = row + 1;
-        newCol = col;
+    else {
+        moveToString(result.best, text);
+        printf("Best move %s, score %d, depth %d\n", text, result.score, result.depth);
+        printf("%llu nodes in %.3fs with %d thread%s\n", (unsigned long long)result.nodes, result.seconds,
+            result.threads, result.threads == 1 ? "" : "s");
+        for (i = 0; i < result.threads; i++)
+            printf("Thread %d: %llu nodes, %.0f nodes/s\n", i, (unsigned long long)result.threadNodes[i],
+                result.seconds > 0 ? (double)result.threadNodes[i] / result.seconds : 0.0);
+        found = 1;
     }
 
-    board[row][col] = '.';
-    if (mTurn)
-        board[newRow][newCol] = 'M';
-    else
-        board[newRow][newCol] = 'o';
+    engineStop(&engine);
+    return found;
 }
 
-// used when the user inputs 0,0=E
-void gameInterrupt (char board[][N], char outfile[]){
-
-    //const char* outputFile;
-    //inputfile.txt";   
+// gets the transposition table or the trees, and the tablebases, ready for the computer
+void engineStart(const PlayOptions *options, Engine *engine){
+    SearchSettings *settings = &engine->settings;
+
+    settings->depth = options->depth;
+    settings->tt = NULL;
+    settings->tb = NULL;
+    settings->threads = options->threads;
+    settings->moveTime = options->moveTime;
+    settings->nodes = options->nodes;
+    settings->cancel = NULL;
+    settings->keepAge = 0;
+    engine->useMcts = 0;
+    engine->mctsSettings.playouts = options->playouts;
+    engine->mctsSettings.moveTime = options->moveTime;
+
+    int needed = options->engineSide != -1 || options->corpus || options->analyse;
+    if (needed && options->mcts && !options->corpus){
+        if (mctsInit(&engine->mcts, options->threads, (size_t)options->hashMegabytes, 1))
+            engine->useMcts = 1;
+        else
+            printf("Not enough memory for the Monte Carlo trees, searching with alpha-beta.\n");
+    }
+    if (needed && !engine->useMcts){
+        if (ttInit(&engine->tt, (size_t)options->hashMegabytes))
+            settings->tt = &engine->tt;
+        else
+            printf("Not enough memory for the transposition table, searching without it.\n");
+    }
 
-    // After the game is interrupted or a winner is determined
-    if (!writeBoard(board, outfile)) {
-        printf("Failed to save the game state.\n");
+    // the files are only mapped, one layer at a time, once a position needs them
+    if (options->tablebaseDir){
+        tbProbeOpen(&engine->tb, options->tablebaseDir);
+        settings->tb = &engine->tb;
     }
 }
 
-// returns 1 if the musketeers have won
-int winMusketeers(char board[][N]){
-    int cnt = 0;
+// the tablebases first, then Monte Carlo or alpha-beta
+int engineMove(Engine *engine, const Game *game, Move *move){
+    if (engine->useMcts){
+        MctsResult result;
+        int tbResult, distance;
 
-    int i, k;
-    for (i = 0; i < N; i++)
-        for (k = 0; k < N; k++){
-            if (board[i][k] == 'M'){
-                if((k-1 >= 0) && (board[i][k-1] == 'o'))
-                    cnt++;
-                if((k+1 < N) && (board[i][k+1] == 'o'))
-                    cnt++;
-                if((i-1 >= 0) && (board[i-1][k]) == 'o')
-                    cnt++;
-                if((i+1 < N) && (board[i+1][k] == 'o'))
-                    cnt++;
-            }
-        }
+        if (engine->settings.tb && tbBestMove(engine->settings.tb, &game->pos, game->mTurn, move, &tbResult, &distance))
+            return 1;
+        if (!mctsSearch(&engine->mcts, game, &engine->mctsSettings, &result))
+            return 0;
+        *move = result.best;
+        return 1;
+    }
 
-    if (cnt > 0)
+    SearchResult result;
+    if (!searchBestMove(game, &engine->settings, &result))
         return 0;
-
+    *move = result.best;
     return 1;
 }
 
-// returns 1 if the enemies have won
-int winEnemies(char board[][N]){
+// frees the computer's transposition table or trees, and the tablebases
+void engineStop(Engine *engine){
+    if (engine->useMcts)
+        mctsFree(&engine->mcts);
+    if (engine->settings.tt)
+        ttFree(engine->settings.tt);
+    if (engine->settings.tb)
+        tbProbeClose(engine->settings.tb);
+}
 
-    int i,k;
-    // Check if all three Musketeers are in the same row
-    for (i = 0; i < N; i++) {
-        int mCount = 0;
-        for (k = 0; k < N; k++) {
-            if (board[i][k] == 'M') 
-                mCount++;
-        }
-        if (mCount == 3) 
-            return 1;
-    }
+// tells the players who wins from here with perfect play
+void printVerdict(TBProbe *tb, const Game *game){
+    int result, distance;
 
+    if (!tbProbe(tb, &game->pos, game->mTurn, &result, &distance))
+        return;
 
-    // Check if all three Musketeers are in the same column
-    for (k = 0; k < N; k++) {
-        int mCount = 0;
-        for (i = 0; i < N; i++) {
-            if (board[i][k] == 'M')
-                mCount++;
-        }
-        if (mCount == 3) 
-            return 1;
-    }
+    const char *winner = result == TB_MUSKETEERS_WIN ? "The Musketeers" : "Cardinal Richelieu's men";
+    if (distance < 0)
+        printf("\nTablebase: %s win with perfect play.\n", winner);
+    else
+        printf("\nTablebase: %s win with perfect play, the game ends in %d moves.\n", winner, distance);
+}
 
-    return 0;
+// where the game has got to
+void gameSnapshot(const Game *game, const SavedGame *start, SavedGame *now){
+    now->pos = game->pos;
+    now->mTurn = game->mTurn;
+    now->moves = start->moves + game->ply;
 }
 
-// returns 1 if any of the opposing teams have won the game
-int winGame (char board[][N]){
-    if (winMusketeers(board) || winEnemies(board))
-        return 1;
-    return 0;
+// the journal gets each move as it is made; play() flushes it at once, playBatch() at the end
+int playMove(Game *game, const SavedGame *start, Journal *journal, Move move){
+    if (!gameMakeMove(game, move))
+        return 0;
+    if (journal){
+        SavedGame now;
+
+        gameSnapshot(game, start, &now);
+        journalMove(journal, move, &now);
+    }
+    return 1;
 }
 
+// used when the user inputs 0,0=E
+void gameInterrupt (const SavedGame *now, char outfile[], const PlayOptions *options){
+
+    //const char* outputFile;
+    //inputfile.txt";   
+
+    // After the game is interrupted or a winner is determined
+    if (!saveGame(now, outfile, options, 0)) {
+        printf("Failed to save the game state.\n");
+    }
+}
 
+// poll waits for the input without holding up the pondering thread
+int readLine(LineInput *input, char line[], size_t size){
+    for (;;){
+        char *newline = memchr(input->data, '\n', input->length);
+        size_t length = newline ? (size_t)(newline - input->data) + 1 : input->length;
+
+        // a line that was too long is thrown away up to its end, as a session does
+        if (input->skipping){
+            memmove(input->data, input->data + length, input->length - length);
+            input->length -= length;
+            if (newline || input->ended){
+                input->skipping = 0;
+                return LINE_TOO_LONG;
+            }
+        }
+        else if (newline && length <= size - 1){
+            memcpy(line, input->data, length);
+            line[length] = '\0';
+            memmove(input->data, input->data + length, input->length - length);
+            input->length -= length;
+            return 1;
+        }
+        else if (newline || length >= size - 1){
+            input->skipping = 1;
+            continue;
+        }
+        else if (input->ended){
+            if (length == 0)
+                return 0;
+            memcpy(line, input->data, length);          // the last line, without a newline
+            line[length] = '\0';
+            input->length = 0;
+            return 1;
+        }
+        struct pollfd fd = { .fd = STDIN_FILENO, .events = POLLIN };
+        if (poll(&fd, 1, -1) < 0){
+            if (errno == EINTR)
+                continue;
+            input->ended = 1;
+            continue;
+        }
+        ssize_t got = read(STDIN_FILENO, input->data + input->length, sizeof(input->data) - input->length);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            input->ended = 1;
+        else
+            input->length += (size_t)got;
+    }
+}
@@ -0,0 +1,198 @@
+/**
+ * @file traindata.c
+ * @brief The background writer of training data and the mapped reader.
+ * @bug no known bugs
+ *
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "traindata.h"
+
+// write() can take less than it is given
+static int writeAll(int fd, const void *data, size_t size){
+    const char *p = data;
+
+    while (size > 0){
+        ssize_t done = write(fd, p, size);
+
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            return 0;
+        p += done;
+        size -= (size_t)done;
+    }
+    return 1;
+}
+
+// writes every buffer handed over until there are no more to come
+static void *writerThread(void *arg){
+    TrainWriter *writer = arg;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;){
+        while (writer->pending == 0 && !writer->closing)
+            pthread_cond_wait(&writer->full, &writer->lock);
+        if (writer->pending == 0)
+            break;
+
+        // the buffer is the writer's until pending goes back to 0
+        const TrainRecord *buffer = writer->buffers[!writer->current];
+        size_t count = writer->pending;
+        pthread_mutex_unlock(&writer->lock);
+        int ok = writeAll(writer->fd, buffer, count * sizeof(TrainRecord));
+        pthread_mutex_lock(&writer->lock);
+
+        if (!ok)
+            writer->failed = 1;
+        writer->written += count;
+        writer->pending = 0;
+        pthread_cond_broadcast(&writer->free);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+// hands the buffer being filled to the writer, once it is done with the other one
+static void handOver(TrainWriter *writer){
+    while (writer->pending != 0)
+        pthread_cond_wait(&writer->free, &writer->lock);
+    writer->pending = writer->filled;
+    writer->current = !writer->current;
+    writer->filled = 0;
+    pthread_cond_signal(&writer->full);
+}
+
+int trainWriterOpen(TrainWriter *writer, const char *filename){
+    TrainHeader header;
+
+    memset(writer, 0, sizeof(*writer));
+    writer->buffers[0] = malloc(TRAIN_BUFFER * sizeof(TrainRecord));
+    writer->buffers[1] = malloc(TRAIN_BUFFER * sizeof(TrainRecord));
+    writer->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRAIN_MAGIC, 4);
+    header.version = TRAIN_VERSION;
+    header.boardSize = N;
+    header.recordSize = sizeof(TrainRecord);
+
+    int ok = writer->buffers[0] != NULL && writer->buffers[1] != NULL && writer->fd >= 0
+        && writeAll(writer->fd, &header, sizeof(header));
+    if (ok){
+        pthread_mutex_init(&writer->lock, NULL);
+        pthread_cond_init(&writer->full, NULL);
+        pthread_cond_init(&writer->free, NULL);
+        ok = pthread_create(&writer->thread, NULL, writerThread, writer) == 0;
+        if (!ok){
+            pthread_mutex_destroy(&writer->lock);
+            pthread_cond_destroy(&writer->full);
+            pthread_cond_destroy(&writer->free);
+        }
+    }
+    if (!ok){
+        if (writer->fd >= 0)
+            close(writer->fd);
+        free(writer->buffers[0]);
+        free(writer->buffers[1]);
+        return 0;
+    }
+    return 1;
+}
+
+void trainWriterAdd(TrainWriter *writer, const TrainRecord records[], size_t count){
+    pthread_mutex_lock(&writer->lock);
+    while (count > 0){
+        size_t room = TRAIN_BUFFER - writer->filled;
+        size_t n = count < room ? count : room;
+
+        memcpy(writer->buffers[writer->current] + writer->filled, records, n * sizeof(TrainRecord));
+        writer->filled += n;
+        records += n;
+        count -= n;
+        if (writer->filled == TRAIN_BUFFER)
+            handOver(writer);
+    }
+    pthread_mutex_unlock(&writer->lock);
+}
+
+int trainWriterClose(TrainWriter *writer){
+    pthread_mutex_lock(&writer->lock);
+    if (writer->filled > 0)
+        handOver(writer);
+    writer->closing = 1;
+    pthread_cond_signal(&writer->full);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    int ok = !writer->failed && close(writer->fd) == 0;
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->full);
+    pthread_cond_destroy(&writer->free);
+    free(writer->buffers[0]);
+    free(writer->buffers[1]);
+    return ok;
+}
+
+int trainAugment(const TrainRecord *record, TrainRecord out[SYMMETRIES]){
+    int t, k, count = 0;
+
+    for (t = 0; t < SYMMETRIES; t++){
+        TrainRecord image = *record;
+
+        image.musketeers = symBitboard(t, (Bitboard)record->musketeers);
+        image.enemies = symBitboard(t, (Bitboard)record->enemies);
+
+        // a symmetric position has images that are the same
+        for (k = 0; k < count; k++)
+            if (out[k].musketeers == image.musketeers && out[k].enemies == image.enemies)
+                break;
+        if (k == count)
+            out[count++] = image;
+    }
+    return count;
+}
+
+int trainOpen(TrainData *data, const char *filename){
+    struct stat info;
+    int fd = open(filename, O_RDONLY);
+
+    data->map = NULL;
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(TrainHeader)
+            || ((size_t)info.st_size - sizeof(TrainHeader)) % sizeof(TrainRecord) != 0){
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);                                  // the mapping stays
+    if (map == MAP_FAILED)
+        return 0;
+
+    const TrainHeader *header = map;
+    if (memcmp(header->magic, TRAIN_MAGIC, 4) != 0 || header->version != TRAIN_VERSION
+            || header->boardSize != N || header->recordSize != sizeof(TrainRecord)){
+        munmap(map, (size_t)info.st_size);
+        return 0;
+    }
+    madvise(map, (size_t)info.st_size, MADV_SEQUENTIAL);    // loaders mostly read it front to back
+
+    data->map = map;
+    data->mapSize = (size_t)info.st_size;
+    data->records = (const TrainRecord *)((const char *)map + sizeof(TrainHeader));
+    data->count = ((size_t)info.st_size - sizeof(TrainHeader)) / sizeof(TrainRecord);
+    return 1;
+}
+
+void trainClose(TrainData *data){
+    if (data->map != NULL)
+        munmap(data->map, data->mapSize);
+    data->map = NULL;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file traindata.h
+ * @brief Training data for evaluation models: one fixed-width record per
+ * position of a game, with the side to move, the score the player's search
+ * gave it and how the game ended. A file is a TrainHeader followed by the
+ * records, both in the byte order of the machine, like the tablebase
+ * files. The records are written by a background thread from two buffers:
+ * the threads playing fill one while the other goes to disk, so they only
+ * wait when the disk falls a whole buffer behind. The reader maps the file
+ * into memory, so a training loader can index the records directly.
+ * @bug no known bugs
+ *
+*/
+#ifndef TRAINDATA_H
+#define TRAINDATA_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard.h"
+#include "symmetry.h"
+
+#define TRAIN_MAGIC "TMTD"
+#define TRAIN_VERSION 1
+#define TRAIN_NO_SCORE INT16_MIN    // the player that moved gave no score
+#define TRAIN_BUFFER 65536          // records per buffer of the writer
+
+/**
+ * @brief One position of a game.
+*/
+typedef struct {
+    uint64_t musketeers;    /**< the Musketeers' squares */
+    uint64_t enemies;       /**< the enemies' squares */
+    int16_t score;          /**< the search score for the side to move, or TRAIN_NO_SCORE */
+    uint8_t mTurn;          /**< 1 if the Musketeers are to move, 0 if the enemies are */
+    int8_t result;          /**< 1 if the Musketeers won the game, -1 if the enemies did, 0 if it was not finished */
+    uint16_t ply;           /**< moves played before this position */
+    uint16_t length;        /**< moves in the whole game */
+} TrainRecord;
+
+/**
+ * @brief The start of a training data file.
+*/
+typedef struct {
+    char magic[4];          /**< "TMTD" */
+    uint32_t version;       /**< TRAIN_VERSION */
+    uint32_t boardSize;     /**< N */
+    uint32_t recordSize;    /**< sizeof(TrainRecord) */
+} TrainHeader;
+
+/**
+ * @brief The background writer and its two buffers.
+*/
+typedef struct {
+    int fd;                         /**< the file */
+    TrainRecord *buffers[2];        /**< one being filled, the other being written */
+    int current;                    /**< the buffer being filled */
+    size_t filled;                  /**< records in it */
+    size_t pending;                 /**< records in the other one still to be written, 0 once it is free */
+    int closing;                    /**< 1 once no more records will come */
+    int failed;                     /**< 1 if a write failed */
+    uint64_t written;               /**< records written so far */
+    pthread_mutex_t lock;
+    pthread_cond_t full;            /**< a buffer is waiting for the writer */
+    pthread_cond_t free;            /**< the writer is done with its buffer */
+    pthread_t thread;
+} TrainWriter;
+
+/**
+ * @brief A training data file mapped into memory.
+*/
+typedef struct {
+    const TrainRecord *records;     /**< the records */
+    uint64_t count;                 /**< how many there are */
+    void *map;                      /**< the mapping */
+    size_t mapSize;                 /**< its size */
+} TrainData;
+
+/**
+ * @brief Creates a training data file and starts the thread that writes it.
+ * @param writer filled in.
+ * @param filename the file, replaced if it is there.
+ * @return 1 if it worked, 0 if not.
+*/
+int trainWriterOpen(TrainWriter *writer, const char *filename);
+
+/**
+ * @brief Adds records to the file. They are copied into the buffer and
+ * written later; it is safe to call from many threads at once.
+ * @param writer the writer.
+ * @param records the records.
+ * @param count how many.
+*/
+void trainWriterAdd(TrainWriter *writer, const TrainRecord records[], size_t count);
+
+/**
+ * @brief Writes what is left in the buffers, stops the thread and closes the file.
+ * @param writer the writer.
+ * @return 1 if every record was written, 0 if not.
+*/
+int trainWriterClose(TrainWriter *writer);
+
+/**
+ * @brief The distinct images of a record under the 8 symmetries of the
+ * board; the score and result stay the same.
+ * @param record the record.
+ * @param out filled in with the images, the record itself first.
+ * @return how many there are, from 1 to SYMMETRIES.
+*/
+int trainAugment(const TrainRecord *record, TrainRecord out[SYMMETRIES]);
+
+/**
+ * @brief Maps a training data file into memory, after checking that it
+ * was written for this board size and record layout.
+ * @param data filled in with the records.
+ * @param filename the file.
+ * @return 1 if it worked, 0 if not.
+*/
+int trainOpen(TrainData *data, const char *filename);
+
+/**
+ * @brief Unmaps a training data file.
+ * @param data the file.
+*/
+void trainClose(TrainData *data);
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * @file tt.c
+ * @brief Transposition table allocation, lookup and replacement, safe
+ * for many threads at once without locks.
+ * @bug no known bugs
+ *
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "tt.h"
+
+int ttInit(TransTable *tt, size_t megabytes){
+    size_t budget = megabytes * 1024 * 1024;
+    uint64_t count = 1;
+
+    while (count * 2 * sizeof(TTBucket) <= budget)
+        count *= 2;
+
+    tt->buckets = aligned_alloc(sizeof(TTBucket), count * sizeof(TTBucket));
+    if (tt->buckets == NULL)
+        return 0;
+
+    tt->mask = count - 1;
+    ttClear(tt);
+    return 1;
+}
+
+void ttFree(TransTable *tt){
+    free(tt->buckets);
+    tt->buckets = NULL;
+}
+
+void ttClear(TransTable *tt){
+    memset(tt->buckets, 0, (tt->mask + 1) * sizeof(TTBucket));
+    tt->age = 0;
+}
+
+void ttNewSearch(TransTable *tt){
+    tt->age++;
+}
+
+// an entry in 64 bits: score, depth, bound, age and move a byte or two each
+static uint64_t packEntry(int score, int depth, int bound, uint8_t age, Move move){
+    return (uint64_t)(uint16_t)score | (uint64_t)(uint8_t)depth << 16 | (uint64_t)(uint8_t)bound << 24
+        | (uint64_t)age << 32 | (uint64_t)move.from << 40 | (uint64_t)move.to << 48;
+}
+
+static void unpackEntry(uint64_t data, TTEntry *e){
+    e->score = (int16_t)(uint16_t)data;
+    e->depth = (uint8_t)(data >> 16);
+    e->bound = (uint8_t)(data >> 24);
+    e->age = (uint8_t)(data >> 32);
+    e->move.from = (unsigned char)(data >> 40);
+    e->move.to = (unsigned char)(data >> 48);
+}
+
+// the two words are read and written one at a time; the xor check catches a torn slot
+static void loadSlot(const TTSlot *slot, uint64_t *check, uint64_t *data){
+    *check = __atomic_load_n(&slot->check, __ATOMIC_RELAXED);
+    *data = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+}
+
+int ttProbe(const TransTable *tt, uint64_t key, TTEntry *entry){
+    const TTBucket *bucket = &tt->buckets[key & tt->mask];
+    int i;
+
+    STATS_COUNT(STAT_TT_PROBE);
+    for (i = 0; i < TT_BUCKET; i++){
+        uint64_t check, data;
+
+        loadSlot(&bucket->slot[i], &check, &data);
+        if ((check ^ data) == key){
+            unpackEntry(data, entry);
+            if (entry->bound != BOUND_NONE){
+                STATS_COUNT(STAT_TT_HIT);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// how much an entry is worth keeping: its depth, less 8 for every search since it was stored
+static int keepValue(const TransTable *tt, const TTEntry *e){
+    if (e->bound == BOUND_NONE)
+        return -1000;
+    return e->depth - 8 * (uint8_t)(tt->age - e->age);
+}
+
+void ttStore(TransTable *tt, uint64_t key, int depth, int score, int bound, Move move){
+    TTBucket *bucket = &tt->buckets[key & tt->mask];
+    TTSlot *victim = NULL;
+    int i, victimValue = 0;
+
+    for (i = 0; i < TT_BUCKET; i++){
+        uint64_t check, data;
+        TTEntry e;
+
+        loadSlot(&bucket->slot[i], &check, &data);
+        if ((check ^ data) == key){
+            victim = &bucket->slot[i];
+            break;
+        }
+        unpackEntry(data, &e);
+        if (victim == NULL || keepValue(tt, &e) < victimValue){
+            victim = &bucket->slot[i];
+            victimValue = keepValue(tt, &e);
+        }
+    }
+
+    uint64_t data = packEntry(score, depth, bound, tt->age, move);
+    __atomic_store_n(&victim->check, key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->data, data, __ATOMIC_RELAXED);
+}
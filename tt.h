@@ -0,0 +1,116 @@
+/**
+ * @file tt.h
+ * @brief A fixed-size transposition table: search results stored under
+ * the Zobrist key of the position, so that positions reached through a
+ * different order of moves are not searched again. The table is one
+ * preallocated block of cache-line sized buckets whose count is a power
+ * of two chosen from a memory budget. Any number of search threads may
+ * share one table.
+ * @bug no known bugs
+ *
+*/
+#ifndef TT_H
+#define TT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard.h"
+
+#define TT_BUCKET 4             // entries per bucket, one 64-byte cache line
+
+/**
+ * @brief How a stored score relates to the real score of the position.
+*/
+enum { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT };
+
+/**
+ * @brief One stored search result, as ttProbe gives it back.
+*/
+typedef struct {
+    int16_t score;          /**< score for the side to move */
+    uint8_t depth;          /**< depth the position was searched to */
+    uint8_t bound;          /**< one of the BOUND_ constants */
+    uint8_t age;            /**< the search that stored it */
+    Move move;              /**< best move found */
+} TTEntry;
+
+/**
+ * @brief One place in the table. The entry is packed into data and the
+ * key is stored xor'ed with it, so that threads can read and write the
+ * table at the same time without locks: an entry torn by two threads
+ * writing at once no longer matches its key and is simply not found.
+*/
+typedef struct {
+    uint64_t check;         /**< the key of the position xor data */
+    uint64_t data;          /**< the packed entry */
+} TTSlot;
+
+/**
+ * @brief The entries that share one index into the table.
+*/
+typedef struct {
+    TTSlot slot[TT_BUCKET];
+} TTBucket;
+
+/**
+ * @brief The transposition table.
+*/
+typedef struct {
+    TTBucket *buckets;      /**< the table itself, aligned to a cache line */
+    uint64_t mask;          /**< number of buckets less one */
+    uint8_t age;            /**< bumped for every new search, so old entries get replaced first */
+} TransTable;
+
+/**
+ * @brief Allocates the table: the largest power of two number of
+ * buckets that fits in the memory budget (at least one bucket).
+ * @param tt the table to set up.
+ * @param megabytes the memory budget in megabytes.
+ * @return 1 if the memory was allocated, 0 if it was not.
+*/
+int ttInit(TransTable *tt, size_t megabytes);
+
+/**
+ * @brief Frees the memory of the table.
+ * @param tt the table.
+*/
+void ttFree(TransTable *tt);
+
+/**
+ * @brief Empties the table.
+ * @param tt the table.
+*/
+void ttClear(TransTable *tt);
+
+/**
+ * @brief Marks the start of a new search, so that entries left from
+ * earlier searches are the first to be replaced. It must not be called
+ * while other threads are searching with the table.
+ * @param tt the table.
+*/
+void ttNewSearch(TransTable *tt);
+
+/**
+ * @brief Looks a position up.
+ * @param tt the table.
+ * @param key the Zobrist key of the position.
+ * @param entry filled in with the stored entry.
+ * @return 1 if the position is in the table, 0 if it is not.
+*/
+int ttProbe(const TransTable *tt, uint64_t key, TTEntry *entry);
+
+/**
+ * @brief Stores a search result. An entry for the same position is
+ * overwritten, otherwise the bucket gives up its least valuable entry:
+ * the shallowest one, with entries from older searches counting as
+ * shallower the older they are.
+ * @param tt the table.
+ * @param key the Zobrist key of the position.
+ * @param depth the depth the position was searched to.
+ * @param score the score for the side to move.
+ * @param bound one of the BOUND_ constants.
+ * @param move the best move found.
+*/
+void ttStore(TransTable *tt, uint64_t key, int depth, int score, int bound, Move move);
+
+#endif
@@ -0,0 +1,254 @@
+/**
+ * @file winbatch.c
+ * @brief The batch win tests: the plain C loop, the AVX2 and AVX-512
+ * kernels and picking one of them.
+ *
+ * The vector kernels cannot loop over rows and columns the way
+ * posWinEnemies does, so they count the Musketeers of all five rows at
+ * once: the five columns are added one by one into a three bit counter
+ * kept one bit per mask (the low bits of every row in one mask, the
+ * middle bits in the next and the high bits in the last), and a row with
+ * three has 011 in it. The columns are counted the same way. The capture
+ * counts are popcounts done with shifts and masks, since neither
+ * instruction set has one for 32-bit lanes everywhere.
+ * @bug no known bugs
+ *
+*/
+#include <immintrin.h>
+#include <string.h>
+#include "winbatch.h"
+
+#define ALL_ROWS BB_COL_FIRST       // the first square of every row
+#define ALL_COLUMNS BB_ROW_FIRST    // the first square of every column
+
+static int lineOfThree(Bitboard musketeers){
+    int i;
+
+    for (i = 0; i < N; i++)
+        if (bbCount(musketeers & (BB_ROW_FIRST << (i * N))) == 3 || bbCount(musketeers & (BB_COL_FIRST << i)) == 3)
+            return 1;
+    return 0;
+}
+
+static void batchScalar(const Bitboard musketeers[], const Bitboard enemies[], size_t count, unsigned char wins[], unsigned char captures[]){
+    size_t i;
+    int dir;
+
+    for (i = 0; i < count; i++){
+        Position pos = { musketeers[i], enemies[i] };
+        int captured = 0;
+
+        for (dir = 0; dir < DIRECTIONS; dir++)
+            captured += bbCount(posMovers(&pos, 1, dir));
+        wins[i] = (unsigned char)(((bbNeighbours(pos.musketeers) & pos.enemies) == 0 ? WIN_BATCH_MUSKETEERS : 0)
+            | (lineOfThree(pos.musketeers) ? WIN_BATCH_ENEMIES : 0));
+        captures[i] = (unsigned char)captured;
+    }
+}
+
+// the kernels work on 32-bit lanes, so larger boards only have the plain loop
+#if BB_BITS == 32
+
+__attribute__((target("avx2")))
+static inline void addBitAvx2(__m256i counter[3], __m256i bit){
+    __m256i carry = _mm256_and_si256(counter[0], bit);
+
+    counter[0] = _mm256_xor_si256(counter[0], bit);
+    bit = carry;
+    carry = _mm256_and_si256(counter[1], bit);
+    counter[1] = _mm256_xor_si256(counter[1], bit);
+    counter[2] = _mm256_or_si256(counter[2], carry);
+}
+
+// nonzero where some row or column holds exactly three Musketeers
+__attribute__((target("avx2")))
+static inline __m256i threeAvx2(__m256i musketeers){
+    const __m256i rows = _mm256_set1_epi32(ALL_ROWS), columns = _mm256_set1_epi32(ALL_COLUMNS);
+    __m256i inRow[3], inColumn[3];
+    int i;
+
+    inRow[0] = inRow[1] = inRow[2] = inColumn[0] = inColumn[1] = inColumn[2] = _mm256_setzero_si256();
+    for (i = 0; i < N; i++){
+        addBitAvx2(inRow, _mm256_and_si256(_mm256_srli_epi32(musketeers, i), rows));
+        addBitAvx2(inColumn, _mm256_and_si256(_mm256_srli_epi32(musketeers, i * N), columns));
+    }
+    return _mm256_or_si256(_mm256_andnot_si256(inRow[2], _mm256_and_si256(inRow[0], inRow[1])),
+        _mm256_andnot_si256(inColumn[2], _mm256_and_si256(inColumn[0], inColumn[1])));
+}
+
+// the popcount of every byte of a mask
+__attribute__((target("avx2")))
+static inline __m256i byteCountAvx2(__m256i b){
+    const __m256i ones = _mm256_set1_epi8(0x55), twos = _mm256_set1_epi8(0x33), fours = _mm256_set1_epi8(0x0F);
+
+    b = _mm256_sub_epi32(b, _mm256_and_si256(_mm256_srli_epi32(b, 1), ones));
+    b = _mm256_add_epi32(_mm256_and_si256(b, twos), _mm256_and_si256(_mm256_srli_epi32(b, 2), twos));
+    return _mm256_and_si256(_mm256_add_epi32(b, _mm256_srli_epi32(b, 4)), fours);
+}
+
+// the low byte of each of the eight lanes
+__attribute__((target("avx2")))
+static inline void storeBytesAvx2(unsigned char out[], __m256i lanes){
+    __m256i words = _mm256_packus_epi32(lanes, lanes);
+    __m256i packed = _mm256_packus_epi16(words, words);
+    uint32_t low = (uint32_t)_mm256_extract_epi32(packed, 0), high = (uint32_t)_mm256_extract_epi32(packed, 4);
+
+    memcpy(out, &low, 4);
+    memcpy(out + 4, &high, 4);
+}
+
+__attribute__((target("avx2")))
+static void batchAvx2(const Bitboard musketeers[], const Bitboard enemies[], size_t count, unsigned char wins[], unsigned char captures[]){
+    const __m256i full = _mm256_set1_epi32((int)BB_FULL), zero = _mm256_setzero_si256();
+    const __m256i notFirst = _mm256_set1_epi32((int)~BB_COL_FIRST), notLast = _mm256_set1_epi32((int)~BB_COL_LAST);
+    const __m256i musketeersWin = _mm256_set1_epi32(WIN_BATCH_MUSKETEERS), enemiesWin = _mm256_set1_epi32(WIN_BATCH_ENEMIES);
+    size_t i;
+
+    for (i = 0; i + 8 <= count; i += 8){
+        __m256i m = _mm256_loadu_si256((const __m256i *)(musketeers + i));
+        __m256i e = _mm256_loadu_si256((const __m256i *)(enemies + i));
+
+        // the Musketeers that can capture towards each direction, as in posMovers
+        __m256i left = _mm256_and_si256(m, _mm256_slli_epi32(_mm256_and_si256(e, notLast), 1));
+        __m256i right = _mm256_and_si256(m, _mm256_srli_epi32(_mm256_and_si256(e, notFirst), 1));
+        __m256i up = _mm256_and_si256(m, _mm256_and_si256(_mm256_slli_epi32(e, N), full));
+        __m256i down = _mm256_and_si256(m, _mm256_srli_epi32(e, N));
+
+        // every lane's four popcounts, added byte by byte and then across the bytes
+        __m256i bytes = _mm256_add_epi32(_mm256_add_epi32(byteCountAvx2(left), byteCountAvx2(right)),
+            _mm256_add_epi32(byteCountAvx2(up), byteCountAvx2(down)));
+        bytes = _mm256_add_epi32(bytes, _mm256_srli_epi32(bytes, 8));
+        bytes = _mm256_add_epi32(bytes, _mm256_srli_epi32(bytes, 16));
+        storeBytesAvx2(captures + i, _mm256_and_si256(bytes, _mm256_set1_epi32(0xFF)));
+
+        // as in posWinMusketeers: no enemy next to any Musketeer
+        __m256i neighbours = _mm256_or_si256(
+            _mm256_or_si256(_mm256_srli_epi32(_mm256_and_si256(m, notFirst), 1), _mm256_slli_epi32(_mm256_and_si256(m, notLast), 1)),
+            _mm256_or_si256(_mm256_srli_epi32(m, N), _mm256_and_si256(_mm256_slli_epi32(m, N), full)));
+        __m256i won = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(neighbours, e), zero), musketeersWin);
+        __m256i lost = _mm256_andnot_si256(_mm256_cmpeq_epi32(threeAvx2(m), zero), enemiesWin);
+        storeBytesAvx2(wins + i, _mm256_or_si256(won, lost));
+    }
+    batchScalar(musketeers + i, enemies + i, count - i, wins + i, captures + i);
+}
+
+__attribute__((target("avx512f")))
+static inline void addBitAvx512(__m512i counter[3], __m512i bit){
+    __m512i carry = _mm512_and_si512(counter[0], bit);
+
+    counter[0] = _mm512_xor_si512(counter[0], bit);
+    bit = carry;
+    carry = _mm512_and_si512(counter[1], bit);
+    counter[1] = _mm512_xor_si512(counter[1], bit);
+    counter[2] = _mm512_or_si512(counter[2], carry);
+}
+
+__attribute__((target("avx512f")))
+static inline __mmask16 threeAvx512(__m512i musketeers){
+    const __m512i rows = _mm512_set1_epi32(ALL_ROWS), columns = _mm512_set1_epi32(ALL_COLUMNS);
+    __m512i inRow[3], inColumn[3];
+    int i;
+
+    inRow[0] = inRow[1] = inRow[2] = inColumn[0] = inColumn[1] = inColumn[2] = _mm512_setzero_si512();
+    for (i = 0; i < N; i++){
+        addBitAvx512(inRow, _mm512_and_si512(_mm512_srli_epi32(musketeers, i), rows));
+        addBitAvx512(inColumn, _mm512_and_si512(_mm512_srli_epi32(musketeers, i * N), columns));
+    }
+    __m512i three = _mm512_or_si512(_mm512_andnot_si512(inRow[2], _mm512_and_si512(inRow[0], inRow[1])),
+        _mm512_andnot_si512(inColumn[2], _mm512_and_si512(inColumn[0], inColumn[1])));
+    return _mm512_test_epi32_mask(three, three);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i byteCountAvx512(__m512i b){
+    const __m512i ones = _mm512_set1_epi8(0x55), twos = _mm512_set1_epi8(0x33), fours = _mm512_set1_epi8(0x0F);
+
+    b = _mm512_sub_epi32(b, _mm512_and_si512(_mm512_srli_epi32(b, 1), ones));
+    b = _mm512_add_epi32(_mm512_and_si512(b, twos), _mm512_and_si512(_mm512_srli_epi32(b, 2), twos));
+    return _mm512_and_si512(_mm512_add_epi32(b, _mm512_srli_epi32(b, 4)), fours);
+}
+
+__attribute__((target("avx512f")))
+static void batchAvx512(const Bitboard musketeers[], const Bitboard enemies[], size_t count, unsigned char wins[], unsigned char captures[]){
+    const __m512i full = _mm512_set1_epi32((int)BB_FULL);
+    const __m512i notFirst = _mm512_set1_epi32((int)~BB_COL_FIRST), notLast = _mm512_set1_epi32((int)~BB_COL_LAST);
+    const __m512i musketeersWin = _mm512_set1_epi32(WIN_BATCH_MUSKETEERS), enemiesWin = _mm512_set1_epi32(WIN_BATCH_ENEMIES);
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16){
+        __m512i m = _mm512_loadu_si512(musketeers + i);
+        __m512i e = _mm512_loadu_si512(enemies + i);
+
+        __m512i left = _mm512_and_si512(m, _mm512_slli_epi32(_mm512_and_si512(e, notLast), 1));
+        __m512i right = _mm512_and_si512(m, _mm512_srli_epi32(_mm512_and_si512(e, notFirst), 1));
+        __m512i up = _mm512_and_si512(m, _mm512_and_si512(_mm512_slli_epi32(e, N), full));
+        __m512i down = _mm512_and_si512(m, _mm512_srli_epi32(e, N));
+
+        __m512i bytes = _mm512_add_epi32(_mm512_add_epi32(byteCountAvx512(left), byteCountAvx512(right)),
+            _mm512_add_epi32(byteCountAvx512(up), byteCountAvx512(down)));
+        bytes = _mm512_add_epi32(bytes, _mm512_srli_epi32(bytes, 8));
+        bytes = _mm512_add_epi32(bytes, _mm512_srli_epi32(bytes, 16));
+        _mm_storeu_si128((__m128i *)(captures + i), _mm512_cvtepi32_epi8(_mm512_and_si512(bytes, _mm512_set1_epi32(0xFF))));
+
+        __m512i neighbours = _mm512_or_si512(
+            _mm512_or_si512(_mm512_srli_epi32(_mm512_and_si512(m, notFirst), 1), _mm512_slli_epi32(_mm512_and_si512(m, notLast), 1)),
+            _mm512_or_si512(_mm512_srli_epi32(m, N), _mm512_and_si512(_mm512_slli_epi32(m, N), full)));
+        __m512i flags = _mm512_or_si512(_mm512_maskz_mov_epi32(_mm512_testn_epi32_mask(neighbours, e), musketeersWin),
+            _mm512_maskz_mov_epi32(threeAvx512(m), enemiesWin));
+        _mm_storeu_si128((__m128i *)(wins + i), _mm512_cvtepi32_epi8(flags));
+    }
+    batchScalar(musketeers + i, enemies + i, count - i, wins + i, captures + i);
+}
+
+#endif
+
+int winBatchSupported(int kernel){
+    switch (kernel){
+        case WIN_BATCH_SCALAR:  return 1;
+#if BB_BITS == 32
+        case WIN_BATCH_AVX2:    return __builtin_cpu_supports("avx2");
+        case WIN_BATCH_AVX512:  return __builtin_cpu_supports("avx512f");
+#endif
+        default:                return 0;
+    }
+}
+
+int winBatchBest(void){
+    static int best = -1;
+    int kernel = __atomic_load_n(&best, __ATOMIC_RELAXED);
+
+    // every thread that gets here first works out the same answer
+    if (kernel < 0){
+        for (kernel = WIN_BATCH_KERNELS - 1; kernel > WIN_BATCH_SCALAR; kernel--)
+            if (winBatchSupported(kernel))
+                break;
+        __atomic_store_n(&best, kernel, __ATOMIC_RELAXED);
+    }
+    return kernel;
+}
+
+const char *winBatchName(int kernel){
+    static const char *const names[WIN_BATCH_KERNELS] = { "scalar", "avx2", "avx512" };
+
+    return kernel >= 0 && kernel < WIN_BATCH_KERNELS ? names[kernel] : "unknown";
+}
+
+void winBatchWith(int kernel, const Bitboard musketeers[], const Bitboard enemies[], size_t count, unsigned char wins[], unsigned char captures[]){
+    STATS_ADD(STAT_WIN_TEST, 2 * count);
+#if BB_BITS == 32
+    if (kernel == WIN_BATCH_AVX512){
+        batchAvx512(musketeers, enemies, count, wins, captures);
+        return;
+    }
+    if (kernel == WIN_BATCH_AVX2){
+        batchAvx2(musketeers, enemies, count, wins, captures);
+        return;
+    }
+#endif
+    (void)kernel;
+    batchScalar(musketeers, enemies, count, wins, captures);
+}
+
+void winBatch(const Bitboard musketeers[], const Bitboard enemies[], size_t count, unsigned char wins[], unsigned char captures[]){
+    winBatchWith(winBatchBest(), musketeers, enemies, count, wins, captures);
+}
@@ -0,0 +1,82 @@
+/**
+ * @file winbatch.h
+ * @brief The two win tests and the number of captures the Musketeers
+ * have, worked out for a whole array of positions at once. The positions
+ * come as two arrays (all the Musketeer masks, then all the enemy masks)
+ * so that 8 of them fit in one AVX2 register and 16 in one AVX-512
+ * register, and every test is done on all of them with the same few
+ * shifts and masks. The answers are the same as posWinMusketeers,
+ * posWinEnemies and the number of moves generateMoves finds for the
+ * Musketeers, position by position.
+ *
+ * The kernel is picked when the program runs, by what the processor can
+ * do, so the usual build lines need no -m flags; a processor with neither
+ * gets the plain C loop, and so does a board above 5x5, whose masks do
+ * not fit in 32-bit lanes.
+ * @bug no known bugs
+ *
+*/
+#ifndef WINBATCH_H
+#define WINBATCH_H
+
+#include <stddef.h>
+#include "bitboard.h"
+
+#define WIN_BATCH_MUSKETEERS 1      // in a position's win flags: the Musketeers have won
+#define WIN_BATCH_ENEMIES 2         // in a position's win flags: the enemies have won
+
+/**
+ * @brief The ways the batch can be worked out.
+*/
+enum {
+    WIN_BATCH_SCALAR,       /**< one position at a time, in plain C */
+    WIN_BATCH_AVX2,         /**< 8 positions per instruction */
+    WIN_BATCH_AVX512,       /**< 16 positions per instruction */
+    WIN_BATCH_KERNELS
+};
+
+/**
+ * @brief Works out the win flags and capture counts of many positions,
+ * with the fastest kernel the processor has.
+ * @param musketeers the Musketeer mask of every position.
+ * @param enemies the enemy mask of every position.
+ * @param count the number of positions.
+ * @param wins filled in with WIN_BATCH_MUSKETEERS and WIN_BATCH_ENEMIES
+ * for each position, 0 when neither side has won.
+ * @param captures filled in with the number of capture moves the
+ * Musketeers have in each position.
+*/
+void winBatch(const Bitboard musketeers[], const Bitboard enemies[], size_t count, unsigned char wins[], unsigned char captures[]);
+
+/**
+ * @brief winBatch with a given kernel, for comparing them.
+ * @param kernel one of the WIN_BATCH_ kernels; it must be supported.
+ * @param musketeers the Musketeer mask of every position.
+ * @param enemies the enemy mask of every position.
+ * @param count the number of positions.
+ * @param wins filled in with the win flags.
+ * @param captures filled in with the capture counts.
+*/
+void winBatchWith(int kernel, const Bitboard musketeers[], const Bitboard enemies[], size_t count, unsigned char wins[], unsigned char captures[]);
+
+/**
+ * @brief Whether this processor can run a kernel.
+ * @param kernel one of the WIN_BATCH_ kernels.
+ * @return 1 if it can, 0 if not.
+*/
+int winBatchSupported(int kernel);
+
+/**
+ * @brief The kernel winBatch uses on this processor.
+ * @return one of the WIN_BATCH_ kernels.
+*/
+int winBatchBest(void);
+
+/**
+ * @brief The name of a kernel, for printing.
+ * @param kernel one of the WIN_BATCH_ kernels.
+ * @return "scalar", "avx2" or "avx512".
+*/
+const char *winBatchName(int kernel);
+
+#endif
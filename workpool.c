@@ -0,0 +1,140 @@
+/**
+ * @file workpool.c
+ * @brief The work-stealing pool: one slice of task numbers per worker.
+ * @bug no known bugs
+ *
+*/
+#include <pthread.h>
+#include <stdlib.h>
+#include "workpool.h"
+
+/**
+ * @brief The tasks a worker has still to run, next to end - 1. Each
+ * slice has a cache line to itself, so workers running their own tasks
+ * never slow each other down.
+*/
+typedef struct {
+    pthread_mutex_t lock;           /**< held while the slice changes */
+    uint64_t next;                  /**< the next task to run */
+    uint64_t end;                   /**< one past the last task */
+} __attribute__((aligned(64))) WorkSlice;
+
+/**
+ * @brief Everything the workers of one run share.
+*/
+typedef struct {
+    WorkSlice slices[WORKPOOL_MAX_WORKERS];     /**< the task slices */
+    int workers;                                /**< how many there are */
+    WorkFunction function;                      /**< what runs a task */
+    void *context;                              /**< passed on to it */
+} WorkPool;
+
+/**
+ * @brief What one thread is told when it starts.
+*/
+typedef struct {
+    WorkPool *pool;                 /**< the pool */
+    int worker;                     /**< which worker the thread is */
+} WorkerStart;
+
+// the next task of a worker's own slice, taken from the front
+static int takeOwn(WorkSlice *slice, uint64_t *task){
+    int found = 0;
+
+    pthread_mutex_lock(&slice->lock);
+    if (slice->next < slice->end){
+        *task = slice->next++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&slice->lock);
+    return found;
+}
+
+// moves the back half of another worker's slice into an empty one
+static int steal(WorkPool *pool, int worker){
+    int i;
+
+    for (i = 1; i < pool->workers; i++){
+        WorkSlice *victim = &pool->slices[(worker + i) % pool->workers];
+        uint64_t from = 0, to = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->next < victim->end){
+            from = victim->next + (victim->end - victim->next) / 2;
+            to = victim->end;
+            victim->end = from;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (from < to){
+            WorkSlice *own = &pool->slices[worker];
+
+            pthread_mutex_lock(&own->lock);
+            own->next = from;
+            own->end = to;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void runWorker(WorkPool *pool, int worker){
+    uint64_t task;
+
+    // a worker only stops once no other slice has a task left to steal
+    for (;;){
+        while (takeOwn(&pool->slices[worker], &task))
+            pool->function(task, worker, pool->context);
+        if (!steal(pool, worker))
+            break;
+    }
+}
+
+static void *workerThread(void *arg){
+    WorkerStart *start = arg;
+
+    runWorker(start->pool, start->worker);
+    return NULL;
+}
+
+int workPoolRun(int workers, uint64_t tasks, WorkFunction function, void *context){
+    if (workers < 1 || workers > WORKPOOL_MAX_WORKERS)
+        return 0;
+
+    WorkPool *pool = aligned_alloc(64, sizeof(*pool));  // the slices need their cache lines
+    pthread_t threads[WORKPOOL_MAX_WORKERS];
+    WorkerStart starts[WORKPOOL_MAX_WORKERS];
+    int started[WORKPOOL_MAX_WORKERS];
+    int i;
+
+    if (pool == NULL)
+        return 0;
+    pool->workers = workers;
+    pool->function = function;
+    pool->context = context;
+
+    // equal slices to begin with
+    for (i = 0; i < workers; i++){
+        pthread_mutex_init(&pool->slices[i].lock, NULL);
+        pool->slices[i].next = tasks * (uint64_t)i / (uint64_t)workers;
+        pool->slices[i].end = tasks * (uint64_t)(i + 1) / (uint64_t)workers;
+    }
+
+    // the calling thread is worker 0; if a thread cannot be started,
+    // the others steal its tasks
+    for (i = 1; i < workers; i++){
+        starts[i].pool = pool;
+        starts[i].worker = i;
+        started[i] = pthread_create(&threads[i], NULL, workerThread, &starts[i]) == 0;
+    }
+    runWorker(pool, 0);
+    for (i = 1; i < workers; i++)
+        if (started[i])
+            pthread_join(threads[i], NULL);
+
+    for (i = 0; i < workers; i++)
+        pthread_mutex_destroy(&pool->slices[i].lock);
+    free(pool);
+    return 1;
+}
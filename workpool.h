@@ -0,0 +1,39 @@
+/**
+ * @file workpool.h
+ * @brief A work-stealing thread pool for jobs made of many independent
+ * numbered tasks. Every worker starts with an equal slice of the task
+ * numbers and takes them from the front of its own slice. A worker
+ * whose slice has run out steals the back half of the slice of the
+ * first other worker that still has tasks left. Tasks of very different
+ * lengths, such as games that end early or late, are still spread evenly,
+ * and the workers hardly ever touch the same memory while they run.
+ * @bug no known bugs
+ *
+*/
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <stdint.h>
+
+#define WORKPOOL_MAX_WORKERS 256
+
+/**
+ * @brief Runs one task.
+ * @param task the task number, from 0 to the number of tasks - 1.
+ * @param worker the worker running it, from 0 to the number of workers - 1,
+ * so per-worker state can be kept in an array without locks.
+ * @param context the pointer given to workPoolRun.
+*/
+typedef void (*WorkFunction)(uint64_t task, int worker, void *context);
+
+/**
+ * @brief Runs every task once on a pool of threads and waits for them all.
+ * @param workers the number of threads, from 1 to WORKPOOL_MAX_WORKERS.
+ * @param tasks the number of tasks.
+ * @param function what runs each task.
+ * @param context passed on to the function.
+ * @return 1 if every task ran, 0 if the threads could not be started.
+*/
+int workPoolRun(int workers, uint64_t tasks, WorkFunction function, void *context);
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file zobrist.c
+ * @brief The Zobrist keys. They come from a fixed seed, so keys, and
+ * anything stored under them, are the same from one run to the next.
+ * The tables are filled in before main starts.
+ * @bug no known bugs
+ *
+*/
+#include "zobrist.h"
+#include "symmetry.h"
+
+#define ZOBRIST_SEED 0x3A4D5553484B4554ULL
+
+uint64_t zobristMusketeer[SYMMETRIES][SQUARES];
+uint64_t zobristEnemy[SYMMETRIES][SQUARES];
+uint64_t zobristSide;
+
+// splitmix64: a small, well mixed generator for the keys
+static uint64_t nextKey(uint64_t *state){
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+__attribute__((constructor))
+static void zobristInit(void){
+    uint64_t state = ZOBRIST_SEED;
+    int t, sq;
+
+    for (sq = 0; sq < SQUARES; sq++)
+        zobristMusketeer[SYM_IDENTITY][sq] = nextKey(&state);
+    for (sq = 0; sq < SQUARES; sq++)
+        zobristEnemy[SYM_IDENTITY][sq] = nextKey(&state);
+    zobristSide = nextKey(&state);
+
+    // a piece on sq sits on symSquare(t, sq) in image t
+    for (t = 1; t < SYMMETRIES; t++)
+        for (sq = 0; sq < SQUARES; sq++){
+            zobristMusketeer[t][sq] = zobristMusketeer[SYM_IDENTITY][symSquare(t, sq)];
+            zobristEnemy[t][sq] = zobristEnemy[SYM_IDENTITY][symSquare(t, sq)];
+        }
+}
+
+uint64_t zobristKey(const Position *pos, int mTurn){
+    uint64_t key = mTurn ? zobristSide : 0;
+    Bitboard b;
+
+    for (b = pos->musketeers; b; b &= b - 1)
+        key ^= zobristMusketeer[SYM_IDENTITY][bbFirst(b)];
+    for (b = pos->enemies; b; b &= b - 1)
+        key ^= zobristEnemy[SYM_IDENTITY][bbFirst(b)];
+    return key;
+}
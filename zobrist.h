@@ -0,0 +1,32 @@
+/**
+ * @file zobrist.h
+ * @brief 64-bit Zobrist keys for positions: one random number per piece
+ * type and square, plus one for the side to move, all XORed together.
+ * A move only changes a few squares, so the key of a game is updated
+ * incrementally by gameMakeMove instead of being rebuilt.
+ * @bug no known bugs
+ *
+*/
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdint.h>
+#include "bitboard.h"
+#include "symmetry.h"
+
+// The key of a piece on each square, first for the position itself and
+// then for each of its symmetric images: [t][sq] is the key of the square
+// that sq is mapped to by symmetry t.
+extern uint64_t zobristMusketeer[SYMMETRIES][SQUARES];
+extern uint64_t zobristEnemy[SYMMETRIES][SQUARES];
+extern uint64_t zobristSide;                        // the Musketeers are to move
+
+/**
+ * @brief Computes the key of a position from scratch.
+ * @param pos the position.
+ * @param mTurn A flag indicating whose turn it is (1 for Musketeers, 0 for enemies).
+ * @return the Zobrist key.
+*/
+uint64_t zobristKey(const Position *pos, int mTurn);
+
+#endif